@@ -0,0 +1,425 @@
+//***************************************************************************************
+// AabbTree.cpp
+//***************************************************************************************
+
+#include "AabbTree.h"
+#include <algorithm>
+#include <cassert>
+
+using namespace DirectX;
+
+namespace
+{
+	template<typename T>
+	T Union(const T& a, const T& b)
+	{
+		T result;
+		result.Min = XMFLOAT3(std::min(a.Min.x, b.Min.x), std::min(a.Min.y, b.Min.y), std::min(a.Min.z, b.Min.z));
+		result.Max = XMFLOAT3(std::max(a.Max.x, b.Max.x), std::max(a.Max.y, b.Max.y), std::max(a.Max.z, b.Max.z));
+		return result;
+	}
+
+	template<typename T>
+	float SurfaceArea(const T& box)
+	{
+		float dx = box.Max.x - box.Min.x;
+		float dy = box.Max.y - box.Min.y;
+		float dz = box.Max.z - box.Min.z;
+		return 2.0f*(dx*dy + dy*dz + dz*dx);
+	}
+
+	template<typename T>
+	bool Overlaps(const T& a, const T& b)
+	{
+		return a.Min.x <= b.Max.x && a.Max.x >= b.Min.x &&
+			a.Min.y <= b.Max.y && a.Max.y >= b.Min.y &&
+			a.Min.z <= b.Max.z && a.Max.z >= b.Min.z;
+	}
+
+	template<typename T>
+	bool Contains(const T& outer, const T& inner)
+	{
+		return outer.Min.x <= inner.Min.x && outer.Min.y <= inner.Min.y && outer.Min.z <= inner.Min.z &&
+			inner.Max.x <= outer.Max.x && inner.Max.y <= outer.Max.y && inner.Max.z <= outer.Max.z;
+	}
+}
+
+AabbTree::AabbTree(float margin)
+	: mMargin(margin)
+{
+}
+
+int AabbTree::Insert(const BoundingBox& box, uint32 userData)
+{
+	int proxy = AllocateNode();
+	mNodes[proxy].Box = ToAabb(box, mMargin);
+	mNodes[proxy].UserData = userData;
+	mNodes[proxy].Height = 0;
+
+	InsertLeaf(proxy);
+	mProxyCount++;
+
+	return proxy;
+}
+
+void AabbTree::Remove(int proxy)
+{
+	assert(proxy >= 0 && proxy < (int)mNodes.size() && mNodes[proxy].IsLeaf() && mNodes[proxy].Height == 0);
+
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	mProxyCount--;
+}
+
+bool AabbTree::Move(int proxy, const BoundingBox& box)
+{
+	assert(proxy >= 0 && proxy < (int)mNodes.size() && mNodes[proxy].IsLeaf() && mNodes[proxy].Height == 0);
+
+	if(Contains(mNodes[proxy].Box, ToAabb(box, 0.0f)))
+		return false;
+
+	RemoveLeaf(proxy);
+	mNodes[proxy].Box = ToAabb(box, mMargin);
+	InsertLeaf(proxy);
+
+	return true;
+}
+
+void AabbTree::Query(const BoundingBox& box, const std::function<bool(uint32 userData)>& callback)const
+{
+	if(mRoot == NullProxy)
+		return;
+
+	Aabb queryBox = ToAabb(box, 0.0f);
+
+	// A balanced tree stays far shallower than this; the vector only grows for
+	// degenerate inputs.
+	int fixedStack[64];
+	std::vector<int> overflow;
+	int stackSize = 0;
+	fixedStack[stackSize++] = mRoot;
+
+	while(stackSize > 0 || !overflow.empty())
+	{
+		int index;
+		if(!overflow.empty())
+		{
+			index = overflow.back();
+			overflow.pop_back();
+		}
+		else
+		{
+			index = fixedStack[--stackSize];
+		}
+
+		const Node& node = mNodes[index];
+		if(!Overlaps(node.Box, queryBox))
+			continue;
+
+		if(node.IsLeaf())
+		{
+			if(!callback(node.UserData))
+				return;
+			continue;
+		}
+
+		for(int child : { node.Child1, node.Child2 })
+		{
+			if(stackSize < 64)
+				fixedStack[stackSize++] = child;
+			else
+				overflow.push_back(child);
+		}
+	}
+}
+
+AabbTree::uint32 AabbTree::GetUserData(int proxy)const
+{
+	return mNodes[proxy].UserData;
+}
+
+BoundingBox AabbTree::GetFatBox(int proxy)const
+{
+	const Aabb& box = mNodes[proxy].Box;
+
+	BoundingBox result;
+	BoundingBox::CreateFromPoints(result, XMLoadFloat3(&box.Min), XMLoadFloat3(&box.Max));
+	return result;
+}
+
+size_t AabbTree::GetProxyCount()const
+{
+	return mProxyCount;
+}
+
+int AabbTree::GetHeight()const
+{
+	return mRoot == NullProxy ? 0 : mNodes[mRoot].Height + 1;
+}
+
+int AabbTree::AllocateNode()
+{
+	if(mFreeList == NullProxy)
+	{
+		mNodes.push_back(Node());
+		return (int)mNodes.size() - 1;
+	}
+
+	int node = mFreeList;
+	mFreeList = mNodes[node].Parent;
+	mNodes[node] = Node();
+	return node;
+}
+
+void AabbTree::FreeNode(int node)
+{
+	mNodes[node].Parent = mFreeList;
+	mNodes[node].Child1 = NullProxy;
+	mNodes[node].Child2 = NullProxy;
+	mNodes[node].Height = -1;
+	mFreeList = node;
+}
+
+void AabbTree::InsertLeaf(int leaf)
+{
+	if(mRoot == NullProxy)
+	{
+		mRoot = leaf;
+		mNodes[leaf].Parent = NullProxy;
+		return;
+	}
+
+	// Walk down to the sibling that grows the total surface area least.  Making a
+	// new parent at index costs its combined area; descending costs the growth of
+	// every ancestor on the way, which is at least the growth of index itself.
+	Aabb leafBox = mNodes[leaf].Box;
+	int index = mRoot;
+	while(!mNodes[index].IsLeaf())
+	{
+		const Node& node = mNodes[index];
+
+		float area = SurfaceArea(node.Box);
+		float combinedArea = SurfaceArea(Union(node.Box, leafBox));
+
+		float cost = 2.0f*combinedArea;
+		float inheritanceCost = 2.0f*(combinedArea - area);
+
+		float childCost[2];
+		int children[2] = { node.Child1, node.Child2 };
+		for(int c = 0; c < 2; ++c)
+		{
+			const Node& child = mNodes[children[c]];
+			float grownArea = SurfaceArea(Union(child.Box, leafBox));
+			childCost[c] = (child.IsLeaf() ? grownArea : grownArea - SurfaceArea(child.Box)) + inheritanceCost;
+		}
+
+		if(cost < childCost[0] && cost < childCost[1])
+			break;
+
+		index = childCost[0] < childCost[1] ? children[0] : children[1];
+	}
+
+	int sibling = index;
+	int oldParent = mNodes[sibling].Parent;
+
+	int newParent = AllocateNode();
+	mNodes[newParent].Parent = oldParent;
+	mNodes[newParent].Box = Union(leafBox, mNodes[sibling].Box);
+	mNodes[newParent].Height = mNodes[sibling].Height + 1;
+	mNodes[newParent].Child1 = sibling;
+	mNodes[newParent].Child2 = leaf;
+
+	if(oldParent != NullProxy)
+	{
+		if(mNodes[oldParent].Child1 == sibling)
+			mNodes[oldParent].Child1 = newParent;
+		else
+			mNodes[oldParent].Child2 = newParent;
+	}
+	else
+	{
+		mRoot = newParent;
+	}
+
+	mNodes[sibling].Parent = newParent;
+	mNodes[leaf].Parent = newParent;
+
+	Refit(newParent);
+}
+
+void AabbTree::RemoveLeaf(int leaf)
+{
+	if(leaf == mRoot)
+	{
+		mRoot = NullProxy;
+		return;
+	}
+
+	int parent = mNodes[leaf].Parent;
+	int grandParent = mNodes[parent].Parent;
+	int sibling = mNodes[parent].Child1 == leaf ? mNodes[parent].Child2 : mNodes[parent].Child1;
+
+	// The sibling takes the parent's place.
+	if(grandParent != NullProxy)
+	{
+		if(mNodes[grandParent].Child1 == parent)
+			mNodes[grandParent].Child1 = sibling;
+		else
+			mNodes[grandParent].Child2 = sibling;
+		mNodes[sibling].Parent = grandParent;
+		FreeNode(parent);
+
+		Refit(grandParent);
+	}
+	else
+	{
+		mRoot = sibling;
+		mNodes[sibling].Parent = NullProxy;
+		FreeNode(parent);
+	}
+
+	mNodes[leaf].Parent = NullProxy;
+}
+
+void AabbTree::Refit(int node)
+{
+	int index = node;
+	while(index != NullProxy)
+	{
+		index = Balance(index);
+
+		Node& n = mNodes[index];
+		const Node& child1 = mNodes[n.Child1];
+		const Node& child2 = mNodes[n.Child2];
+		n.Height = 1 + std::max(child1.Height, child2.Height);
+		n.Box = Union(child1.Box, child2.Box);
+
+		index = n.Parent;
+	}
+}
+
+int AabbTree::Balance(int iA)
+{
+	Node& A = mNodes[iA];
+	if(A.IsLeaf() || A.Height < 2)
+		return iA;
+
+	int iB = A.Child1;
+	int iC = A.Child2;
+	Node& B = mNodes[iB];
+	Node& C = mNodes[iC];
+
+	int balance = C.Height - B.Height;
+
+	// C is too deep: C takes A's place, A takes the shallower of C's children.
+	if(balance > 1)
+	{
+		int iF = C.Child1;
+		int iG = C.Child2;
+		Node& F = mNodes[iF];
+		Node& G = mNodes[iG];
+
+		C.Child1 = iA;
+		C.Parent = A.Parent;
+		A.Parent = iC;
+
+		if(C.Parent != NullProxy)
+		{
+			if(mNodes[C.Parent].Child1 == iA)
+				mNodes[C.Parent].Child1 = iC;
+			else
+				mNodes[C.Parent].Child2 = iC;
+		}
+		else
+		{
+			mRoot = iC;
+		}
+
+		if(F.Height > G.Height)
+		{
+			C.Child2 = iF;
+			A.Child2 = iG;
+			G.Parent = iA;
+			A.Box = Union(B.Box, G.Box);
+			C.Box = Union(A.Box, F.Box);
+			A.Height = 1 + std::max(B.Height, G.Height);
+			C.Height = 1 + std::max(A.Height, F.Height);
+		}
+		else
+		{
+			C.Child2 = iG;
+			A.Child2 = iF;
+			F.Parent = iA;
+			A.Box = Union(B.Box, F.Box);
+			C.Box = Union(A.Box, G.Box);
+			A.Height = 1 + std::max(B.Height, F.Height);
+			C.Height = 1 + std::max(A.Height, G.Height);
+		}
+
+		return iC;
+	}
+
+	// B is too deep: the mirror image.
+	if(balance < -1)
+	{
+		int iD = B.Child1;
+		int iE = B.Child2;
+		Node& D = mNodes[iD];
+		Node& E = mNodes[iE];
+
+		B.Child1 = iA;
+		B.Parent = A.Parent;
+		A.Parent = iB;
+
+		if(B.Parent != NullProxy)
+		{
+			if(mNodes[B.Parent].Child1 == iA)
+				mNodes[B.Parent].Child1 = iB;
+			else
+				mNodes[B.Parent].Child2 = iB;
+		}
+		else
+		{
+			mRoot = iB;
+		}
+
+		if(D.Height > E.Height)
+		{
+			B.Child2 = iD;
+			A.Child1 = iE;
+			E.Parent = iA;
+			A.Box = Union(C.Box, E.Box);
+			B.Box = Union(A.Box, D.Box);
+			A.Height = 1 + std::max(C.Height, E.Height);
+			B.Height = 1 + std::max(A.Height, D.Height);
+		}
+		else
+		{
+			B.Child2 = iE;
+			A.Child1 = iD;
+			D.Parent = iA;
+			A.Box = Union(C.Box, D.Box);
+			B.Box = Union(A.Box, E.Box);
+			A.Height = 1 + std::max(C.Height, D.Height);
+			B.Height = 1 + std::max(A.Height, E.Height);
+		}
+
+		return iB;
+	}
+
+	return iA;
+}
+
+AabbTree::Aabb AabbTree::ToAabb(const BoundingBox& box, float margin)
+{
+	Aabb result;
+	result.Min = XMFLOAT3(
+		box.Center.x - box.Extents.x - margin,
+		box.Center.y - box.Extents.y - margin,
+		box.Center.z - box.Extents.z - margin);
+	result.Max = XMFLOAT3(
+		box.Center.x + box.Extents.x + margin,
+		box.Center.y + box.Extents.y + margin,
+		box.Center.z + box.Extents.z + margin);
+	return result;
+}
@@ -0,0 +1,93 @@
+//***************************************************************************************
+// AabbTree.h
+//
+// Dynamic bounding volume hierarchy over axis aligned boxes, for broadphase overlap
+// queries.  Leaves are inserted next to the sibling that grows the tree's surface
+// area least and the tree is rebalanced with rotations on the way back up, so its
+// height stays logarithmic as proxies are added, moved and removed.
+//
+// Leaves store their box grown by a margin ("fat" boxes), so objects that move a
+// little don't change the tree at all.  Queries report the fat boxes that overlap,
+// and callers do the exact test.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <DirectXCollision.h>
+
+class AabbTree
+{
+public:
+	using uint32 = std::uint32_t;
+
+	static const int NullProxy = -1;
+
+	explicit AabbTree(float margin = 0.1f);
+
+	// Returns a proxy id that stays valid until the proxy is removed.  userData is
+	// handed back by queries, e.g. the index of the object the box belongs to.
+	int Insert(const DirectX::BoundingBox& box, uint32 userData);
+	void Remove(int proxy);
+
+	// Refits a proxy after its object moved.  Returns true when the new box left the
+	// fat box and the leaf was reinserted.
+	bool Move(int proxy, const DirectX::BoundingBox& box);
+
+	// Calls callback(userData) for every proxy whose fat box overlaps box, until the
+	// callback returns false.
+	void Query(const DirectX::BoundingBox& box, const std::function<bool(uint32 userData)>& callback)const;
+
+	uint32 GetUserData(int proxy)const;
+	DirectX::BoundingBox GetFatBox(int proxy)const;
+	size_t GetProxyCount()const;
+
+	// Levels from the root to the deepest leaf; 0 for an empty tree.
+	int GetHeight()const;
+
+private:
+	struct Aabb
+	{
+		DirectX::XMFLOAT3 Min;
+		DirectX::XMFLOAT3 Max;
+	};
+
+	struct Node
+	{
+		Aabb Box;
+
+		// Next free node while the node is on the free list.
+		int Parent = NullProxy;
+		int Child1 = NullProxy;
+		int Child2 = NullProxy;
+
+		// Leaves are 0, free nodes -1.
+		int Height = -1;
+		uint32 UserData = 0;
+
+		bool IsLeaf()const { return Child1 == NullProxy; }
+	};
+
+	int AllocateNode();
+	void FreeNode(int node);
+
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+
+	// Rotates the subtree at node if its children's heights differ by more than
+	// one; returns the subtree's new root.
+	int Balance(int node);
+
+	// Recomputes heights and boxes from node up to the root, balancing on the way.
+	void Refit(int node);
+
+	static Aabb ToAabb(const DirectX::BoundingBox& box, float margin);
+
+	std::vector<Node> mNodes;
+	int mRoot = NullProxy;
+	int mFreeList = NullProxy;
+	size_t mProxyCount = 0;
+	float mMargin;
+};
@@ -0,0 +1,548 @@
+//***************************************************************************************
+// BoundsBuilder.cpp
+//***************************************************************************************
+
+#include "BoundsBuilder.h"
+#include "MathHelper.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(_WIN32)
+	#include "d3dUtil.h"
+#endif
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define BOUNDS_SIMD_AVX2 1
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+	// Points per task when an input is split across the pool.  Partial sums are kept
+	// in float within a chunk and combined in double.
+	const size_t ChunkSize = 16384;
+
+	// Positions read in order.
+	struct LinearStream
+	{
+		const char* Positions;
+		size_t Stride;
+		size_t Count;
+
+		XMVECTOR Load(size_t i)const
+		{
+			return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(Positions + Stride*i));
+		}
+	};
+
+	// Positions read through an index list.
+	template<typename IndexT>
+	struct IndexedStream
+	{
+		const char* Positions;
+		size_t Stride;
+		const IndexT* Indices;
+		size_t Count;
+
+		XMVECTOR Load(size_t i)const
+		{
+			return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(Positions + Stride*Indices[i]));
+		}
+	};
+
+#if defined(BOUNDS_SIMD_AVX2)
+	// Two points side by side in one register, one per 128-bit lane.
+	__m256 Combine(__m128 a, __m128 b)
+	{
+		return _mm256_insertf128_ps(_mm256_castps128_ps256(a), b, 1);
+	}
+
+	__m256 Duplicate(__m128 a)
+	{
+		return Combine(a, a);
+	}
+#endif
+
+	// Leaves points as they are.
+	struct Identity
+	{
+		XMVECTOR operator()(FXMVECTOR p)const
+		{
+			return p;
+		}
+
+#if defined(BOUNDS_SIMD_AVX2)
+		__m256 operator()(__m256 p)const
+		{
+			return p;
+		}
+#endif
+	};
+
+	// Moves points into the frame of three orthonormal axes placed at origin.
+	struct Projection
+	{
+		Projection(FXMVECTOR origin, const XMFLOAT3 axes[3])
+		{
+			// Rows of the transposed axis matrix, so a point is x*Row0 + y*Row1 + z*Row2.
+			Origin = origin;
+			Row0 = XMVectorSet(axes[0].x, axes[1].x, axes[2].x, 0.0f);
+			Row1 = XMVectorSet(axes[0].y, axes[1].y, axes[2].y, 0.0f);
+			Row2 = XMVectorSet(axes[0].z, axes[1].z, axes[2].z, 0.0f);
+		}
+
+		XMVECTOR operator()(FXMVECTOR p)const
+		{
+			XMVECTOR d = XMVectorSubtract(p, Origin);
+			XMVECTOR r = XMVectorMultiply(XMVectorSplatZ(d), Row2);
+			r = XMVectorMultiplyAdd(XMVectorSplatY(d), Row1, r);
+			return XMVectorMultiplyAdd(XMVectorSplatX(d), Row0, r);
+		}
+
+#if defined(BOUNDS_SIMD_AVX2)
+		__m256 operator()(__m256 p)const
+		{
+			__m256 d = _mm256_sub_ps(p, Duplicate(Origin));
+			__m256 r = _mm256_mul_ps(_mm256_permute_ps(d, _MM_SHUFFLE(2, 2, 2, 2)), Duplicate(Row2));
+			r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_permute_ps(d, _MM_SHUFFLE(1, 1, 1, 1)), Duplicate(Row1)));
+			return _mm256_add_ps(r, _mm256_mul_ps(_mm256_permute_ps(d, _MM_SHUFFLE(0, 0, 0, 0)), Duplicate(Row0)));
+		}
+#endif
+
+		XMVECTOR Origin;
+		XMVECTOR Row0;
+		XMVECTOR Row1;
+		XMVECTOR Row2;
+	};
+
+	struct MinMax
+	{
+		XMFLOAT3 Min;
+		XMFLOAT3 Max;
+	};
+
+	// Sums over points taken relative to an origin, for the covariance matrix.
+	struct Moments
+	{
+		double Sum[3] = {};
+		double Square[3] = {}; // xx, yy, zz
+		double Cross[3] = {};  // xy, yz, zx
+	};
+
+	// Runs body(first, last, partial) over the stream, in chunks on the pool when
+	// the stream is large enough to be worth it, and returns the partial results.
+	template<typename Result, typename Body>
+	std::vector<Result> ReduceChunks(size_t count, ThreadPool& pool, const Body& body)
+	{
+		size_t chunkCount = count < BoundsBuilder::ParallelThreshold ? 1 : (count + ChunkSize - 1) / ChunkSize;
+		std::vector<Result> partials(chunkCount);
+
+		if(chunkCount == 1)
+		{
+			body(0, count, partials[0]);
+			return partials;
+		}
+
+		pool.ParallelFor(0, (int)chunkCount, 1, [&](int first, int last)
+		{
+			for(int c = first; c < last; ++c)
+			{
+				size_t begin = (size_t)c*ChunkSize;
+				body(begin, std::min(begin + ChunkSize, count), partials[c]);
+			}
+		});
+		return partials;
+	}
+
+	template<typename Stream, typename Transform>
+	void ReduceMinMax(const Stream& stream, size_t first, size_t last, const Transform& transform, MinMax& out)
+	{
+		XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+		XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+		size_t i = first;
+
+#if defined(BOUNDS_SIMD_AVX2)
+		__m256 min0 = Duplicate(vMin);
+		__m256 max0 = Duplicate(vMax);
+		__m256 min1 = min0;
+		__m256 max1 = max0;
+		for(; i + 4 <= last; i += 4)
+		{
+			__m256 a = transform(Combine(stream.Load(i), stream.Load(i + 1)));
+			__m256 b = transform(Combine(stream.Load(i + 2), stream.Load(i + 3)));
+			min0 = _mm256_min_ps(min0, a);
+			max0 = _mm256_max_ps(max0, a);
+			min1 = _mm256_min_ps(min1, b);
+			max1 = _mm256_max_ps(max1, b);
+		}
+		min0 = _mm256_min_ps(min0, min1);
+		max0 = _mm256_max_ps(max0, max1);
+		vMin = _mm_min_ps(_mm256_castps256_ps128(min0), _mm256_extractf128_ps(min0, 1));
+		vMax = _mm_max_ps(_mm256_castps256_ps128(max0), _mm256_extractf128_ps(max0, 1));
+#else
+		XMVECTOR vMin1 = vMin;
+		XMVECTOR vMax1 = vMax;
+		for(; i + 2 <= last; i += 2)
+		{
+			XMVECTOR a = transform(stream.Load(i));
+			XMVECTOR b = transform(stream.Load(i + 1));
+			vMin = XMVectorMin(vMin, a);
+			vMax = XMVectorMax(vMax, a);
+			vMin1 = XMVectorMin(vMin1, b);
+			vMax1 = XMVectorMax(vMax1, b);
+		}
+		vMin = XMVectorMin(vMin, vMin1);
+		vMax = XMVectorMax(vMax, vMax1);
+#endif
+
+		for(; i < last; ++i)
+		{
+			XMVECTOR p = transform(stream.Load(i));
+			vMin = XMVectorMin(vMin, p);
+			vMax = XMVectorMax(vMax, p);
+		}
+
+		XMStoreFloat3(&out.Min, vMin);
+		XMStoreFloat3(&out.Max, vMax);
+	}
+
+	template<typename Stream>
+	float ReduceMaxDistanceSq(const Stream& stream, size_t first, size_t last, FXMVECTOR center)
+	{
+		XMVECTOR vBest = XMVectorZero();
+		size_t i = first;
+
+#if defined(BOUNDS_SIMD_AVX2)
+		const __m256 c = Duplicate(center);
+		__m256 best0 = _mm256_setzero_ps();
+		__m256 best1 = best0;
+		for(; i + 4 <= last; i += 4)
+		{
+			__m256 a = _mm256_sub_ps(Combine(stream.Load(i), stream.Load(i + 1)), c);
+			__m256 b = _mm256_sub_ps(Combine(stream.Load(i + 2), stream.Load(i + 3)), c);
+			best0 = _mm256_max_ps(best0, _mm256_dp_ps(a, a, 0x7f));
+			best1 = _mm256_max_ps(best1, _mm256_dp_ps(b, b, 0x7f));
+		}
+		best0 = _mm256_max_ps(best0, best1);
+		vBest = _mm_max_ps(_mm256_castps256_ps128(best0), _mm256_extractf128_ps(best0, 1));
+#else
+		XMVECTOR vBest1 = vBest;
+		for(; i + 2 <= last; i += 2)
+		{
+			vBest = XMVectorMax(vBest, XMVector3LengthSq(XMVectorSubtract(stream.Load(i), center)));
+			vBest1 = XMVectorMax(vBest1, XMVector3LengthSq(XMVectorSubtract(stream.Load(i + 1), center)));
+		}
+		vBest = XMVectorMax(vBest, vBest1);
+#endif
+
+		for(; i < last; ++i)
+			vBest = XMVectorMax(vBest, XMVector3LengthSq(XMVectorSubtract(stream.Load(i), center)));
+
+		return XMVectorGetX(vBest);
+	}
+
+	template<typename Stream>
+	void ReduceMoments(const Stream& stream, size_t first, size_t last, FXMVECTOR origin, Moments& out)
+	{
+		XMVECTOR sum = XMVectorZero();
+		XMVECTOR square = XMVectorZero();
+		XMVECTOR cross = XMVectorZero();
+		size_t i = first;
+
+#if defined(BOUNDS_SIMD_AVX2)
+		const __m256 o = Duplicate(origin);
+		__m256 sum8 = _mm256_setzero_ps();
+		__m256 square8 = sum8;
+		__m256 cross8 = sum8;
+		for(; i + 2 <= last; i += 2)
+		{
+			__m256 d = _mm256_sub_ps(Combine(stream.Load(i), stream.Load(i + 1)), o);
+			sum8 = _mm256_add_ps(sum8, d);
+			square8 = _mm256_add_ps(square8, _mm256_mul_ps(d, d));
+			cross8 = _mm256_add_ps(cross8, _mm256_mul_ps(d, _mm256_permute_ps(d, _MM_SHUFFLE(3, 0, 2, 1))));
+		}
+		sum = _mm_add_ps(_mm256_castps256_ps128(sum8), _mm256_extractf128_ps(sum8, 1));
+		square = _mm_add_ps(_mm256_castps256_ps128(square8), _mm256_extractf128_ps(square8, 1));
+		cross = _mm_add_ps(_mm256_castps256_ps128(cross8), _mm256_extractf128_ps(cross8, 1));
+#endif
+
+		for(; i < last; ++i)
+		{
+			XMVECTOR d = XMVectorSubtract(stream.Load(i), origin);
+			sum = XMVectorAdd(sum, d);
+			square = XMVectorMultiplyAdd(d, d, square);
+			cross = XMVectorMultiplyAdd(d, XMVectorSwizzle<1, 2, 0, 3>(d), cross);
+		}
+
+		XMFLOAT3 s, q, c;
+		XMStoreFloat3(&s, sum);
+		XMStoreFloat3(&q, square);
+		XMStoreFloat3(&c, cross);
+		out.Sum[0] = s.x;    out.Sum[1] = s.y;    out.Sum[2] = s.z;
+		out.Square[0] = q.x; out.Square[1] = q.y; out.Square[2] = q.z;
+		out.Cross[0] = c.x;  out.Cross[1] = c.y;  out.Cross[2] = c.z;
+	}
+
+	template<typename Stream, typename Transform>
+	MinMax StreamMinMax(const Stream& stream, const Transform& transform, ThreadPool& pool)
+	{
+		auto partials = ReduceChunks<MinMax>(stream.Count, pool, [&](size_t first, size_t last, MinMax& out)
+		{
+			ReduceMinMax(stream, first, last, transform, out);
+		});
+
+		MinMax result = partials[0];
+		for(size_t c = 1; c < partials.size(); ++c)
+		{
+			result.Min.x = std::min(result.Min.x, partials[c].Min.x);
+			result.Min.y = std::min(result.Min.y, partials[c].Min.y);
+			result.Min.z = std::min(result.Min.z, partials[c].Min.z);
+			result.Max.x = std::max(result.Max.x, partials[c].Max.x);
+			result.Max.y = std::max(result.Max.y, partials[c].Max.y);
+			result.Max.z = std::max(result.Max.z, partials[c].Max.z);
+		}
+		return result;
+	}
+
+	// Cyclic Jacobi rotations on a symmetric 3x3 matrix.  The columns of v end up
+	// holding its eigenvectors.
+	void EigenVectors(double a[3][3], double v[3][3])
+	{
+		for(int i = 0; i < 3; ++i)
+		{
+			for(int j = 0; j < 3; ++j)
+				v[i][j] = i == j ? 1.0 : 0.0;
+		}
+
+		const int pairs[3][2] = { { 0, 1 }, { 0, 2 }, { 1, 2 } };
+		for(int sweep = 0; sweep < 32; ++sweep)
+		{
+			double diagonal = a[0][0]*a[0][0] + a[1][1]*a[1][1] + a[2][2]*a[2][2];
+			double offDiagonal = a[0][1]*a[0][1] + a[0][2]*a[0][2] + a[1][2]*a[1][2];
+			if(offDiagonal <= 1e-24*diagonal)
+				break;
+
+			for(auto& pair : pairs)
+			{
+				int p = pair[0];
+				int q = pair[1];
+				if(a[p][q] == 0.0)
+					continue;
+
+				double theta = (a[q][q] - a[p][p]) / (2.0*a[p][q]);
+				double t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta*theta + 1.0));
+				double c = 1.0 / sqrt(t*t + 1.0);
+				double s = t*c;
+
+				for(int k = 0; k < 3; ++k)
+				{
+					double akp = a[k][p];
+					double akq = a[k][q];
+					a[k][p] = c*akp - s*akq;
+					a[k][q] = s*akp + c*akq;
+				}
+				for(int k = 0; k < 3; ++k)
+				{
+					double apk = a[p][k];
+					double aqk = a[q][k];
+					a[p][k] = c*apk - s*aqk;
+					a[q][k] = s*apk + c*aqk;
+				}
+				for(int k = 0; k < 3; ++k)
+				{
+					double vkp = v[k][p];
+					double vkq = v[k][q];
+					v[k][p] = c*vkp - s*vkq;
+					v[k][q] = s*vkp + c*vkq;
+				}
+			}
+		}
+	}
+
+	template<typename Stream>
+	BoundingBox StreamBox(const Stream& stream, ThreadPool& pool)
+	{
+		BoundingBox box(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f));
+		if(stream.Count == 0)
+			return box;
+
+		MinMax range = StreamMinMax(stream, Identity(), pool);
+		XMVECTOR vMin = XMLoadFloat3(&range.Min);
+		XMVECTOR vMax = XMLoadFloat3(&range.Max);
+		XMStoreFloat3(&box.Center, XMVectorScale(XMVectorAdd(vMin, vMax), 0.5f));
+		XMStoreFloat3(&box.Extents, XMVectorScale(XMVectorSubtract(vMax, vMin), 0.5f));
+		return box;
+	}
+
+	template<typename Stream>
+	BoundingSphere StreamSphere(const Stream& stream, ThreadPool& pool)
+	{
+		BoundingBox box = StreamBox(stream, pool);
+		BoundingSphere sphere(box.Center, 0.0f);
+		if(stream.Count == 0)
+			return sphere;
+
+		XMVECTOR center = XMLoadFloat3(&box.Center);
+		auto partials = ReduceChunks<float>(stream.Count, pool, [&](size_t first, size_t last, float& out)
+		{
+			out = ReduceMaxDistanceSq(stream, first, last, center);
+		});
+
+		sphere.Radius = sqrtf(*std::max_element(partials.begin(), partials.end()));
+		return sphere;
+	}
+
+	template<typename Stream>
+	BoundingOrientedBox StreamOrientedBox(const Stream& stream, ThreadPool& pool)
+	{
+		BoundingBox box = StreamBox(stream, pool);
+		BoundingOrientedBox obb(box.Center, box.Extents, XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+		if(stream.Count < 3)
+			return obb;
+
+		// Moments about the box centre keep the float sums well conditioned.
+		XMVECTOR origin = XMLoadFloat3(&box.Center);
+		auto partials = ReduceChunks<Moments>(stream.Count, pool, [&](size_t first, size_t last, Moments& out)
+		{
+			ReduceMoments(stream, first, last, origin, out);
+		});
+
+		Moments total;
+		for(auto& partial : partials)
+		{
+			for(int k = 0; k < 3; ++k)
+			{
+				total.Sum[k] += partial.Sum[k];
+				total.Square[k] += partial.Square[k];
+				total.Cross[k] += partial.Cross[k];
+			}
+		}
+
+		double n = (double)stream.Count;
+		double mean[3] = { total.Sum[0] / n, total.Sum[1] / n, total.Sum[2] / n };
+		double covariance[3][3];
+		for(int k = 0; k < 3; ++k)
+			covariance[k][k] = total.Square[k] / n - mean[k]*mean[k];
+		covariance[0][1] = covariance[1][0] = total.Cross[0] / n - mean[0]*mean[1];
+		covariance[1][2] = covariance[2][1] = total.Cross[1] / n - mean[1]*mean[2];
+		covariance[2][0] = covariance[0][2] = total.Cross[2] / n - mean[2]*mean[0];
+
+		double v[3][3];
+		EigenVectors(covariance, v);
+
+		// Right handed frame, so the axes form a rotation.
+		XMFLOAT3 axes[3];
+		XMVECTOR a0 = XMVector3Normalize(XMVectorSet((float)v[0][0], (float)v[1][0], (float)v[2][0], 0.0f));
+		XMVECTOR a1 = XMVector3Normalize(XMVectorSet((float)v[0][1], (float)v[1][1], (float)v[2][1], 0.0f));
+		XMVECTOR a2 = XMVector3Normalize(XMVector3Cross(a0, a1));
+		a1 = XMVector3Cross(a2, a0);
+		XMStoreFloat3(&axes[0], a0);
+		XMStoreFloat3(&axes[1], a1);
+		XMStoreFloat3(&axes[2], a2);
+
+		MinMax local = StreamMinMax(stream, Projection(origin, axes), pool);
+		XMFLOAT3 extents(0.5f*(local.Max.x - local.Min.x), 0.5f*(local.Max.y - local.Min.y), 0.5f*(local.Max.z - local.Min.z));
+		if(extents.x*extents.y*extents.z >= box.Extents.x*box.Extents.y*box.Extents.z)
+			return obb;
+
+		XMVECTOR center = origin;
+		center = XMVectorMultiplyAdd(XMVectorReplicate(0.5f*(local.Min.x + local.Max.x)), a0, center);
+		center = XMVectorMultiplyAdd(XMVectorReplicate(0.5f*(local.Min.y + local.Max.y)), a1, center);
+		center = XMVectorMultiplyAdd(XMVectorReplicate(0.5f*(local.Min.z + local.Max.z)), a2, center);
+
+		XMMATRIX rotation(a0, a1, a2, XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f));
+		XMStoreFloat3(&obb.Center, center);
+		obb.Extents = extents;
+		XMStoreFloat4(&obb.Orientation, XMQuaternionNormalize(XMQuaternionRotationMatrix(rotation)));
+		return obb;
+	}
+
+	LinearStream MakeStream(const XMFLOAT3* positions, size_t stride, size_t vertexCount)
+	{
+		LinearStream stream = { reinterpret_cast<const char*>(positions), stride, vertexCount };
+		return stream;
+	}
+
+	template<typename IndexT>
+	IndexedStream<IndexT> MakeStream(const XMFLOAT3* positions, size_t stride, const IndexT* indices, size_t indexCount)
+	{
+		IndexedStream<IndexT> stream = { reinterpret_cast<const char*>(positions), stride, indices, indexCount };
+		return stream;
+	}
+}
+
+BoundingBox BoundsBuilder::ComputeBox(const XMFLOAT3* positions, size_t stride, size_t vertexCount, ThreadPool& pool)
+{
+	return StreamBox(MakeStream(positions, stride, vertexCount), pool);
+}
+
+BoundingBox BoundsBuilder::ComputeBox(const XMFLOAT3* positions, size_t stride,
+	const uint16* indices, size_t indexCount, ThreadPool& pool)
+{
+	return StreamBox(MakeStream(positions, stride, indices, indexCount), pool);
+}
+
+BoundingBox BoundsBuilder::ComputeBox(const XMFLOAT3* positions, size_t stride,
+	const uint32* indices, size_t indexCount, ThreadPool& pool)
+{
+	return StreamBox(MakeStream(positions, stride, indices, indexCount), pool);
+}
+
+BoundingSphere BoundsBuilder::ComputeSphere(const XMFLOAT3* positions, size_t stride, size_t vertexCount, ThreadPool& pool)
+{
+	return StreamSphere(MakeStream(positions, stride, vertexCount), pool);
+}
+
+BoundingSphere BoundsBuilder::ComputeSphere(const XMFLOAT3* positions, size_t stride,
+	const uint16* indices, size_t indexCount, ThreadPool& pool)
+{
+	return StreamSphere(MakeStream(positions, stride, indices, indexCount), pool);
+}
+
+BoundingSphere BoundsBuilder::ComputeSphere(const XMFLOAT3* positions, size_t stride,
+	const uint32* indices, size_t indexCount, ThreadPool& pool)
+{
+	return StreamSphere(MakeStream(positions, stride, indices, indexCount), pool);
+}
+
+BoundingOrientedBox BoundsBuilder::ComputeOrientedBox(const XMFLOAT3* positions, size_t stride, size_t vertexCount, ThreadPool& pool)
+{
+	return StreamOrientedBox(MakeStream(positions, stride, vertexCount), pool);
+}
+
+BoundingOrientedBox BoundsBuilder::ComputeOrientedBox(const XMFLOAT3* positions, size_t stride,
+	const uint16* indices, size_t indexCount, ThreadPool& pool)
+{
+	return StreamOrientedBox(MakeStream(positions, stride, indices, indexCount), pool);
+}
+
+BoundingOrientedBox BoundsBuilder::ComputeOrientedBox(const XMFLOAT3* positions, size_t stride,
+	const uint32* indices, size_t indexCount, ThreadPool& pool)
+{
+	return StreamOrientedBox(MakeStream(positions, stride, indices, indexCount), pool);
+}
+
+#if defined(_WIN32)
+void BoundsBuilder::ComputeSubmeshBounds(MeshGeometry& geo, ThreadPool& pool)
+{
+	if(geo.VertexBufferCPU == nullptr || geo.IndexBufferCPU == nullptr)
+		return;
+
+	const char* vertices = static_cast<const char*>(geo.VertexBufferCPU->GetBufferPointer());
+	const void* indices = geo.IndexBufferCPU->GetBufferPointer();
+	const size_t stride = geo.VertexByteStride;
+
+	for(auto& arg : geo.DrawArgs)
+	{
+		SubmeshGeometry& submesh = arg.second;
+		const XMFLOAT3* positions = reinterpret_cast<const XMFLOAT3*>(vertices + (ptrdiff_t)submesh.BaseVertexLocation*(ptrdiff_t)stride);
+
+		if(geo.IndexFormat == DXGI_FORMAT_R16_UINT)
+			submesh.Bounds = ComputeBox(positions, stride, static_cast<const uint16*>(indices) + submesh.StartIndexLocation, submesh.IndexCount, pool);
+		else
+			submesh.Bounds = ComputeBox(positions, stride, static_cast<const uint32*>(indices) + submesh.StartIndexLocation, submesh.IndexCount, pool);
+	}
+}
+#endif
@@ -0,0 +1,62 @@
+//***************************************************************************************
+// BoundsBuilder.h
+//
+// Bounding volumes for vertex ranges: axis aligned box, sphere and a PCA fitted
+// oriented box.  Points are reduced with SIMD min/max and sums, and large inputs
+// are split into chunks that are reduced on a ThreadPool and then combined.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <DirectXCollision.h>
+#include "ThreadPool.h"
+
+struct MeshGeometry;
+
+class BoundsBuilder
+{
+public:
+	using uint16 = std::uint16_t;
+	using uint32 = std::uint32_t;
+
+	// Inputs with fewer points than this are reduced on the calling thread.
+	static const size_t ParallelThreshold = 32768;
+
+	// Every function takes a strided position stream (e.g. &vertices[0].Pos and
+	// sizeof(Vertex)), either on its own or through an index list.  Indices are
+	// relative to positions, so pass the base vertex's position for a submesh.
+	// Empty inputs give a zero-sized volume at the origin.
+
+	static DirectX::BoundingBox ComputeBox(const DirectX::XMFLOAT3* positions, size_t stride, size_t vertexCount,
+		ThreadPool& pool = ThreadPool::Shared());
+	static DirectX::BoundingBox ComputeBox(const DirectX::XMFLOAT3* positions, size_t stride,
+		const uint16* indices, size_t indexCount, ThreadPool& pool = ThreadPool::Shared());
+	static DirectX::BoundingBox ComputeBox(const DirectX::XMFLOAT3* positions, size_t stride,
+		const uint32* indices, size_t indexCount, ThreadPool& pool = ThreadPool::Shared());
+
+	// Centred on the box, with the radius of the farthest point.  Never larger than
+	// the sphere around the box.
+	static DirectX::BoundingSphere ComputeSphere(const DirectX::XMFLOAT3* positions, size_t stride, size_t vertexCount,
+		ThreadPool& pool = ThreadPool::Shared());
+	static DirectX::BoundingSphere ComputeSphere(const DirectX::XMFLOAT3* positions, size_t stride,
+		const uint16* indices, size_t indexCount, ThreadPool& pool = ThreadPool::Shared());
+	static DirectX::BoundingSphere ComputeSphere(const DirectX::XMFLOAT3* positions, size_t stride,
+		const uint32* indices, size_t indexCount, ThreadPool& pool = ThreadPool::Shared());
+
+	// Aligned to the principal axes of the points' covariance.  Falls back to the
+	// axis aligned box when that is smaller, so it is never looser than ComputeBox.
+	static DirectX::BoundingOrientedBox ComputeOrientedBox(const DirectX::XMFLOAT3* positions, size_t stride, size_t vertexCount,
+		ThreadPool& pool = ThreadPool::Shared());
+	static DirectX::BoundingOrientedBox ComputeOrientedBox(const DirectX::XMFLOAT3* positions, size_t stride,
+		const uint16* indices, size_t indexCount, ThreadPool& pool = ThreadPool::Shared());
+	static DirectX::BoundingOrientedBox ComputeOrientedBox(const DirectX::XMFLOAT3* positions, size_t stride,
+		const uint32* indices, size_t indexCount, ThreadPool& pool = ThreadPool::Shared());
+
+	// Sets Bounds on every DrawArgs entry from the geometry's CPU copies.  The
+	// position must be the first member of the vertex.  Geometry without a CPU
+	// vertex buffer (e.g. dynamic buffers) is left untouched.  Windows only, since it
+	// reads the geometry's D3D blobs.
+	static void ComputeSubmeshBounds(MeshGeometry& geo, ThreadPool& pool = ThreadPool::Shared());
+};
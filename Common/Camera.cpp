@@ -3,6 +3,7 @@
 //***************************************************************************************
 
 #include "Camera.h"
+#include <cassert>
 
 using namespace DirectX;
 
@@ -93,6 +94,23 @@ float Camera::GetFovX()const
 	return 2.0f*atan(halfWidth / mNearZ);
 }
 
+float Camera::GetProjectedRadius(const XMFLOAT3& center, float radius, float viewportHeight)const
+{
+	float dx = center.x - mPosition.x;
+	float dy = center.y - mPosition.y;
+	float dz = center.z - mPosition.z;
+	float distance = sqrtf(dx*dx + dy*dy + dz*dz);
+
+	// From inside the sphere it can fill the whole view.
+	if(distance <= radius)
+		return viewportHeight;
+
+	// Measure to the near side of the sphere so close, large objects err on the
+	// side of more detail.
+	float pixelsPerUnit = 0.5f*viewportHeight / tanf(0.5f*mFovY);
+	return radius*pixelsPerUnit / (distance - radius);
+}
+
 float Camera::GetNearWindowWidth()const
 {
 	return mAspect * mNearWindowHeight;
@@ -164,6 +182,40 @@ XMMATRIX Camera::GetProj()const
 	return XMLoadFloat4x4(&mProj);
 }
 
+void Camera::GetWorldFrustumPlanes(XMFLOAT4 planes[6])const
+{
+	XMFLOAT4X4 m;
+	XMStoreFloat4x4(&m, XMMatrixMultiply(GetView(), GetProj()));
+
+	// Gribb/Hartmann extraction from the columns of the view-projection matrix;
+	// D3D clips z to [0, w].
+	for(int i = 0; i < 6; ++i)
+	{
+		int axis = i / 2;
+		float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+
+		XMFLOAT4& p = planes[i];
+		if(i == 4)
+		{
+			p = XMFLOAT4(m.m[0][2], m.m[1][2], m.m[2][2], m.m[3][2]);
+		}
+		else
+		{
+			p = XMFLOAT4(
+				m.m[0][3] + sign*m.m[0][axis],
+				m.m[1][3] + sign*m.m[1][axis],
+				m.m[2][3] + sign*m.m[2][axis],
+				m.m[3][3] + sign*m.m[3][axis]);
+		}
+
+		float length = sqrtf(p.x*p.x + p.y*p.y + p.z*p.z);
+		p.x /= length;
+		p.y /= length;
+		p.z /= length;
+		p.w /= length;
+	}
+}
+
 
 XMFLOAT4X4 Camera::GetView4x4f()const
 {
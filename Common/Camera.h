@@ -11,7 +11,8 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
-#include "d3dUtil.h"
+#include <DirectXMath.h>
+#include "MathHelper.h"
 
 class Camera
 {
@@ -41,6 +42,10 @@ public:
 	float GetFovY()const;
 	float GetFovX()const;
 
+	// Approximate on-screen radius, in pixels, of a world space sphere for a
+	// viewport viewportHeight pixels tall.
+	float GetProjectedRadius(const DirectX::XMFLOAT3& center, float radius, float viewportHeight)const;
+
 	// Get near and far plane dimensions in view space coordinates.
 	float GetNearWindowWidth()const;
 	float GetNearWindowHeight()const;
@@ -61,6 +66,11 @@ public:
 	DirectX::XMFLOAT4X4 GetView4x4f()const;
 	DirectX::XMFLOAT4X4 GetProj4x4f()const;
 
+	// World space frustum planes (left, right, bottom, top, near, far), inward
+	// facing and normalized: p is inside when dot(xyz, p) + w >= 0.  Needs an up to
+	// date view matrix.
+	void GetWorldFrustumPlanes(DirectX::XMFLOAT4 planes[6])const;
+
 	// Strafe/Walk the camera a distance d.
 	void Strafe(float d);
 	void Walk(float d);
@@ -0,0 +1,158 @@
+//***************************************************************************************
+// FrustumCuller.cpp
+//***************************************************************************************
+
+#include "FrustumCuller.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define FRUSTUM_SIMD_AVX2 1
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+#if defined(FRUSTUM_SIMD_AVX2)
+	const size_t GroupSize = 8;
+#else
+	const size_t GroupSize = 4;
+#endif
+
+	bool BoxInside(const XMFLOAT4 planes[6], const BoundingBox& box)
+	{
+		for(int p = 0; p < 6; ++p)
+		{
+			const XMFLOAT4& plane = planes[p];
+			float distance = plane.x*box.Center.x + plane.y*box.Center.y + plane.z*box.Center.z + plane.w;
+			float radius = fabsf(plane.x)*box.Extents.x + fabsf(plane.y)*box.Extents.y + fabsf(plane.z)*box.Extents.z;
+			if(distance + radius < 0.0f)
+				return false;
+		}
+		return true;
+	}
+
+	// Culls boxes [first, last) and writes the visible indices to out.
+	size_t CullRange(const XMFLOAT4 planes[6], const BoundingBox* boxes, size_t first, size_t last,
+		FrustumCuller::uint32* out)
+	{
+		size_t visibleCount = 0;
+		size_t i = first;
+
+		// Box centres and extents of a group as structure of arrays.
+		float cx[GroupSize], cy[GroupSize], cz[GroupSize];
+		float ex[GroupSize], ey[GroupSize], ez[GroupSize];
+
+		for(; i + GroupSize <= last; i += GroupSize)
+		{
+			for(size_t k = 0; k < GroupSize; ++k)
+			{
+				const BoundingBox& box = boxes[i + k];
+				cx[k] = box.Center.x;
+				cy[k] = box.Center.y;
+				cz[k] = box.Center.z;
+				ex[k] = box.Extents.x;
+				ey[k] = box.Extents.y;
+				ez[k] = box.Extents.z;
+			}
+
+			unsigned outsideMask;
+
+#if defined(FRUSTUM_SIMD_AVX2)
+			__m256 centerX = _mm256_loadu_ps(cx), centerY = _mm256_loadu_ps(cy), centerZ = _mm256_loadu_ps(cz);
+			__m256 extentX = _mm256_loadu_ps(ex), extentY = _mm256_loadu_ps(ey), extentZ = _mm256_loadu_ps(ez);
+			__m256 outside = _mm256_setzero_ps();
+
+			for(int p = 0; p < 6; ++p)
+			{
+				const XMFLOAT4& plane = planes[p];
+				__m256 distance = _mm256_add_ps(_mm256_add_ps(
+					_mm256_mul_ps(_mm256_set1_ps(plane.x), centerX),
+					_mm256_mul_ps(_mm256_set1_ps(plane.y), centerY)), _mm256_add_ps(
+					_mm256_mul_ps(_mm256_set1_ps(plane.z), centerZ),
+					_mm256_set1_ps(plane.w)));
+				__m256 radius = _mm256_add_ps(_mm256_add_ps(
+					_mm256_mul_ps(_mm256_set1_ps(fabsf(plane.x)), extentX),
+					_mm256_mul_ps(_mm256_set1_ps(fabsf(plane.y)), extentY)),
+					_mm256_mul_ps(_mm256_set1_ps(fabsf(plane.z)), extentZ));
+
+				outside = _mm256_or_ps(outside,
+					_mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_LT_OQ));
+			}
+
+			outsideMask = (unsigned)_mm256_movemask_ps(outside);
+#else
+			XMVECTOR centerX = XMLoadFloat4((const XMFLOAT4*)cx), centerY = XMLoadFloat4((const XMFLOAT4*)cy);
+			XMVECTOR centerZ = XMLoadFloat4((const XMFLOAT4*)cz);
+			XMVECTOR extentX = XMLoadFloat4((const XMFLOAT4*)ex), extentY = XMLoadFloat4((const XMFLOAT4*)ey);
+			XMVECTOR extentZ = XMLoadFloat4((const XMFLOAT4*)ez);
+			XMVECTOR outside = XMVectorFalseInt();
+
+			for(int p = 0; p < 6; ++p)
+			{
+				const XMFLOAT4& plane = planes[p];
+				XMVECTOR distance = XMVectorMultiplyAdd(XMVectorReplicate(plane.x), centerX,
+					XMVectorMultiplyAdd(XMVectorReplicate(plane.y), centerY,
+					XMVectorMultiplyAdd(XMVectorReplicate(plane.z), centerZ, XMVectorReplicate(plane.w))));
+				XMVECTOR radius = XMVectorMultiplyAdd(XMVectorReplicate(fabsf(plane.x)), extentX,
+					XMVectorMultiplyAdd(XMVectorReplicate(fabsf(plane.y)), extentY,
+					XMVectorMultiply(XMVectorReplicate(fabsf(plane.z)), extentZ)));
+
+				outside = XMVectorOrInt(outside, XMVectorLess(XMVectorAdd(distance, radius), XMVectorZero()));
+			}
+
+			XMUINT4 bits;
+			XMStoreUInt4(&bits, outside);
+			outsideMask = (bits.x ? 1u : 0u) | (bits.y ? 2u : 0u) | (bits.z ? 4u : 0u) | (bits.w ? 8u : 0u);
+#endif
+
+			for(size_t k = 0; k < GroupSize; ++k)
+			{
+				if((outsideMask & (1u << k)) == 0)
+					out[visibleCount++] = (FrustumCuller::uint32)(i + k);
+			}
+		}
+
+		for(; i < last; ++i)
+		{
+			if(BoxInside(planes, boxes[i]))
+				out[visibleCount++] = (FrustumCuller::uint32)i;
+		}
+
+		return visibleCount;
+	}
+}
+
+size_t FrustumCuller::Cull(const XMFLOAT4 planes[6], const BoundingBox* boxes, size_t count,
+	uint32* visible, ThreadPool& pool)
+{
+	if(count < ParallelThreshold)
+		return CullRange(planes, boxes, 0, count, visible);
+
+	// Every chunk writes to its own part of visible, then the parts are moved
+	// together in order.
+	const size_t chunkCount = (count + ChunkSize - 1) / ChunkSize;
+	std::vector<size_t> chunkVisible(chunkCount);
+
+	pool.ParallelFor(0, (int)chunkCount, 1, [&](int begin, int end)
+	{
+		for(int c = begin; c < end; ++c)
+		{
+			size_t first = (size_t)c*ChunkSize;
+			size_t last = std::min(first + ChunkSize, count);
+			chunkVisible[c] = CullRange(planes, boxes, first, last, visible + first);
+		}
+	});
+
+	size_t visibleCount = chunkVisible[0];
+	for(size_t c = 1; c < chunkCount; ++c)
+	{
+		std::copy(visible + c*ChunkSize, visible + c*ChunkSize + chunkVisible[c], visible + visibleCount);
+		visibleCount += chunkVisible[c];
+	}
+
+	return visibleCount;
+}
@@ -0,0 +1,32 @@
+//***************************************************************************************
+// FrustumCuller.h
+//
+// Culls world space axis aligned boxes against a frustum, eight boxes at a time
+// with AVX2 (four at a time with DirectXMath otherwise).  Large inputs are split
+// into chunks that are culled on a ThreadPool and compacted afterwards, so the
+// result is the same as a serial pass.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <DirectXCollision.h>
+#include "ThreadPool.h"
+
+class FrustumCuller
+{
+public:
+	using uint32 = std::uint32_t;
+
+	// Inputs with fewer boxes than this are culled on the calling thread.
+	static const size_t ParallelThreshold = 8192;
+	static const size_t ChunkSize = 4096;
+
+	// Writes the indices of the boxes that are at least partly inside the frustum to
+	// visible, in increasing order, and returns how many there are.  visible must
+	// have room for count entries.  planes are inward facing and normalized, as from
+	// Camera::GetWorldFrustumPlanes.  Boxes that straddle a plane's extension
+	// outside the frustum's corners are kept, as usual for a plane test.
+	static size_t Cull(const DirectX::XMFLOAT4 planes[6], const DirectX::BoundingBox* boxes, size_t count,
+		uint32* visible, ThreadPool& pool = ThreadPool::Shared());
+};
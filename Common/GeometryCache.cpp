@@ -0,0 +1,295 @@
+//***************************************************************************************
+// GeometryCache.cpp
+//***************************************************************************************
+
+#include "GeometryCache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#if defined(_WIN32)
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace
+{
+	const std::uint32_t FileMagic = 0x43454F47; // "GEOC"
+	const std::uint64_t FnvOffset = 0xcbf29ce484222325ull;
+	const std::uint64_t FnvPrime = 0x100000001b3ull;
+
+	// Section data is aligned so vertex and index arrays can be read in place.
+	const size_t SectionAlignment = 16;
+
+	struct FileHeader
+	{
+		std::uint32_t Magic;
+		std::uint32_t Version;
+		std::uint64_t Key;
+		std::uint64_t FileSize;
+		std::uint64_t PayloadHash; // everything after the header
+		std::uint32_t SectionCount;
+		std::uint32_t Reserved;
+	};
+
+	struct SectionHeader
+	{
+		char Name[48];
+		std::uint64_t Offset;
+		std::uint64_t ByteSize;
+	};
+
+	std::uint64_t Fnv1a(std::uint64_t hash, const void* data, size_t byteSize)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for(size_t i = 0; i < byteSize; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= FnvPrime;
+		}
+		return hash;
+	}
+
+	size_t AlignUp(size_t value)
+	{
+		return (value + SectionAlignment - 1) & ~(SectionAlignment - 1);
+	}
+}
+
+GeometryCache::Key::Key(const char* name)
+	: mHash(FnvOffset)
+{
+	std::uint32_t version = FormatVersion;
+	Add(&version, sizeof(version));
+	Add(name);
+}
+
+GeometryCache::Key& GeometryCache::Key::Add(const void* data, size_t byteSize)
+{
+	mHash = Fnv1a(mHash, data, byteSize);
+	return *this;
+}
+
+GeometryCache::Key& GeometryCache::Key::Add(const char* text)
+{
+	// Include the terminator so ("ab", "c") and ("a", "bc") hash differently.
+	return Add(text, strlen(text) + 1);
+}
+
+GeometryCache::Key& GeometryCache::Key::Add(float value)
+{
+	return Add(&value, sizeof(value));
+}
+
+GeometryCache::Key& GeometryCache::Key::Add(std::uint32_t value)
+{
+	return Add(&value, sizeof(value));
+}
+
+GeometryCache::Key& GeometryCache::Key::Add(const char* generator, std::initializer_list<float> params)
+{
+	return Add(generator, params.begin(), params.size());
+}
+
+GeometryCache::Key& GeometryCache::Key::Add(const char* generator, const float* params, size_t count)
+{
+	Add(generator);
+	Add((std::uint32_t)count);
+	for(size_t i = 0; i < count; ++i)
+		Add(params[i]);
+	return *this;
+}
+
+std::uint64_t GeometryCache::Key::Value()const
+{
+	return mHash;
+}
+
+GeometryCache::Entry::~Entry()
+{
+#if defined(_WIN32)
+	if(mData != nullptr)
+		UnmapViewOfFile(mData);
+	if(mMapping != nullptr)
+		CloseHandle(mMapping);
+	if(mFile != nullptr)
+		CloseHandle(mFile);
+#else
+	if(mData != nullptr)
+		munmap(const_cast<unsigned char*>(mData), mSize);
+#endif
+}
+
+const void* GeometryCache::Entry::Find(const char* name, size_t& byteSize)const
+{
+	const FileHeader* header = reinterpret_cast<const FileHeader*>(mData);
+	const SectionHeader* sections = reinterpret_cast<const SectionHeader*>(mData + sizeof(FileHeader));
+
+	for(std::uint32_t i = 0; i < header->SectionCount; ++i)
+	{
+		if(strncmp(sections[i].Name, name, sizeof(sections[i].Name)) == 0)
+		{
+			byteSize = (size_t)sections[i].ByteSize;
+			return mData + sections[i].Offset;
+		}
+	}
+
+	return nullptr;
+}
+
+GeometryCache::GeometryCache(const std::string& directory)
+	: mDirectory(directory)
+{
+}
+
+std::string GeometryCache::PathFor(const Key& key)const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.geo", (unsigned long long)key.Value());
+	return mDirectory + "/" + name;
+}
+
+std::unique_ptr<GeometryCache::Entry> GeometryCache::Load(const Key& key)const
+{
+	std::string path = PathFor(key);
+	std::unique_ptr<Entry> entry(new Entry());
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(file == INVALID_HANDLE_VALUE)
+		return nullptr;
+	entry->mFile = file;
+
+	LARGE_INTEGER fileSize;
+	if(!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(FileHeader))
+		return nullptr;
+	entry->mSize = (size_t)fileSize.QuadPart;
+
+	entry->mMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(entry->mMapping == nullptr)
+		return nullptr;
+
+	entry->mData = static_cast<const unsigned char*>(MapViewOfFile(entry->mMapping, FILE_MAP_READ, 0, 0, 0));
+	if(entry->mData == nullptr)
+		return nullptr;
+#else
+	int file = open(path.c_str(), O_RDONLY);
+	if(file < 0)
+		return nullptr;
+
+	struct stat info;
+	if(fstat(file, &info) != 0 || info.st_size < (off_t)sizeof(FileHeader))
+	{
+		close(file);
+		return nullptr;
+	}
+	entry->mSize = (size_t)info.st_size;
+
+	void* data = mmap(nullptr, entry->mSize, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if(data == MAP_FAILED)
+		return nullptr;
+	entry->mData = static_cast<const unsigned char*>(data);
+#endif
+
+	// Anything unexpected is treated as a miss so the caller regenerates and
+	// overwrites the file.
+	const FileHeader* header = reinterpret_cast<const FileHeader*>(entry->mData);
+	if(header->Magic != FileMagic || header->Version != FormatVersion ||
+		header->Key != key.Value() || header->FileSize != entry->mSize)
+		return nullptr;
+
+	size_t tableEnd = sizeof(FileHeader) + (size_t)header->SectionCount*sizeof(SectionHeader);
+	if(tableEnd > entry->mSize)
+		return nullptr;
+
+	const SectionHeader* sections = reinterpret_cast<const SectionHeader*>(entry->mData + sizeof(FileHeader));
+	for(std::uint32_t i = 0; i < header->SectionCount; ++i)
+	{
+		if(sections[i].Offset < tableEnd || sections[i].Offset > entry->mSize ||
+			sections[i].ByteSize > entry->mSize - sections[i].Offset)
+			return nullptr;
+	}
+
+	if(Fnv1a(FnvOffset, entry->mData + sizeof(FileHeader), entry->mSize - sizeof(FileHeader)) != header->PayloadHash)
+		return nullptr;
+
+	return entry;
+}
+
+bool GeometryCache::Store(const Key& key, const std::vector<Section>& sections)const
+{
+	std::vector<SectionHeader> table(sections.size());
+	size_t offset = AlignUp(sizeof(FileHeader) + sections.size()*sizeof(SectionHeader));
+	for(size_t i = 0; i < sections.size(); ++i)
+	{
+		if(sections[i].Name.size() >= sizeof(table[i].Name))
+			return false;
+
+		memset(table[i].Name, 0, sizeof(table[i].Name));
+		memcpy(table[i].Name, sections[i].Name.c_str(), sections[i].Name.size());
+		table[i].Offset = offset;
+		table[i].ByteSize = sections[i].ByteSize;
+		offset = AlignUp(offset + sections[i].ByteSize);
+	}
+
+	// Lay the whole file out in memory; the geometry this is used for is a few
+	// megabytes at most.
+	std::vector<unsigned char> file(offset, 0);
+	if(!table.empty())
+		memcpy(&file[sizeof(FileHeader)], table.data(), table.size()*sizeof(SectionHeader));
+	for(size_t i = 0; i < sections.size(); ++i)
+	{
+		if(sections[i].ByteSize > 0)
+			memcpy(&file[(size_t)table[i].Offset], sections[i].Data, sections[i].ByteSize);
+	}
+
+	FileHeader header = {};
+	header.Magic = FileMagic;
+	header.Version = FormatVersion;
+	header.Key = key.Value();
+	header.FileSize = file.size();
+	header.PayloadHash = Fnv1a(FnvOffset, &file[sizeof(FileHeader)], file.size() - sizeof(FileHeader));
+	header.SectionCount = (std::uint32_t)sections.size();
+	memcpy(&file[0], &header, sizeof(header));
+
+#if defined(_WIN32)
+	CreateDirectoryA(mDirectory.c_str(), nullptr);
+#else
+	mkdir(mDirectory.c_str(), 0755);
+#endif
+
+	std::string path = PathFor(key);
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream fout(tempPath, std::ios::binary | std::ios::trunc);
+		if(!fout)
+			return false;
+
+		fout.write(reinterpret_cast<const char*>(file.data()), (std::streamsize)file.size());
+		if(!fout)
+		{
+			fout.close();
+			std::remove(tempPath.c_str());
+			return false;
+		}
+	}
+
+#if defined(_WIN32)
+	bool moved = MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	bool moved = std::rename(tempPath.c_str(), path.c_str()) == 0;
+#endif
+	if(!moved)
+		std::remove(tempPath.c_str());
+
+	return moved;
+}
@@ -0,0 +1,142 @@
+//***************************************************************************************
+// GeometryCache.h
+//
+// Content addressed on-disk cache for generated geometry.  A Key hashes the names
+// and parameters that produced some geometry; the cache file for that key holds a
+// set of named byte sections (vertex buffer, index buffer, submesh table, ...).
+// Later runs memory-map the file and read the sections in place instead of
+// generating the geometry again.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+
+// Fixed layout submesh record for the "submeshes" section of a cache file.
+struct CachedSubmesh
+{
+	char Name[64] = {};
+	std::uint32_t IndexCount = 0;
+	std::uint32_t StartIndexLocation = 0;
+	std::int32_t BaseVertexLocation = 0;
+	float LodError = 0.0f;
+	DirectX::XMFLOAT3 BoundsCenter = { 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT3 BoundsExtents = { 0.0f, 0.0f, 0.0f };
+};
+
+class GeometryCache
+{
+public:
+	// Bump when the file layout changes; older files then simply miss.
+	static const std::uint32_t FormatVersion = 1;
+
+	// 64-bit FNV-1a over everything that went into the geometry.
+	class Key
+	{
+	public:
+		explicit Key(const char* name);
+
+		Key& Add(const void* data, size_t byteSize);
+		Key& Add(const char* text);
+		Key& Add(float value);
+		Key& Add(std::uint32_t value);
+
+		// Generator name followed by its parameters, e.g.
+		// key.Add("CreateSphere", { 0.5f, 20, 20 }).
+		Key& Add(const char* generator, std::initializer_list<float> params);
+		Key& Add(const char* generator, const float* params, size_t count);
+
+		std::uint64_t Value()const;
+
+	private:
+		std::uint64_t mHash;
+	};
+
+	struct Section
+	{
+		std::string Name;
+		const void* Data = nullptr;
+		size_t ByteSize = 0;
+	};
+
+	// A cache file mapped read-only.  Pointers returned by Find stay valid until the
+	// entry is destroyed.
+	class Entry
+	{
+	public:
+		Entry(const Entry& rhs) = delete;
+		Entry& operator=(const Entry& rhs) = delete;
+		~Entry();
+
+		// Returns nullptr if the file has no section with that name.
+		const void* Find(const char* name, size_t& byteSize)const;
+
+		// Same, for sections holding an array of T.
+		template<typename T>
+		const T* FindArray(const char* name, size_t& count)const
+		{
+			size_t byteSize = 0;
+			const void* data = Find(name, byteSize);
+			if(data == nullptr || byteSize % sizeof(T) != 0)
+				return nullptr;
+
+			count = byteSize / sizeof(T);
+			return static_cast<const T*>(data);
+		}
+
+		// Copies an array section into out.  Returns false if it is missing.
+		template<typename T>
+		bool Read(const char* name, std::vector<T>& out)const
+		{
+			size_t count = 0;
+			const T* data = FindArray<T>(name, count);
+			if(data == nullptr)
+				return false;
+
+			out.assign(data, data + count);
+			return true;
+		}
+
+	private:
+		friend class GeometryCache;
+		Entry() = default;
+
+		const unsigned char* mData = nullptr;
+		size_t mSize = 0;
+
+		// Platform mapping handles.
+		void* mFile = nullptr;
+		void* mMapping = nullptr;
+	};
+
+	template<typename T>
+	static Section MakeSection(const std::string& name, const std::vector<T>& data)
+	{
+		Section section;
+		section.Name = name;
+		section.Data = data.data();
+		section.ByteSize = data.size()*sizeof(T);
+		return section;
+	}
+
+	// Files are kept in directory, which is created on the first Store.
+	explicit GeometryCache(const std::string& directory);
+
+	// nullptr when there is no file for the key, or the file is from another format
+	// version, truncated or corrupt.
+	std::unique_ptr<Entry> Load(const Key& key)const;
+
+	// Writes the sections to the key's file.  The file is written under a temporary
+	// name and renamed into place, so a crash never leaves a half written entry.
+	bool Store(const Key& key, const std::vector<Section>& sections)const;
+
+	std::string PathFor(const Key& key)const;
+
+private:
+	std::string mDirectory;
+};
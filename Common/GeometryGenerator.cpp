@@ -3,13 +3,194 @@
 //***************************************************************************************
 
 #include "GeometryGenerator.h"
+#include "ThreadPool.h"
 #include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define GEOGEN_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define GEOGEN_SIMD_SSE2 1
+#endif
 
 using namespace DirectX;
 
+namespace
+{
+	// Open-addressing hash from an undirected edge (pair of vertex indices) to the
+	// index of its midpoint vertex.  Keys are stored as (min << 32 | max) in one flat
+	// array, so a lookup is a multiply, a shift and usually a single cache line.
+	const std::uint64_t EmptyEdgeKey = ~0ull;
+
+	class EdgeMidpointMap
+	{
+	public:
+		// keys/values are caller-owned so their capacity survives between meshes.
+		EdgeMidpointMap(std::vector<std::uint64_t>& keys, std::vector<std::uint32_t>& values, size_t maxEdges) :
+			mKeys(keys),
+			mValues(values)
+		{
+			size_t capacity = 16;
+			while(capacity < 2*maxEdges)
+				capacity <<= 1;
+
+			mShift = 64;
+			for(size_t c = capacity; c > 1; c >>= 1)
+				--mShift;
+
+			mKeys.assign(capacity, EmptyEdgeKey);
+			mValues.resize(capacity);
+		}
+
+		// Returns the midpoint stored for edge (a, b), inserting newIndex if the
+		// edge has not been seen yet.
+		std::uint32_t FindOrInsert(std::uint32_t a, std::uint32_t b, std::uint32_t newIndex)
+		{
+			std::uint64_t key = a < b ?
+				((std::uint64_t)a << 32) | b :
+				((std::uint64_t)b << 32) | a;
+
+			size_t mask = mKeys.size() - 1;
+			size_t slot = (size_t)((key*0x9E3779B97F4A7C15ull) >> mShift);
+			while(true)
+			{
+				if(mKeys[slot] == key)
+					return mValues[slot];
+
+				if(mKeys[slot] == EmptyEdgeKey)
+				{
+					mKeys[slot] = key;
+					mValues[slot] = newIndex;
+					return newIndex;
+				}
+
+				slot = (slot + 1) & mask;
+			}
+		}
+
+	private:
+		std::vector<std::uint64_t>& mKeys;
+		std::vector<std::uint32_t>& mValues;
+		int mShift = 0;
+	};
+
+	// Exact output sizes of a box face grid or icosahedron after n subdivisions.
+	// Midpoints are shared, so a subdivided face keeps (2^n+1)^2 vertices.
+	std::uint32_t SubdividedBoxVertexCount(std::uint32_t n)  { return 6*((1u << n) + 1)*((1u << n) + 1); }
+	std::uint32_t SubdividedBoxIndexCount(std::uint32_t n)   { return 36u << (2*n); }
+	std::uint32_t SubdividedIcosaVertexCount(std::uint32_t n) { return (10u << (2*n)) + 2; }
+	std::uint32_t SubdividedIcosaIndexCount(std::uint32_t n)  { return 60u << (2*n); }
+
+	// Copies count 32-bit indices into dst as 16 bits.  Returns the OR of every
+	// source index so the caller can tell whether anything was truncated.
+	std::uint32_t NarrowIndices(const std::uint32_t* src, size_t count, std::uint16_t* dst)
+	{
+		size_t i = 0;
+		std::uint32_t bits = 0;
+
+#if defined(GEOGEN_SIMD_AVX2)
+		__m256i orBits = _mm256_setzero_si256();
+		for(; i + 16 <= count; i += 16)
+		{
+			__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+			__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 8));
+			orBits = _mm256_or_si256(orBits, _mm256_or_si256(a, b));
+
+			// packus works within 128-bit lanes; put the 64-bit quarters back in order.
+			__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+		}
+
+		__m128i orBits128 = _mm_or_si128(_mm256_castsi256_si128(orBits), _mm256_extracti128_si256(orBits, 1));
+		orBits128 = _mm_or_si128(orBits128, _mm_shuffle_epi32(orBits128, 0x4E));
+		orBits128 = _mm_or_si128(orBits128, _mm_shuffle_epi32(orBits128, 0xB1));
+		bits = (std::uint32_t)_mm_cvtsi128_si32(orBits128);
+#elif defined(GEOGEN_SIMD_SSE2)
+		// SSE2 only has a signed 32->16 pack, so bias into the signed range first and
+		// flip the sign bit back afterwards.
+		const __m128i bias32 = _mm_set1_epi32(0x8000);
+		const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+
+		__m128i orBits = _mm_setzero_si128();
+		for(; i + 8 <= count; i += 8)
+		{
+			__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4));
+			orBits = _mm_or_si128(orBits, _mm_or_si128(a, b));
+
+			__m128i packed = _mm_packs_epi32(_mm_sub_epi32(a, bias32), _mm_sub_epi32(b, bias32));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(packed, bias16));
+		}
+
+		orBits = _mm_or_si128(orBits, _mm_shuffle_epi32(orBits, 0x4E));
+		orBits = _mm_or_si128(orBits, _mm_shuffle_epi32(orBits, 0xB1));
+		bits = (std::uint32_t)_mm_cvtsi128_si32(orBits);
+#endif
+
+		for(; i < count; ++i)
+		{
+			bits |= src[i];
+			dst[i] = static_cast<std::uint16_t>(src[i]);
+		}
+
+		return bits;
+	}
+}
+
+std::vector<GeometryGenerator::uint16>& GeometryGenerator::MeshData::GetIndices16()
+{
+	if(!Indices32.empty() && mIndices16.size() != Indices32.size())
+	{
+		mIndices16.resize(Indices32.size());
+		uint32 bits = NarrowIndices(Indices32.data(), Indices32.size(), mIndices16.data());
+		if(bits > 0xFFFF)
+		{
+			mIndices16.clear();
+			throw std::overflow_error("MeshData::GetIndices16: mesh has indices that do not fit in 16 bits.");
+		}
+	}
+
+	return mIndices16;
+}
+
+GeometryGenerator::IndexSpan GeometryGenerator::MeshData::GetIndices()
+{
+	IndexSpan span;
+	if(Fits16BitIndices())
+	{
+		GetIndices16();
+		std::vector<uint32>().swap(Indices32);
+
+		span.Data = mIndices16.data();
+		span.Count = mIndices16.size();
+		span.Stride = sizeof(uint16);
+	}
+	else
+	{
+		span.Data = Indices32.data();
+		span.Count = Indices32.size();
+		span.Stride = sizeof(uint32);
+	}
+
+	return span;
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions)
 {
     MeshData meshData;
+    CreateBox(width, height, depth, numSubdivisions, meshData);
+    return meshData;
+}
+
+void GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions, MeshData& meshData)
+{
+    // Put a cap on the number of subdivisions.
+    numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
+
+    meshData.Reset(SubdividedBoxVertexCount(numSubdivisions), SubdividedBoxIndexCount(numSubdivisions));
 
     //
 	// Create the vertices.
@@ -91,18 +272,22 @@ GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float heig
 
 	meshData.Indices32.assign(&i[0], &i[36]);
 
-    // Put a cap on the number of subdivisions.
-    numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
-
     for(uint32 i = 0; i < numSubdivisions; ++i)
         Subdivide(meshData);
-
-    return meshData;
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount)
 {
     MeshData meshData;
+    CreateSphere(radius, sliceCount, stackCount, meshData);
+    return meshData;
+}
+
+void GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount, MeshData& meshData)
+{
+    // Two poles plus stackCount-1 rings; a triangle fan at each pole and a quad
+    // strip between every pair of rings.
+    meshData.Reset(2 + (stackCount-1)*(sliceCount+1), 6*sliceCount*(stackCount-1));
 
 	//
 	// Compute the vertices stating at the top pole and moving down the stacks.
@@ -207,19 +392,10 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 		meshData.Indices32.push_back(baseIndex+i);
 		meshData.Indices32.push_back(baseIndex+i+1);
 	}
-
-    return meshData;
 }
  
 void GeometryGenerator::Subdivide(MeshData& meshData)
 {
-	// Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
-
-
-	meshData.Vertices.resize(0);
-	meshData.Indices32.resize(0);
-
 	//       v1
 	//       *
 	//      / \
@@ -230,47 +406,39 @@ void GeometryGenerator::Subdivide(MeshData& meshData)
 	// *-----*-----*
 	// v0    m2     v2
 
-	uint32 numTris = (uint32)inputCopy.Indices32.size()/3;
-	for(uint32 i = 0; i < numTris; ++i)
-	{
-		Vertex v0 = inputCopy.Vertices[ inputCopy.Indices32[i*3+0] ];
-		Vertex v1 = inputCopy.Vertices[ inputCopy.Indices32[i*3+1] ];
-		Vertex v2 = inputCopy.Vertices[ inputCopy.Indices32[i*3+2] ];
-
-		//
-		// Generate the midpoints.
-		//
-
-        Vertex m0 = MidPoint(v0, v1);
-        Vertex m1 = MidPoint(v1, v2);
-        Vertex m2 = MidPoint(v0, v2);
-
-		//
-		// Add new geometry.
-		//
-
-		meshData.Vertices.push_back(v0); // 0
-		meshData.Vertices.push_back(v1); // 1
-		meshData.Vertices.push_back(v2); // 2
-		meshData.Vertices.push_back(m0); // 3
-		meshData.Vertices.push_back(m1); // 4
-		meshData.Vertices.push_back(m2); // 5
- 
-		meshData.Indices32.push_back(i*6+0);
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+5);
+	// The input vertices are kept where they are and every edge gets exactly one
+	// midpoint, shared by the triangles on both sides of it.  Triangle i expands to
+	// indices [12i, 12i+12), which never overlaps an unread input triangle when
+	// walking backwards, so the index list is rewritten in place.
+	uint32 numTris = (uint32)meshData.Indices32.size()/3;
 
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+5);
+	EdgeMidpointMap midpoints(mEdgeKeys, mEdgeMidpoints, 3*numTris);
 
-		meshData.Indices32.push_back(i*6+5);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+2);
+	auto midpointIndex = [&](uint32 a, uint32 b)
+	{
+		uint32 next = (uint32)meshData.Vertices.size();
+		uint32 index = midpoints.FindOrInsert(a, b, next);
+		if(index == next)
+			meshData.Vertices.push_back(MidPoint(meshData.Vertices[a], meshData.Vertices[b]));
+		return index;
+	};
 
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+1);
-		meshData.Indices32.push_back(i*6+4);
+	meshData.Indices32.resize(numTris*12);
+	for(uint32 i = numTris; i-- > 0; )
+	{
+		uint32 v0 = meshData.Indices32[i*3+0];
+		uint32 v1 = meshData.Indices32[i*3+1];
+		uint32 v2 = meshData.Indices32[i*3+2];
+
+		uint32 m0 = midpointIndex(v0, v1);
+		uint32 m1 = midpointIndex(v1, v2);
+		uint32 m2 = midpointIndex(v0, v2);
+
+		uint32* out = &meshData.Indices32[i*12];
+		out[0] = v0; out[1]  = m0; out[2]  = m2;
+		out[3] = m0; out[4]  = m1; out[5]  = m2;
+		out[6] = m2; out[7]  = m1; out[8]  = v2;
+		out[9] = m0; out[10] = v1; out[11] = m1;
 	}
 }
 
@@ -307,10 +475,17 @@ GeometryGenerator::Vertex GeometryGenerator::MidPoint(const Vertex& v0, const Ve
 GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uint32 numSubdivisions)
 {
     MeshData meshData;
+    CreateGeosphere(radius, numSubdivisions, meshData);
+    return meshData;
+}
 
+void GeometryGenerator::CreateGeosphere(float radius, uint32 numSubdivisions, MeshData& meshData)
+{
 	// Put a cap on the number of subdivisions.
     numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
 
+    meshData.Reset(SubdividedIcosaVertexCount(numSubdivisions), SubdividedIcosaIndexCount(numSubdivisions));
+
 	// Approximate a sphere by tessellating an icosahedron.
 
 	const float X = 0.525731f; 
@@ -375,13 +550,19 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
 		XMVECTOR T = XMLoadFloat3(&meshData.Vertices[i].TangentU);
 		XMStoreFloat3(&meshData.Vertices[i].TangentU, XMVector3Normalize(T));
 	}
-
-    return meshData;
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount)
 {
     MeshData meshData;
+    CreateCylinder(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
+    return meshData;
+}
+
+void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData)
+{
+    // Side rings plus two caps, each a ring and a center vertex.
+    meshData.Reset((stackCount+1)*(sliceCount+1) + 2*(sliceCount+2), 6*sliceCount*stackCount + 6*sliceCount);
 
 	//
 	// Build Stacks.
@@ -469,8 +650,6 @@ GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius
 
 	BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
 	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-
-    return meshData;
 }
 
 void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius, float height,
@@ -492,11 +671,11 @@ void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius,
 		float u = x/height + 0.5f;
 		float v = z/height + 0.5f;
 
-		meshData.Vertices.push_back( Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
+		meshData.Vertices.emplace_back(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v);
 	}
 
 	// Cap center vertex.
-	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
+	meshData.Vertices.emplace_back(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f);
 
 	// Index of center vertex.
 	uint32 centerIndex = (uint32)meshData.Vertices.size()-1;
@@ -531,11 +710,11 @@ void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadi
 		float u = x/height + 0.5f;
 		float v = z/height + 0.5f;
 
-		meshData.Vertices.push_back( Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
+		meshData.Vertices.emplace_back(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v);
 	}
 
 	// Cap center vertex.
-	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
+	meshData.Vertices.emplace_back(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f);
 
 	// Cache the index of center vertex.
 	uint32 centerIndex = (uint32)meshData.Vertices.size()-1;
@@ -551,10 +730,17 @@ void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadi
 GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n)
 {
     MeshData meshData;
+    CreateGrid(width, depth, m, n, meshData);
+    return meshData;
+}
 
+void GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n, MeshData& meshData)
+{
 	uint32 vertexCount = m*n;
 	uint32 faceCount   = (m-1)*(n-1)*2;
 
+	meshData.Reset(vertexCount, faceCount*3);
+
 	//
 	// Create the vertices.
 	//
@@ -609,13 +795,112 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float dep
 			k += 6; // next quad
 		}
 	}
+}
 
-    return meshData;
+GeometryGenerator::uint32 GeometryGenerator::GridTileCount(uint32 vertexCount, uint32 tileSize)
+{
+	// Tiles overlap by one vertex, so each one adds tileSize-1 quads.
+	return (vertexCount - 1 + tileSize - 2) / (tileSize - 1);
+}
+
+void GeometryGenerator::CreateGridTile(float width, float depth, uint32 m, uint32 n, uint32 tileSize,
+	uint32 tileRow, uint32 tileColumn, GridTile& tile)
+{
+	assert(m >= 2 && n >= 2);
+	assert(tileSize >= 2 && tileSize <= 256);
+
+	tile.TileRow = tileRow;
+	tile.TileColumn = tileColumn;
+	tile.FirstRow = tileRow*(tileSize - 1);
+	tile.FirstColumn = tileColumn*(tileSize - 1);
+	tile.RowCount = std::min(tileSize, m - tile.FirstRow);
+	tile.ColumnCount = std::min(tileSize, n - tile.FirstColumn);
+
+	const uint32 rows = tile.RowCount;
+	const uint32 columns = tile.ColumnCount;
+
+	// Same arithmetic as CreateGrid so shared edges match exactly.
+	float halfWidth = 0.5f*width;
+	float halfDepth = 0.5f*depth;
+
+	float dx = width / (n-1);
+	float dz = depth / (m-1);
+
+	float du = 1.0f / (n-1);
+	float dv = 1.0f / (m-1);
+
+	tile.Vertices.resize(rows*columns);
+	for(uint32 i = 0; i < rows; ++i)
+	{
+		uint32 gi = tile.FirstRow + i;
+		float z = halfDepth - gi*dz;
+		for(uint32 j = 0; j < columns; ++j)
+		{
+			uint32 gj = tile.FirstColumn + j;
+			float x = -halfWidth + gj*dx;
+
+			Vertex& v = tile.Vertices[i*columns + j];
+			v.Position = XMFLOAT3(x, 0.0f, z);
+			v.Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
+			v.TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
+			v.TexC.x = gj*du;
+			v.TexC.y = gi*dv;
+		}
+	}
+
+	tile.Indices.resize((rows-1)*(columns-1)*6);
+
+	uint32 k = 0;
+	for(uint32 i = 0; i < rows-1; ++i)
+	{
+		for(uint32 j = 0; j < columns-1; ++j)
+		{
+			tile.Indices[k]   = (uint16)(i*columns+j);
+			tile.Indices[k+1] = (uint16)(i*columns+j+1);
+			tile.Indices[k+2] = (uint16)((i+1)*columns+j);
+
+			tile.Indices[k+3] = (uint16)((i+1)*columns+j);
+			tile.Indices[k+4] = (uint16)(i*columns+j+1);
+			tile.Indices[k+5] = (uint16)((i+1)*columns+j+1);
+
+			k += 6; // next quad
+		}
+	}
+}
+
+void GeometryGenerator::CreateGridTiles(float width, float depth, uint32 m, uint32 n, uint32 tileSize,
+	const std::function<void(const GridTile& tile)>& callback, ThreadPool* pool)
+{
+	const uint32 tileRows = GridTileCount(m, tileSize);
+	const uint32 tileColumns = GridTileCount(n, tileSize);
+	const int tileCount = (int)(tileRows*tileColumns);
+
+	auto generate = [&](int first, int last)
+	{
+		GridTile tile;
+		for(int t = first; t < last; ++t)
+		{
+			CreateGridTile(width, depth, m, n, tileSize, (uint32)t / tileColumns, (uint32)t % tileColumns, tile);
+			callback(tile);
+		}
+	};
+
+	if(pool != nullptr)
+		pool->ParallelFor(0, tileCount, 1, generate);
+	else
+		generate(0, tileCount);
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, float w, float h, float depth)
 {
     MeshData meshData;
+    CreateQuad(x, y, w, h, depth, meshData);
+    return meshData;
+}
+
+void GeometryGenerator::CreateQuad(float x, float y, float w, float h, float depth, MeshData& meshData)
+{
+	meshData.Reset(4, 6);
 
 	meshData.Vertices.resize(4);
 	meshData.Indices32.resize(6);
@@ -652,6 +937,4 @@ GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, floa
 	meshData.Indices32[3] = 0;
 	meshData.Indices32[4] = 2;
 	meshData.Indices32[5] = 3;
-
-    return meshData;
 }
@@ -16,8 +16,11 @@
 
 #include <cstdint>
 #include <DirectXMath.h>
+#include <functional>
 #include <vector>
 
+class ThreadPool;
+
 class GeometryGenerator
 {
 public:
@@ -53,44 +56,96 @@ public:
         DirectX::XMFLOAT2 TexC;
 	};
 
+	// Read-only view of a mesh's index list in whichever width it is stored in.
+	// Stays valid until the owning MeshData is modified.
+	struct IndexSpan
+	{
+		const void* Data = nullptr;
+		size_t Count = 0;
+		uint32 Stride = 0;
+
+		size_t ByteSize()const { return Count*Stride; }
+	};
+
 	struct MeshData
 	{
 		std::vector<Vertex> Vertices;
         std::vector<uint32> Indices32;
 
-        std::vector<uint16>& GetIndices16()
+        // True when every vertex can be addressed with a 16-bit index.
+        bool Fits16BitIndices()const { return Vertices.size() <= 0x10000; }
+
+        // Number of indices, whether they are currently held as 32 or 16 bits.
+        size_t IndexCount()const { return Indices32.empty() ? mIndices16.size() : Indices32.size(); }
+
+        // 16-bit copy of Indices32, built on first use.  Throws std::overflow_error
+        // rather than truncating if any index does not fit.
+        std::vector<uint16>& GetIndices16();
+
+        // Settles on the narrowest index format.  If the mesh fits in 16 bits the
+        // indices are narrowed and Indices32 is released; the returned view points
+        // at whichever array is kept.  The Create* functions and Subdivide only
+        // work on Indices32, so call this once the mesh is final.
+        IndexSpan GetIndices();
+
+        // Empties the mesh but keeps its allocations, and makes sure there is room
+        // for vertexCount vertices and indexCount indices.
+        void Reset(size_t vertexCount, size_t indexCount)
         {
-			if(mIndices16.empty())
-			{
-				mIndices16.resize(Indices32.size());
-				for(size_t i = 0; i < Indices32.size(); ++i)
-					mIndices16[i] = static_cast<uint16>(Indices32[i]);
-			}
-
-			return mIndices16;
+            Vertices.clear();
+            Indices32.clear();
+            mIndices16.clear();
+
+            Vertices.reserve(vertexCount);
+            Indices32.reserve(indexCount);
         }
 
 	private:
 		std::vector<uint16> mIndices16;
 	};
 
+	// One tile of a grid streamed by CreateGridTiles.  Neighbouring tiles share the
+	// row or column of vertices along their common edge, and indices are local to
+	// the tile.
+	struct GridTile
+	{
+		uint32 TileRow = 0;
+		uint32 TileColumn = 0;
+
+		// Grid row/column of the tile's first vertex, and its size in vertices.
+		uint32 FirstRow = 0;
+		uint32 FirstColumn = 0;
+		uint32 RowCount = 0;
+		uint32 ColumnCount = 0;
+
+		std::vector<Vertex> Vertices;
+		std::vector<uint16> Indices;
+	};
+
+	// Every Create* function below has an overload that writes into a caller-owned
+	// MeshData instead of returning a new one.  The output size is computed up front,
+	// so reusing the same MeshData across calls does not allocate once it is big enough.
+
 	///<summary>
 	/// Creates a box centered at the origin with the given dimensions, where each
     /// face has m rows and n columns of vertices.
 	///</summary>
     MeshData CreateBox(float width, float height, float depth, uint32 numSubdivisions);
+    void CreateBox(float width, float height, float depth, uint32 numSubdivisions, MeshData& meshData);
 
 	///<summary>
 	/// Creates a sphere centered at the origin with the given radius.  The
 	/// slices and stacks parameters control the degree of tessellation.
 	///</summary>
     MeshData CreateSphere(float radius, uint32 sliceCount, uint32 stackCount);
+    void CreateSphere(float radius, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
 
 	///<summary>
 	/// Creates a geosphere centered at the origin with the given radius.  The
 	/// depth controls the level of tessellation.
 	///</summary>
     MeshData CreateGeosphere(float radius, uint32 numSubdivisions);
+    void CreateGeosphere(float radius, uint32 numSubdivisions, MeshData& meshData);
 
 	///<summary>
 	/// Creates a cylinder parallel to the y-axis, and centered about the origin.  
@@ -98,12 +153,33 @@ public:
 	// cylinders.  The slices and stacks parameters control the degree of tessellation.
 	///</summary>
     MeshData CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount);
+    void CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
 
 	///<summary>
 	/// Creates an mxn grid in the xz-plane with m rows and n columns, centered
 	/// at the origin with the specified width and depth.
 	///</summary>
     MeshData CreateGrid(float width, float depth, uint32 m, uint32 n);
+    void CreateGrid(float width, float depth, uint32 m, uint32 n, MeshData& meshData);
+
+	///<summary>
+	/// Streams the grid CreateGrid(width, depth, m, n) would build as tiles of at
+	/// most tileSize x tileSize vertices, so the whole grid never has to be in memory.
+	/// The vertices are identical to CreateGrid's.  tileSize must be at most 256
+	/// for the local indices to fit 16 bits; 65 gives 64x64 quads per tile.
+	/// Tiles are handed to callback one at a time and dropped afterwards.  With a
+	/// pool they are generated on its threads and callback is called concurrently,
+	/// with at most one tile per thread alive.
+	///</summary>
+	static void CreateGridTiles(float width, float depth, uint32 m, uint32 n, uint32 tileSize,
+		const std::function<void(const GridTile& tile)>& callback, ThreadPool* pool = nullptr);
+
+	// Fills a single tile of the grid above.  Safe to call from several threads.
+	static void CreateGridTile(float width, float depth, uint32 m, uint32 n, uint32 tileSize,
+		uint32 tileRow, uint32 tileColumn, GridTile& tile);
+
+	// Tiles along an edge of vertexCount vertices.
+	static uint32 GridTileCount(uint32 vertexCount, uint32 tileSize);
 
 	// TRIANGULAR PRISM
 	MeshData CreateTriangularPrism(float bottomRad, float height, uint32 stackCount);
@@ -127,8 +203,19 @@ public:
 	/// Creates a quad aligned with the screen.  This is useful for postprocessing and screen effects.
 	///</summary>
     MeshData CreateQuad(float x, float y, float w, float h, float depth);
+    void CreateQuad(float x, float y, float w, float h, float depth, MeshData& meshData);
+
+	///<summary>
+	/// Splits every triangle into four.  Input vertices keep their indices and each
+	/// edge gets a single midpoint vertex shared by the triangles on both sides.
+	///</summary>
 	void Subdivide(MeshData& meshData);
 private:
+
+	// Edge -> midpoint table used by Subdivide.  Kept between calls so that
+	// regenerating meshes with the same generator does not reallocate it.
+	std::vector<std::uint64_t> mEdgeKeys;
+	std::vector<uint32> mEdgeMidpoints;
 	
     Vertex MidPoint(const Vertex& v0, const Vertex& v1);
     void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
@@ -0,0 +1,227 @@
+//***************************************************************************************
+// Heightfield.cpp
+//***************************************************************************************
+
+#include "Heightfield.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define HEIGHTFIELD_SIMD_AVX2 1
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+	// Points per pass through the stack buffers of the batch queries.
+	const size_t BlockSize = 256;
+
+	// Points per ParallelFor chunk in PlaceOnSurface.
+	const int ChunkSize = 4096;
+}
+
+Heightfield::Heightfield(const XMFLOAT2& origin, const XMFLOAT2& size, uint32 rows, uint32 columns,
+	const std::function<float(float x, float z)>& height, ThreadPool& pool)
+	: Heightfield(origin, size, rows, columns, std::vector<float>((size_t)rows*columns))
+{
+	const float dx = size.x / (columns - 1);
+	const float dz = size.y / (rows - 1);
+
+	pool.ParallelFor(0, (int)rows, std::max(1, ChunkSize / (int)columns), [&](int begin, int end)
+	{
+		for(int r = begin; r < end; ++r)
+		{
+			float* row = &mHeights[(size_t)r*columns];
+			for(uint32 c = 0; c < columns; ++c)
+				row[c] = height(origin.x + c*dx, origin.y + r*dz);
+		}
+	});
+}
+
+Heightfield::Heightfield(const XMFLOAT2& origin, const XMFLOAT2& size, uint32 rows, uint32 columns,
+	std::vector<float> heights)
+	: mOrigin(origin), mSize(size), mRows(rows), mColumns(columns), mHeights(std::move(heights))
+{
+	assert(rows >= 2 && columns >= 2);
+	assert(size.x > 0.0f && size.y > 0.0f);
+	assert(mHeights.size() == (size_t)rows*columns);
+
+	mInvSpacing.x = (columns - 1) / size.x;
+	mInvSpacing.y = (rows - 1) / size.y;
+}
+
+float Heightfield::Height(float x, float z)const
+{
+	float u = std::min(std::max((x - mOrigin.x)*mInvSpacing.x, 0.0f), (float)(mColumns - 1));
+	float v = std::min(std::max((z - mOrigin.y)*mInvSpacing.y, 0.0f), (float)(mRows - 1));
+
+	uint32 c = std::min((uint32)u, mColumns - 2);
+	uint32 r = std::min((uint32)v, mRows - 2);
+	float fu = u - c;
+	float fv = v - r;
+
+	const float* p = &mHeights[(size_t)r*mColumns + c];
+	float h0 = p[0] + (p[1] - p[0])*fu;
+	float h1 = p[mColumns] + (p[mColumns + 1] - p[mColumns])*fu;
+
+	return h0 + (h1 - h0)*fv;
+}
+
+XMFLOAT3 Heightfield::Normal(float x, float z)const
+{
+	XMFLOAT2 spacing = GetSpacing();
+
+	// n = (-dh/dx, 1, -dh/dz)
+	XMFLOAT3 n(
+		(Height(x - spacing.x, z) - Height(x + spacing.x, z)) / (2.0f*spacing.x),
+		1.0f,
+		(Height(x, z - spacing.y) - Height(x, z + spacing.y)) / (2.0f*spacing.y));
+
+	XMVECTOR unitNormal = XMVector3Normalize(XMLoadFloat3(&n));
+	XMStoreFloat3(&n, unitNormal);
+
+	return n;
+}
+
+void Heightfield::Heights(const float* x, const float* z, float* heights, size_t count)const
+{
+	SampleHeights(x, z, 0.0f, 0.0f, heights, count);
+}
+
+void Heightfield::Normals(const float* x, const float* z, float* normalX, float* normalY, float* normalZ, size_t count)const
+{
+	XMFLOAT2 spacing = GetSpacing();
+	const float scaleX = 1.0f / (2.0f*spacing.x);
+	const float scaleZ = 1.0f / (2.0f*spacing.y);
+
+	float left[BlockSize], right[BlockSize], down[BlockSize], up[BlockSize];
+	for(size_t first = 0; first < count; first += BlockSize)
+	{
+		const size_t n = std::min(BlockSize, count - first);
+
+		SampleHeights(x + first, z + first, -spacing.x, 0.0f, left, n);
+		SampleHeights(x + first, z + first, +spacing.x, 0.0f, right, n);
+		SampleHeights(x + first, z + first, 0.0f, -spacing.y, down, n);
+		SampleHeights(x + first, z + first, 0.0f, +spacing.y, up, n);
+
+		for(size_t i = 0; i < n; ++i)
+		{
+			float nx = (left[i] - right[i])*scaleX;
+			float nz = (down[i] - up[i])*scaleZ;
+			float invLength = 1.0f / sqrtf(nx*nx + 1.0f + nz*nz);
+
+			normalX[first + i] = nx*invLength;
+			normalY[first + i] = invLength;
+			normalZ[first + i] = nz*invLength;
+		}
+	}
+}
+
+void Heightfield::PlaceOnSurface(XMFLOAT3* positions, size_t stride, size_t count, float offset, ThreadPool& pool)const
+{
+	auto place = [&](int begin, int end)
+	{
+		float x[BlockSize], z[BlockSize], y[BlockSize];
+		for(size_t first = (size_t)begin; first < (size_t)end; first += BlockSize)
+		{
+			const size_t n = std::min(BlockSize, (size_t)end - first);
+
+			for(size_t i = 0; i < n; ++i)
+			{
+				const XMFLOAT3* p = (const XMFLOAT3*)((const char*)positions + (first + i)*stride);
+				x[i] = p->x;
+				z[i] = p->z;
+			}
+
+			SampleHeights(x, z, 0.0f, 0.0f, y, n);
+
+			for(size_t i = 0; i < n; ++i)
+			{
+				XMFLOAT3* p = (XMFLOAT3*)((char*)positions + (first + i)*stride);
+				p->y = y[i] + offset;
+			}
+		}
+	};
+
+	if(count > ParallelThreshold)
+		pool.ParallelFor(0, (int)count, ChunkSize, place);
+	else
+		place(0, (int)count);
+}
+
+void Heightfield::SampleHeights(const float* x, const float* z, float offsetX, float offsetZ, float* heights, size_t count)const
+{
+	size_t i = 0;
+
+#if defined(HEIGHTFIELD_SIMD_AVX2)
+	const __m256 shiftX = _mm256_set1_ps(offsetX - mOrigin.x);
+	const __m256 shiftZ = _mm256_set1_ps(offsetZ - mOrigin.y);
+	const __m256 scaleX = _mm256_set1_ps(mInvSpacing.x);
+	const __m256 scaleZ = _mm256_set1_ps(mInvSpacing.y);
+	const __m256 maxU = _mm256_set1_ps((float)(mColumns - 1));
+	const __m256 maxV = _mm256_set1_ps((float)(mRows - 1));
+	const __m256i lastColumn = _mm256_set1_epi32((int)mColumns - 2);
+	const __m256i lastRow = _mm256_set1_epi32((int)mRows - 2);
+	const __m256i columns = _mm256_set1_epi32((int)mColumns);
+	const float* data = mHeights.data();
+
+	for(; i + 8 <= count; i += 8)
+	{
+		__m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(x + i), shiftX), scaleX);
+		__m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(z + i), shiftZ), scaleZ);
+		u = _mm256_min_ps(_mm256_max_ps(u, _mm256_setzero_ps()), maxU);
+		v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), maxV);
+
+		__m256i c = _mm256_min_epi32(_mm256_cvttps_epi32(u), lastColumn);
+		__m256i r = _mm256_min_epi32(_mm256_cvttps_epi32(v), lastRow);
+		__m256 fu = _mm256_sub_ps(u, _mm256_cvtepi32_ps(c));
+		__m256 fv = _mm256_sub_ps(v, _mm256_cvtepi32_ps(r));
+
+		__m256i index = _mm256_add_epi32(_mm256_mullo_epi32(r, columns), c);
+		__m256 h00 = _mm256_i32gather_ps(data, index, 4);
+		__m256 h10 = _mm256_i32gather_ps(data + 1, index, 4);
+		__m256 h01 = _mm256_i32gather_ps(data + mColumns, index, 4);
+		__m256 h11 = _mm256_i32gather_ps(data + mColumns + 1, index, 4);
+
+		__m256 h0 = _mm256_add_ps(h00, _mm256_mul_ps(_mm256_sub_ps(h10, h00), fu));
+		__m256 h1 = _mm256_add_ps(h01, _mm256_mul_ps(_mm256_sub_ps(h11, h01), fu));
+		_mm256_storeu_ps(heights + i, _mm256_add_ps(h0, _mm256_mul_ps(_mm256_sub_ps(h1, h0), fv)));
+	}
+#endif
+
+	for(; i < count; ++i)
+		heights[i] = Height(x[i] + offsetX, z[i] + offsetZ);
+}
+
+const float* Heightfield::GetData()const
+{
+	return mHeights.data();
+}
+
+Heightfield::uint32 Heightfield::GetRowCount()const
+{
+	return mRows;
+}
+
+Heightfield::uint32 Heightfield::GetColumnCount()const
+{
+	return mColumns;
+}
+
+XMFLOAT2 Heightfield::GetOrigin()const
+{
+	return mOrigin;
+}
+
+XMFLOAT2 Heightfield::GetSize()const
+{
+	return mSize;
+}
+
+XMFLOAT2 Heightfield::GetSpacing()const
+{
+	return XMFLOAT2(mSize.x / (mColumns - 1), mSize.y / (mRows - 1));
+}
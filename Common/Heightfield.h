@@ -0,0 +1,72 @@
+//***************************************************************************************
+// Heightfield.h
+//
+// A terrain's heights baked into a regular float grid.  Heights are bilinear between
+// samples and normals come from central differences one sample apart, as in
+// Terrain.hlsl, so objects placed with it sit on the surface that is drawn.  Every
+// query is constant time; the batch versions use AVX2 gathers when available.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <DirectXMath.h>
+#include "ThreadPool.h"
+
+class Heightfield
+{
+public:
+	using uint32 = std::uint32_t;
+
+	// PlaceOnSurface splits inputs with more points than this across the pool.
+	static const size_t ParallelThreshold = 16384;
+
+	Heightfield() = default;
+
+	// Bakes rows x columns samples of height(x, z) over [origin, origin + size], with
+	// row 0 at the minimum z and column 0 at the minimum x.
+	Heightfield(const DirectX::XMFLOAT2& origin, const DirectX::XMFLOAT2& size, uint32 rows, uint32 columns,
+		const std::function<float(float x, float z)>& height, ThreadPool& pool = ThreadPool::Shared());
+
+	// Takes samples that are already baked, laid out as above.
+	Heightfield(const DirectX::XMFLOAT2& origin, const DirectX::XMFLOAT2& size, uint32 rows, uint32 columns,
+		std::vector<float> heights);
+
+	// Points outside the grid get the height of the nearest edge.
+	float Height(float x, float z)const;
+	DirectX::XMFLOAT3 Normal(float x, float z)const;
+
+	// Structure-of-arrays versions of the above.
+	void Heights(const float* x, const float* z, float* heights, size_t count)const;
+	void Normals(const float* x, const float* z, float* normalX, float* normalY, float* normalZ, size_t count)const;
+
+	// Sets the y of count strided positions to the height under them plus offset,
+	// e.g. &sprites[0].Pos with sizeof(sprite) to stand sprites on the ground.
+	void PlaceOnSurface(DirectX::XMFLOAT3* positions, size_t stride, size_t count, float offset = 0.0f,
+		ThreadPool& pool = ThreadPool::Shared())const;
+
+	const float* GetData()const;
+	uint32 GetRowCount()const;
+	uint32 GetColumnCount()const;
+	DirectX::XMFLOAT2 GetOrigin()const;
+	DirectX::XMFLOAT2 GetSize()const;
+
+	// Distance between neighbouring samples in x and z.
+	DirectX::XMFLOAT2 GetSpacing()const;
+
+private:
+	// Heights at (x[i] + offsetX, z[i] + offsetZ).
+	void SampleHeights(const float* x, const float* z, float offsetX, float offsetZ, float* heights, size_t count)const;
+
+	DirectX::XMFLOAT2 mOrigin = { 0.0f, 0.0f };
+	DirectX::XMFLOAT2 mSize = { 0.0f, 0.0f };
+	uint32 mRows = 0;
+	uint32 mColumns = 0;
+
+	// Samples per world unit.
+	DirectX::XMFLOAT2 mInvSpacing = { 0.0f, 0.0f };
+
+	std::vector<float> mHeights;
+};
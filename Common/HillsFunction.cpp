@@ -0,0 +1,303 @@
+//***************************************************************************************
+// HillsFunction.cpp
+//***************************************************************************************
+
+#include "HillsFunction.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define HILLS_SIMD_AVX2 1
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+	const size_t BatchSize = HillsFunction::BatchSize;
+
+	// Amplitude and frequency of the hills.
+	const float Scale = 0.3f;
+	const float Frequency = 0.1f;
+
+	// Grid rows per ParallelFor chunk are picked so a chunk is about this many vertices.
+	const int GridChunkVertices = 16384;
+
+	// The terms of one batch.  sz/cz (and z) are either BatchSize values or a single
+	// value shared by the whole batch, as on a grid row.
+	struct Terms
+	{
+		const float* X;
+		const float* Z;
+		const float* SinX;
+		const float* CosX;
+		const float* SinZ;
+		const float* CosZ;
+		bool SharedZ;
+	};
+
+	// Any output may be null.
+	struct Outputs
+	{
+		float* Height;
+		float* NormalX;
+		float* NormalY;
+		float* NormalZ;
+	};
+
+#if defined(HILLS_SIMD_AVX2)
+	inline __m256 Madd(__m256 a, __m256 b, __m256 c)
+	{
+		return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+	}
+
+	// sin/cos of Frequency*angle for one batch.  This is XMVectorSinCos on eight
+	// lanes: reduce to [-pi, pi], reflect into [-pi/2, pi/2] and use the same
+	// minimax polynomials.
+	void SinCos(const float* angles, float* sines, float* cosines)
+	{
+		const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+		__m256 v = _mm256_mul_ps(_mm256_loadu_ps(angles), _mm256_set1_ps(Frequency));
+		__m256 q = _mm256_round_ps(_mm256_mul_ps(v, _mm256_set1_ps(XM_1DIV2PI)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		// 2pi in two parts, the first exact in a few bits, so q*2pi is not rounded
+		// away for the large angles far out on a big grid.
+		__m256 x = _mm256_sub_ps(v, _mm256_mul_ps(q, _mm256_set1_ps(6.28125f)));
+		x = _mm256_sub_ps(x, _mm256_mul_ps(q, _mm256_set1_ps(1.9353071795864769e-3f)));
+
+		// sin(x) = sin(pi - x) and cos(x) = -cos(pi - x).
+		__m256 sign = _mm256_and_ps(x, signMask);
+		__m256 reflected = _mm256_sub_ps(_mm256_or_ps(sign, _mm256_set1_ps(XM_PI)), x);
+		__m256 inner = _mm256_cmp_ps(_mm256_andnot_ps(signMask, x), _mm256_set1_ps(XM_PIDIV2), _CMP_LE_OQ);
+		x = _mm256_blendv_ps(reflected, x, inner);
+		__m256 cosSign = _mm256_blendv_ps(_mm256_set1_ps(-1.0f), _mm256_set1_ps(1.0f), inner);
+
+		__m256 x2 = _mm256_mul_ps(x, x);
+
+		__m256 s = Madd(_mm256_set1_ps(-2.3889859e-08f), x2, _mm256_set1_ps(+2.7525562e-06f));
+		s = Madd(s, x2, _mm256_set1_ps(-0.00019840874f));
+		s = Madd(s, x2, _mm256_set1_ps(+0.0083333310f));
+		s = Madd(s, x2, _mm256_set1_ps(-0.16666667f));
+		s = Madd(s, x2, _mm256_set1_ps(1.0f));
+		_mm256_storeu_ps(sines, _mm256_mul_ps(s, x));
+
+		__m256 c = Madd(_mm256_set1_ps(-2.6051615e-07f), x2, _mm256_set1_ps(+2.4760495e-05f));
+		c = Madd(c, x2, _mm256_set1_ps(-0.0013888378f));
+		c = Madd(c, x2, _mm256_set1_ps(+0.041666638f));
+		c = Madd(c, x2, _mm256_set1_ps(-0.5f));
+		c = Madd(c, x2, _mm256_set1_ps(1.0f));
+		_mm256_storeu_ps(cosines, _mm256_mul_ps(c, cosSign));
+	}
+
+	void Combine(const Terms& t, const Outputs& out)
+	{
+		__m256 x = _mm256_loadu_ps(t.X);
+		__m256 sx = _mm256_loadu_ps(t.SinX);
+		__m256 cx = _mm256_loadu_ps(t.CosX);
+		__m256 z = t.SharedZ ? _mm256_set1_ps(*t.Z) : _mm256_loadu_ps(t.Z);
+		__m256 sz = t.SharedZ ? _mm256_set1_ps(*t.SinZ) : _mm256_loadu_ps(t.SinZ);
+		__m256 cz = t.SharedZ ? _mm256_set1_ps(*t.CosZ) : _mm256_loadu_ps(t.CosZ);
+
+		if(out.Height)
+		{
+			__m256 h = Madd(z, sx, _mm256_mul_ps(x, cz));
+			_mm256_storeu_ps(out.Height, _mm256_mul_ps(h, _mm256_set1_ps(Scale)));
+		}
+
+		if(out.NormalX)
+		{
+			// n = (-df/dx, 1, -df/dz)
+			const __m256 a = _mm256_set1_ps(Scale*Frequency);
+			const __m256 b = _mm256_set1_ps(Scale);
+			__m256 nx = _mm256_sub_ps(_mm256_setzero_ps(), Madd(_mm256_mul_ps(a, z), cx, _mm256_mul_ps(b, cz)));
+			__m256 nz = _mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(a, x), sz), _mm256_mul_ps(b, sx));
+
+			const __m256 one = _mm256_set1_ps(1.0f);
+			__m256 length = _mm256_sqrt_ps(Madd(nx, nx, Madd(nz, nz, one)));
+			__m256 invLength = _mm256_div_ps(one, length);
+
+			_mm256_storeu_ps(out.NormalX, _mm256_mul_ps(nx, invLength));
+			_mm256_storeu_ps(out.NormalY, invLength);
+			_mm256_storeu_ps(out.NormalZ, _mm256_mul_ps(nz, invLength));
+		}
+	}
+#else
+	// sin/cos of Frequency*angle for one batch.
+	void SinCos(const float* angles, float* sines, float* cosines)
+	{
+		for(size_t i = 0; i < BatchSize; i += 4)
+		{
+			XMVECTOR s, c;
+			XMVectorSinCos(&s, &c, XMVectorScale(XMLoadFloat4((const XMFLOAT4*)(angles + i)), Frequency));
+			XMStoreFloat4((XMFLOAT4*)(sines + i), s);
+			XMStoreFloat4((XMFLOAT4*)(cosines + i), c);
+		}
+	}
+
+	void Combine(const Terms& t, const Outputs& out)
+	{
+		for(size_t i = 0; i < BatchSize; i += 4)
+		{
+			XMVECTOR x = XMLoadFloat4((const XMFLOAT4*)(t.X + i));
+			XMVECTOR sx = XMLoadFloat4((const XMFLOAT4*)(t.SinX + i));
+			XMVECTOR cx = XMLoadFloat4((const XMFLOAT4*)(t.CosX + i));
+			XMVECTOR z = t.SharedZ ? XMVectorReplicate(*t.Z) : XMLoadFloat4((const XMFLOAT4*)(t.Z + i));
+			XMVECTOR sz = t.SharedZ ? XMVectorReplicate(*t.SinZ) : XMLoadFloat4((const XMFLOAT4*)(t.SinZ + i));
+			XMVECTOR cz = t.SharedZ ? XMVectorReplicate(*t.CosZ) : XMLoadFloat4((const XMFLOAT4*)(t.CosZ + i));
+
+			if(out.Height)
+			{
+				XMVECTOR h = XMVectorMultiplyAdd(z, sx, XMVectorMultiply(x, cz));
+				XMStoreFloat4((XMFLOAT4*)(out.Height + i), XMVectorScale(h, Scale));
+			}
+
+			if(out.NormalX)
+			{
+				// n = (-df/dx, 1, -df/dz)
+				XMVECTOR nx = XMVectorNegate(XMVectorMultiplyAdd(XMVectorScale(z, Scale*Frequency), cx, XMVectorScale(cz, Scale)));
+				XMVECTOR nz = XMVectorSubtract(XMVectorMultiply(XMVectorScale(x, Scale*Frequency), sz), XMVectorScale(sx, Scale));
+
+				XMVECTOR lengthSq = XMVectorMultiplyAdd(nx, nx, XMVectorMultiplyAdd(nz, nz, XMVectorSplatOne()));
+				XMVECTOR invLength = XMVectorReciprocalSqrt(lengthSq);
+
+				XMStoreFloat4((XMFLOAT4*)(out.NormalX + i), XMVectorMultiply(nx, invLength));
+				XMStoreFloat4((XMFLOAT4*)(out.NormalY + i), invLength);
+				XMStoreFloat4((XMFLOAT4*)(out.NormalZ + i), XMVectorMultiply(nz, invLength));
+			}
+		}
+	}
+#endif
+
+	// Runs whole batches in place and the tail through padded copies.
+	void EvaluatePoints(const float* x, const float* z, const Outputs& out, size_t count)
+	{
+		float sx[BatchSize], cx[BatchSize], sz[BatchSize], cz[BatchSize];
+
+		for(size_t first = 0; first < count; first += BatchSize)
+		{
+			const size_t n = std::min(BatchSize, count - first);
+
+			float xs[BatchSize] = {}, zs[BatchSize] = {};
+			float h[BatchSize], nx[BatchSize], ny[BatchSize], nz[BatchSize];
+			std::copy(x + first, x + first + n, xs);
+			std::copy(z + first, z + first + n, zs);
+
+			SinCos(xs, sx, cx);
+			SinCos(zs, sz, cz);
+
+			Terms terms = { xs, zs, sx, cx, sz, cz, false };
+			Outputs batch = { out.Height ? h : nullptr, nx, ny, nz };
+			if(!out.NormalX)
+				batch.NormalX = batch.NormalY = batch.NormalZ = nullptr;
+			Combine(terms, batch);
+
+			if(out.Height)
+				std::copy(h, h + n, out.Height + first);
+			if(out.NormalX)
+			{
+				std::copy(nx, nx + n, out.NormalX + first);
+				std::copy(ny, ny + n, out.NormalY + first);
+				std::copy(nz, nz + n, out.NormalZ + first);
+			}
+		}
+	}
+}
+
+float HillsFunction::Height(float x, float z)
+{
+	return Scale*(z*sinf(Frequency*x) + x*cosf(Frequency*z));
+}
+
+XMFLOAT3 HillsFunction::Normal(float x, float z)
+{
+	// n = (-df/dx, 1, -df/dz)
+	XMFLOAT3 n(
+		-Scale*Frequency*z*cosf(Frequency*x) - Scale*cosf(Frequency*z),
+		1.0f,
+		-Scale*sinf(Frequency*x) + Scale*Frequency*x*sinf(Frequency*z));
+
+	XMVECTOR unitNormal = XMVector3Normalize(XMLoadFloat3(&n));
+	XMStoreFloat3(&n, unitNormal);
+
+	return n;
+}
+
+void HillsFunction::Heights(const float* x, const float* z, float* heights, size_t count)
+{
+	Outputs out = { heights, nullptr, nullptr, nullptr };
+	EvaluatePoints(x, z, out, count);
+}
+
+void HillsFunction::Normals(const float* x, const float* z, float* normalX, float* normalY, float* normalZ, size_t count)
+{
+	Outputs out = { nullptr, normalX, normalY, normalZ };
+	EvaluatePoints(x, z, out, count);
+}
+
+void HillsFunction::EvaluateGrid(float width, float depth, uint32 m, uint32 n,
+	XMFLOAT3* positions, XMFLOAT3* normals, size_t stride, ThreadPool& pool)
+{
+	if(m == 0 || n == 0 || (!positions && !normals))
+		return;
+
+	const float halfWidth = 0.5f*width;
+	const float halfDepth = 0.5f*depth;
+	const float dx = n > 1 ? width / (n - 1) : 0.0f;
+	const float dz = m > 1 ? depth / (m - 1) : 0.0f;
+
+	// x and its sin/cos for every column, padded to whole batches.
+	const size_t columns = (n + BatchSize - 1) / BatchSize*BatchSize;
+	std::vector<float> x(columns), sinX(columns), cosX(columns);
+	for(size_t j = 0; j < columns; ++j)
+		x[j] = -halfWidth + std::min<size_t>(j, n - 1)*dx;
+	for(size_t j = 0; j < columns; j += BatchSize)
+		SinCos(&x[j], &sinX[j], &cosX[j]);
+
+	// Same for the rows, whose values are shared along the row.
+	const size_t rows = (m + BatchSize - 1) / BatchSize*BatchSize;
+	std::vector<float> z(rows), sinZ(rows), cosZ(rows);
+	for(size_t i = 0; i < rows; ++i)
+		z[i] = halfDepth - std::min<size_t>(i, m - 1)*dz;
+	for(size_t i = 0; i < rows; i += BatchSize)
+		SinCos(&z[i], &sinZ[i], &cosZ[i]);
+
+	int grain = std::max(1, GridChunkVertices / (int)n);
+	pool.ParallelFor(0, (int)m, grain, [&](int begin, int end)
+	{
+		std::vector<float> h(columns), nx(columns), ny(columns), nz(columns);
+
+		for(int i = begin; i < end; ++i)
+		{
+			for(size_t j = 0; j < columns; j += BatchSize)
+			{
+				Terms terms = { &x[j], &z[i], &sinX[j], &cosX[j], &sinZ[i], &cosZ[i], true };
+				Outputs out = { &h[j], nullptr, nullptr, nullptr };
+				if(normals)
+				{
+					out.NormalX = &nx[j];
+					out.NormalY = &ny[j];
+					out.NormalZ = &nz[j];
+				}
+				Combine(terms, out);
+			}
+
+			const size_t rowOffset = (size_t)i*n*stride;
+			for(uint32 j = 0; j < n; ++j)
+			{
+				size_t offset = rowOffset + j*stride;
+				if(positions)
+				{
+					XMFLOAT3* p = (XMFLOAT3*)((char*)positions + offset);
+					*p = XMFLOAT3(x[j], h[j], z[i]);
+				}
+				if(normals)
+				{
+					XMFLOAT3* normal = (XMFLOAT3*)((char*)normals + offset);
+					*normal = XMFLOAT3(nx[j], ny[j], nz[j]);
+				}
+			}
+		}
+	});
+}
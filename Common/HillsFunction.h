@@ -0,0 +1,41 @@
+//***************************************************************************************
+// HillsFunction.h
+//
+// The demos' analytic hills, y = 0.3*(z*sin(0.1x) + x*cos(0.1z)), and its normal.
+// Besides the one point versions it evaluates structure-of-arrays batches with SIMD
+// sin/cos, and whole grids on a ThreadPool; on a grid the sin/cos terms are
+// separable, so they are computed once per row and column instead of per vertex.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <DirectXMath.h>
+#include "ThreadPool.h"
+
+class HillsFunction
+{
+public:
+	using uint32 = std::uint32_t;
+
+	// Points evaluated together by the batch functions; counts need not be a
+	// multiple of it.
+	static const size_t BatchSize = 8;
+
+	static float Height(float x, float z);
+	static DirectX::XMFLOAT3 Normal(float x, float z);
+
+	// heights[i] = Height(x[i], z[i]), and likewise for the unit normals.  The
+	// vector sin/cos are not bit for bit sinf/cosf; results agree to about 1e-5
+	// relative.
+	static void Heights(const float* x, const float* z, float* heights, size_t count);
+	static void Normals(const float* x, const float* z, float* normalX, float* normalY, float* normalZ, size_t count);
+
+	// Evaluates an m x n grid with the layout of GeometryGenerator::CreateGrid, so
+	// positions and normals can point straight into its vertices (e.g.
+	// &grid.Vertices[0].Position with sizeof(GeometryGenerator::Vertex)).  Positions
+	// get all three coordinates; either output may be null.
+	static void EvaluateGrid(float width, float depth, uint32 m, uint32 n,
+		DirectX::XMFLOAT3* positions, DirectX::XMFLOAT3* normals, size_t stride,
+		ThreadPool& pool = ThreadPool::Shared());
+};
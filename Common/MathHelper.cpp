@@ -4,6 +4,7 @@
 
 #include "MathHelper.h"
 #include <float.h>
+#include <atomic>
 #include <cmath>
 
 using namespace DirectX;
@@ -11,6 +12,33 @@ using namespace DirectX;
 const float MathHelper::Infinity = FLT_MAX;
 const float MathHelper::Pi       = 3.1415926535f;
 
+namespace
+{
+	const std::uint64_t DefaultSeed = 0x853c49e6748fea9bULL;
+	const std::uint64_t DefaultStream = 0xda3e39cb94b95bdbULL;
+
+	// Threads are numbered in the order they first ask for random numbers.  The
+	// first one keeps the default stream, so single threaded runs are unchanged.
+	std::atomic<std::uint64_t> gNextThreadIndex{ 0 };
+
+	std::uint64_t ThreadStream()
+	{
+		static thread_local std::uint64_t stream = DefaultStream + gNextThreadIndex.fetch_add(1);
+		return stream;
+	}
+}
+
+Pcg32& MathHelper::RandomEngine()
+{
+	static thread_local Pcg32 engine(DefaultSeed, ThreadStream());
+	return engine;
+}
+
+void MathHelper::SeedRandom(std::uint64_t seed)
+{
+	RandomEngine().Seed(seed, ThreadStream());
+}
+
 float MathHelper::AngleFromXY(float x, float y)
 {
 	float theta = 0.0f;
@@ -6,17 +6,76 @@
 
 #pragma once
 
-#include <Windows.h>
 #include <DirectXMath.h>
+#include <cmath>
 #include <cstdint>
 
+// PCG32 pseudo-random generator (O'Neill, pcg-random.org).  Small, fast and
+// seedable, so each system can own one and replay the same sequence.
+class Pcg32
+{
+public:
+	explicit Pcg32(std::uint64_t seed = 0x853c49e6748fea9bULL, std::uint64_t stream = 0xda3e39cb94b95bdbULL)
+	{
+		Seed(seed, stream);
+	}
+
+	void Seed(std::uint64_t seed, std::uint64_t stream = 0xda3e39cb94b95bdbULL)
+	{
+		mState = 0;
+		mInc = (stream << 1) | 1;
+		NextUInt();
+		mState += seed;
+		NextUInt();
+	}
+
+	// Returns a uniformly distributed 32-bit value.
+	std::uint32_t NextUInt()
+	{
+		std::uint64_t old = mState;
+		mState = old*6364136223846793005ULL + mInc;
+		std::uint32_t xorShifted = (std::uint32_t)(((old >> 18) ^ old) >> 27);
+		std::uint32_t rot = (std::uint32_t)(old >> 59);
+		return (xorShifted >> rot) | (xorShifted << ((32 - rot) & 31));
+	}
+
+	// Returns random float in [0, 1).
+	float NextFloat()
+	{
+		return (float)(NextUInt() >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// Returns random float in [a, b).
+	float NextFloat(float a, float b)
+	{
+		return a + NextFloat()*(b-a);
+	}
+
+	// Returns random int in [a, b].
+	int NextInt(int a, int b)
+	{
+		std::uint64_t range = (std::uint64_t)((std::int64_t)b - a) + 1;
+		return (int)(a + (std::int64_t)(((std::uint64_t)NextUInt()*range) >> 32));
+	}
+
+private:
+	std::uint64_t mState = 0;
+	std::uint64_t mInc = 0;
+};
+
 class MathHelper
 {
 public:
+	// Per-thread generator behind RandF/Rand.  Each thread draws from its own PCG
+	// stream, so worker threads don't repeat each other's numbers.  Seed it to make a
+	// run reproducible; the thread keeps its stream.
+	static Pcg32& RandomEngine();
+	static void SeedRandom(std::uint64_t seed);
+
 	// Returns random float in [0, 1).
 	static float RandF()
 	{
-		return (float)(rand()) / (float)RAND_MAX;
+		return RandomEngine().NextFloat();
 	}
 
 	// Returns random float in [a, b).
@@ -27,7 +86,7 @@ public:
 
     static int Rand(int a, int b)
     {
-        return a + rand() % ((b - a) + 1);
+        return RandomEngine().NextInt(a, b);
     }
 
 	template<typename T>
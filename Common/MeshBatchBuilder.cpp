@@ -0,0 +1,137 @@
+//***************************************************************************************
+// MeshBatchBuilder.cpp
+//***************************************************************************************
+
+#include "MeshBatchBuilder.h"
+#include "BoundsBuilder.h"
+#include <cassert>
+
+using namespace DirectX;
+
+void MeshBatchBuilder::Add(const std::string& name, Generator generator)
+{
+	Entry entry;
+	entry.Name = name;
+	entry.Generate = std::move(generator);
+	mEntries.push_back(std::move(entry));
+}
+
+void MeshBatchBuilder::Build(ThreadPool& pool)
+{
+	pool.ParallelFor(0, (int)mEntries.size(), 1, [this, &pool](int first, int last)
+	{
+		for(int i = first; i < last; ++i)
+		{
+			Entry& entry = mEntries[i];
+			try
+			{
+				GeometryGenerator geoGen;
+				entry.Result = Shape();
+				entry.Generate(geoGen, entry.Result);
+
+				auto& vertices = entry.Result.Mesh.Vertices;
+				entry.Bounds = BoundingBox();
+				if(!vertices.empty())
+					entry.Bounds = BoundsBuilder::ComputeBox(&vertices[0].Position, sizeof(GeometryGenerator::Vertex), vertices.size(), pool);
+			}
+			catch(...)
+			{
+				entry.Error = std::current_exception();
+			}
+		}
+	});
+
+	for(auto& entry : mEntries)
+	{
+		if(entry.Error)
+			std::rethrow_exception(entry.Error);
+	}
+
+	// Each shape's vertices, then its indices followed by its extra ranges.
+	mVertexCount = 0;
+	mIndexCount = 0;
+	for(auto& entry : mEntries)
+	{
+		entry.BaseVertexLocation = (uint32)mVertexCount;
+		entry.StartIndexLocation = (uint32)mIndexCount;
+
+		mVertexCount += entry.Result.Mesh.Vertices.size();
+		mIndexCount += entry.Result.Mesh.Indices32.size();
+		for(auto& range : entry.Result.Extras)
+			mIndexCount += range.Indices.size();
+	}
+}
+
+size_t MeshBatchBuilder::VertexCount()const
+{
+	return mVertexCount;
+}
+
+size_t MeshBatchBuilder::IndexCount()const
+{
+	return mIndexCount;
+}
+
+bool MeshBatchBuilder::Fits16BitIndices()const
+{
+	for(auto& entry : mEntries)
+	{
+		if(!entry.Result.Mesh.Fits16BitIndices())
+			return false;
+	}
+	return true;
+}
+
+template<typename IndexT>
+void MeshBatchBuilder::WriteIndicesT(IndexT* out, ThreadPool& pool)const
+{
+	pool.ParallelFor(0, (int)mEntries.size(), 1, [&](int first, int last)
+	{
+		for(int i = first; i < last; ++i)
+		{
+			const Entry& entry = mEntries[i];
+			IndexT* dst = out + entry.StartIndexLocation;
+
+			for(uint32 index : entry.Result.Mesh.Indices32)
+				*dst++ = (IndexT)index;
+
+			for(auto& range : entry.Result.Extras)
+			{
+				for(uint32 index : range.Indices)
+					*dst++ = (IndexT)index;
+			}
+		}
+	});
+}
+
+void MeshBatchBuilder::WriteIndices(std::uint16_t* out, ThreadPool& pool)const
+{
+	assert(Fits16BitIndices());
+	WriteIndicesT(out, pool);
+}
+
+void MeshBatchBuilder::WriteIndices(std::uint32_t* out, ThreadPool& pool)const
+{
+	WriteIndicesT(out, pool);
+}
+
+void MeshBatchBuilder::FillDrawArgs(std::unordered_map<std::string, SubmeshGeometry>& drawArgs)const
+{
+	for(auto& entry : mEntries)
+	{
+		SubmeshGeometry submesh;
+		submesh.IndexCount = (uint32)entry.Result.Mesh.Indices32.size();
+		submesh.StartIndexLocation = entry.StartIndexLocation;
+		submesh.BaseVertexLocation = (std::int32_t)entry.BaseVertexLocation;
+		submesh.Bounds = entry.Bounds;
+		drawArgs[entry.Name] = submesh;
+
+		for(auto& range : entry.Result.Extras)
+		{
+			submesh.StartIndexLocation += submesh.IndexCount;
+			submesh.IndexCount = (uint32)range.Indices.size();
+			submesh.LodError = range.LodError;
+			drawArgs[entry.Name + range.Suffix] = submesh;
+		}
+	}
+}
@@ -0,0 +1,104 @@
+//***************************************************************************************
+// MeshBatchBuilder.h
+//
+// Packs several generated shapes into one vertex/index buffer pair.  Shapes are
+// generated concurrently on a ThreadPool, laid out back to back with a prefix sum,
+// converted into the app's vertex format in parallel, and described by one
+// SubmeshGeometry (with bounds) each.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include "SubmeshGeometry.h"
+#include "ThreadPool.h"
+#include <exception>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class MeshBatchBuilder
+{
+public:
+	using uint32 = std::uint32_t;
+
+	struct Shape
+	{
+		// Indices are read from Mesh.Indices32.
+		GeometryGenerator::MeshData Mesh;
+
+		// Extra index lists over the same vertices, e.g. LODs.  Each one becomes a
+		// submesh named <shape name><Suffix>.
+		struct Range
+		{
+			std::string Suffix;
+			std::vector<uint32> Indices;
+			float LodError = 0.0f;
+		};
+		std::vector<Range> Extras;
+	};
+
+	// Runs on a worker thread.  Each call gets its own GeometryGenerator, which is
+	// not safe to share between threads.
+	using Generator = std::function<void(GeometryGenerator& geoGen, Shape& shape)>;
+
+	// Shapes are packed in the order they are added.
+	void Add(const std::string& name, Generator generator);
+
+	// Generates every shape, one task per shape, then computes the offsets.  An
+	// exception thrown by a generator is rethrown here.
+	void Build(ThreadPool& pool = ThreadPool::Shared());
+
+	size_t VertexCount()const;
+	size_t IndexCount()const;
+
+	// Indices are relative to each shape's BaseVertexLocation, so 16 bits are
+	// enough as long as no single shape has more than 65536 vertices.
+	bool Fits16BitIndices()const;
+
+	// Converts the vertices of every shape into out[VertexCount()], calling
+	// convert(const GeometryGenerator::Vertex&, VertexT&) for each one.
+	template<typename VertexT, typename Convert>
+	void WriteVertices(VertexT* out, Convert convert, ThreadPool& pool = ThreadPool::Shared())const
+	{
+		pool.ParallelFor(0, (int)mEntries.size(), 1, [&](int first, int last)
+		{
+			for(int i = first; i < last; ++i)
+			{
+				const Entry& entry = mEntries[i];
+				VertexT* dst = out + entry.BaseVertexLocation;
+				for(auto& v : entry.Result.Mesh.Vertices)
+					convert(v, *dst++);
+			}
+		});
+	}
+
+	// Writes out[IndexCount()].  The 16-bit version requires Fits16BitIndices().
+	void WriteIndices(std::uint16_t* out, ThreadPool& pool = ThreadPool::Shared())const;
+	void WriteIndices(std::uint32_t* out, ThreadPool& pool = ThreadPool::Shared())const;
+
+	// Adds one submesh per shape and per extra range.  Bounds are the axis aligned
+	// box of the shape's generated positions, shared by its extra ranges.
+	void FillDrawArgs(std::unordered_map<std::string, SubmeshGeometry>& drawArgs)const;
+
+private:
+	struct Entry
+	{
+		std::string Name;
+		Generator Generate;
+		Shape Result;
+		std::exception_ptr Error;
+
+		DirectX::BoundingBox Bounds;
+		uint32 BaseVertexLocation = 0;
+		uint32 StartIndexLocation = 0;
+	};
+
+	template<typename IndexT>
+	void WriteIndicesT(IndexT* out, ThreadPool& pool)const;
+
+	std::vector<Entry> mEntries;
+	size_t mVertexCount = 0;
+	size_t mIndexCount = 0;
+};
@@ -0,0 +1,352 @@
+//***************************************************************************************
+// MeshOptimizer.cpp
+//***************************************************************************************
+
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using uint32 = MeshOptimizer::uint32;
+using Vertex = GeometryGenerator::Vertex;
+
+namespace
+{
+	//
+	// Forsyth vertex scoring, see "Linear-Speed Vertex Cache Optimisation" (2006).
+	// The constants are the ones from the article.
+	//
+
+	const int ScoreCacheSize = 32;
+	const float CacheDecayPower = 1.5f;
+	const float LastTriScore = 0.75f;
+	const float ValenceBoostScale = 2.0f;
+	const float ValenceBoostPower = 0.5f;
+	const int MaxScoredValence = 32;
+
+	struct ScoreTables
+	{
+		float Cache[ScoreCacheSize];
+		float Valence[MaxScoredValence + 1];
+
+		ScoreTables()
+		{
+			for(int i = 0; i < ScoreCacheSize; ++i)
+			{
+				if(i < 3)
+				{
+					// The three vertices of the last triangle get a fixed score so the
+					// next triangle does not simply reuse the same edge every time.
+					Cache[i] = LastTriScore;
+				}
+				else
+				{
+					float s = 1.0f - (i - 3)*(1.0f/(ScoreCacheSize - 3));
+					Cache[i] = powf(s, CacheDecayPower);
+				}
+			}
+
+			Valence[0] = 0.0f;
+			for(int i = 1; i <= MaxScoredValence; ++i)
+				Valence[i] = ValenceBoostScale*powf((float)i, -ValenceBoostPower);
+		}
+	};
+
+	float VertexScore(const ScoreTables& tables, int cachePosition, uint32 remainingValence)
+	{
+		// No triangles left to draw: the vertex should not attract anything.
+		if(remainingValence == 0)
+			return -1.0f;
+
+		float score = cachePosition >= 0 ? tables.Cache[cachePosition] : 0.0f;
+		score += tables.Valence[std::min<uint32>(remainingValence, MaxScoredValence)];
+		return score;
+	}
+
+	uint32 HashVertex(const Vertex& v)
+	{
+		// FNV-1a over the raw attribute words.
+		uint32 words[sizeof(Vertex)/sizeof(uint32)];
+		std::memcpy(words, &v, sizeof(Vertex));
+
+		uint32 h = 2166136261u;
+		for(uint32 w : words)
+			h = (h ^ w)*16777619u;
+		return h;
+	}
+}
+
+size_t MeshOptimizer::WeldVertices(GeometryGenerator::MeshData& meshData)
+{
+	static_assert(sizeof(Vertex) % sizeof(uint32) == 0, "Vertex is hashed as 32-bit words.");
+
+	std::vector<Vertex>& vertices = meshData.Vertices;
+	size_t vertexCount = vertices.size();
+
+	size_t capacity = 16;
+	while(capacity < 2*vertexCount)
+		capacity <<= 1;
+	size_t mask = capacity - 1;
+
+	// Table of indices into the welded vertex array; ~0 marks an empty slot.
+	const uint32 Empty = ~0u;
+	std::vector<uint32> table(capacity, Empty);
+	std::vector<uint32> remap(vertexCount);
+
+	uint32 unique = 0;
+	for(size_t i = 0; i < vertexCount; ++i)
+	{
+		size_t slot = HashVertex(vertices[i]) & mask;
+		while(table[slot] != Empty &&
+			std::memcmp(&vertices[table[slot]], &vertices[i], sizeof(Vertex)) != 0)
+		{
+			slot = (slot + 1) & mask;
+		}
+
+		if(table[slot] == Empty)
+		{
+			// First time we see this vertex: compact it down in place.
+			vertices[unique] = vertices[i];
+			table[slot] = unique++;
+		}
+
+		remap[i] = table[slot];
+	}
+
+	vertices.resize(unique);
+	for(uint32& index : meshData.Indices32)
+		index = remap[index];
+
+	return vertexCount - unique;
+}
+
+void MeshOptimizer::OptimizeVertexCache(uint32* indices, size_t indexCount, size_t vertexCount)
+{
+	static const ScoreTables tables;
+
+	size_t triCount = indexCount/3;
+	if(triCount == 0)
+		return;
+
+	//
+	// Vertex -> triangle adjacency.  Each vertex owns a slice of triangleLists; the
+	// first remaining[v] entries are the triangles still waiting to be emitted.
+	//
+
+	std::vector<uint32> remaining(vertexCount, 0);
+	for(size_t i = 0; i < indexCount; ++i)
+		++remaining[indices[i]];
+
+	std::vector<uint32> firstTriangle(vertexCount + 1);
+	firstTriangle[0] = 0;
+	for(size_t v = 0; v < vertexCount; ++v)
+		firstTriangle[v+1] = firstTriangle[v] + remaining[v];
+
+	std::vector<uint32> triangleLists(indexCount);
+	{
+		std::vector<uint32> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+		for(size_t t = 0; t < triCount; ++t)
+		{
+			for(int k = 0; k < 3; ++k)
+				triangleLists[fill[indices[t*3+k]]++] = (uint32)t;
+		}
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for(size_t v = 0; v < vertexCount; ++v)
+		vertexScore[v] = VertexScore(tables, -1, remaining[v]);
+
+	std::vector<float> triangleScore(triCount);
+	std::vector<bool> emitted(triCount, false);
+	for(size_t t = 0; t < triCount; ++t)
+	{
+		triangleScore[t] = vertexScore[indices[t*3+0]] +
+			vertexScore[indices[t*3+1]] + vertexScore[indices[t*3+2]];
+	}
+
+	// Output goes to a copy because the input indices are read until the end.
+	std::vector<uint32> output(indexCount);
+	size_t outputTris = 0;
+
+	// Simulated LRU cache.  Three extra slots hold the vertices pushed out by the
+	// newest triangle so they can be rescored.
+	int cache[ScoreCacheSize + 3];
+	int cacheSize = 0;
+
+	size_t bestTriangle = 0;
+	for(size_t t = 1; t < triCount; ++t)
+	{
+		if(triangleScore[t] > triangleScore[bestTriangle])
+			bestTriangle = t;
+	}
+
+	size_t deadEndCursor = 0;
+	while(outputTris < triCount)
+	{
+		if(bestTriangle == (size_t)-1)
+		{
+			// Nothing in the cache touches a live triangle; restart from the first
+			// triangle that has not been drawn yet.
+			while(emitted[deadEndCursor])
+				++deadEndCursor;
+			bestTriangle = deadEndCursor;
+		}
+
+		const uint32* tri = &indices[bestTriangle*3];
+		output[outputTris*3+0] = tri[0];
+		output[outputTris*3+1] = tri[1];
+		output[outputTris*3+2] = tri[2];
+		++outputTris;
+		emitted[bestTriangle] = true;
+
+		// Remove the triangle from its vertices' live lists.
+		for(int k = 0; k < 3; ++k)
+		{
+			uint32 v = tri[k];
+			uint32* list = &triangleLists[firstTriangle[v]];
+			uint32 count = remaining[v];
+			for(uint32 j = 0; j < count; ++j)
+			{
+				if(list[j] == bestTriangle)
+				{
+					std::swap(list[j], list[count-1]);
+					break;
+				}
+			}
+			--remaining[v];
+		}
+
+		// Move the triangle's vertices to the front of the cache.
+		int newCache[ScoreCacheSize + 3];
+		int newSize = 0;
+		for(int k = 0; k < 3; ++k)
+			newCache[newSize++] = (int)tri[k];
+		for(int c = 0; c < cacheSize; ++c)
+		{
+			int v = cache[c];
+			if(v != (int)tri[0] && v != (int)tri[1] && v != (int)tri[2])
+				newCache[newSize++] = v;
+		}
+
+		// Rescore everything that moved (including what fell off the end) and push
+		// the score change into the triangles still using those vertices.
+		bestTriangle = (size_t)-1;
+		float bestScore = -1.0f;
+		for(int c = 0; c < newSize; ++c)
+		{
+			int v = newCache[c];
+			int position = c < ScoreCacheSize ? c : -1;
+			cachePosition[v] = position;
+
+			float score = VertexScore(tables, position, remaining[v]);
+			float delta = score - vertexScore[v];
+			vertexScore[v] = score;
+
+			const uint32* list = &triangleLists[firstTriangle[v]];
+			for(uint32 j = 0; j < remaining[v]; ++j)
+			{
+				uint32 t = list[j];
+				triangleScore[t] += delta;
+
+				if(position >= 0 && triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					bestTriangle = t;
+				}
+			}
+		}
+
+		cacheSize = std::min(newSize, ScoreCacheSize);
+		std::copy(newCache, newCache + cacheSize, cache);
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(GeometryGenerator::MeshData& meshData)
+{
+	const uint32 Unused = ~0u;
+
+	std::vector<Vertex>& vertices = meshData.Vertices;
+	std::vector<uint32> remap(vertices.size(), Unused);
+
+	uint32 next = 0;
+	for(uint32& index : meshData.Indices32)
+	{
+		if(remap[index] == Unused)
+			remap[index] = next++;
+		index = remap[index];
+	}
+
+	std::vector<Vertex> reordered(next);
+	for(size_t v = 0; v < vertices.size(); ++v)
+	{
+		if(remap[v] != Unused)
+			reordered[remap[v]] = vertices[v];
+	}
+
+	vertices.swap(reordered);
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::AnalyzeVertexCache(const uint32* indices, size_t indexCount,
+	size_t vertexCount, uint32 cacheSize)
+{
+	CacheStats stats;
+	if(indexCount < 3)
+		return stats;
+
+	// A vertex is still cached if fewer than cacheSize misses happened since it
+	// was last loaded.  Stamps start at zero, so begin the clock past cacheSize.
+	std::vector<uint32> loadedAt(vertexCount, 0);
+	uint32 clock = cacheSize + 1;
+	size_t misses = 0;
+	size_t referenced = 0;
+
+	for(size_t i = 0; i < indexCount; ++i)
+	{
+		uint32 v = indices[i];
+		assert(v < vertexCount);
+
+		if(loadedAt[v] == 0)
+			++referenced;
+
+		if(clock - loadedAt[v] > cacheSize)
+		{
+			loadedAt[v] = clock++;
+			++misses;
+		}
+	}
+
+	stats.Acmr = (float)misses/(indexCount/3);
+	stats.Atvr = (float)misses/referenced;
+	return stats;
+}
+
+MeshOptimizer::Report MeshOptimizer::Optimize(GeometryGenerator::MeshData& meshData)
+{
+	Report report;
+	report.VerticesBefore = meshData.Vertices.size();
+	report.Before = AnalyzeVertexCache(meshData.Indices32.data(), meshData.Indices32.size(), meshData.Vertices.size());
+
+	WeldVertices(meshData);
+	OptimizeVertexCache(meshData.Indices32.data(), meshData.Indices32.size(), meshData.Vertices.size());
+	OptimizeVertexFetch(meshData);
+
+	report.VerticesAfter = meshData.Vertices.size();
+	report.After = AnalyzeVertexCache(meshData.Indices32.data(), meshData.Indices32.size(), meshData.Vertices.size());
+	return report;
+}
+
+std::string MeshOptimizer::FormatReport(const char* name, const Report& report)
+{
+	char text[256];
+	std::snprintf(text, sizeof(text),
+		"%s: vertices %zu -> %zu, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+		name, report.VerticesBefore, report.VerticesAfter,
+		report.Before.Acmr, report.After.Acmr,
+		report.Before.Atvr, report.After.Atvr);
+	return text;
+}
@@ -0,0 +1,63 @@
+//***************************************************************************************
+// MeshOptimizer.h
+//
+// Post-generation clean up for indexed triangle lists: welds duplicate vertices,
+// reorders triangles for the post-transform vertex cache (Forsyth's linear-speed
+// algorithm) and renumbers vertices so they are fetched in order.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include <string>
+
+class MeshOptimizer
+{
+public:
+	using uint32 = std::uint32_t;
+
+	struct CacheStats
+	{
+		// Average cache miss ratio: vertex shader runs per triangle (0.5 is ideal
+		// for a large regular mesh, 3 is no reuse at all).
+		float Acmr = 0.0f;
+
+		// Average transform to vertex ratio: vertex shader runs per referenced
+		// vertex (1 is ideal).
+		float Atvr = 0.0f;
+	};
+
+	struct Report
+	{
+		CacheStats Before;
+		CacheStats After;
+		size_t VerticesBefore = 0;
+		size_t VerticesAfter = 0;
+	};
+
+	// FIFO size used when simulating the cache.  Matches the small post-transform
+	// caches the ACMR figures in the literature are quoted against.
+	static const uint32 DefaultCacheSize = 16;
+
+	// Merges vertices whose attributes are bit-for-bit identical and rewrites the
+	// indices to match.  Returns the number of vertices removed.
+	static size_t WeldVertices(GeometryGenerator::MeshData& meshData);
+
+	// Reorders the triangles of an indexed triangle list in place so that
+	// consecutive triangles share as many vertices as possible.
+	static void OptimizeVertexCache(uint32* indices, size_t indexCount, size_t vertexCount);
+
+	// Renumbers vertices in the order the index list first touches them, dropping
+	// any that are never referenced.
+	static void OptimizeVertexFetch(GeometryGenerator::MeshData& meshData);
+
+	// Simulates a FIFO post-transform cache over an index list.
+	static CacheStats AnalyzeVertexCache(const uint32* indices, size_t indexCount, size_t vertexCount,
+		uint32 cacheSize = DefaultCacheSize);
+
+	// Weld, cache reorder and fetch remap in that order, with before/after stats.
+	static Report Optimize(GeometryGenerator::MeshData& meshData);
+
+	// One line summary suitable for OutputDebugStringA.
+	static std::string FormatReport(const char* name, const Report& report);
+};
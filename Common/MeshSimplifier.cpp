@@ -0,0 +1,363 @@
+//***************************************************************************************
+// MeshSimplifier.cpp
+//***************************************************************************************
+
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+
+using uint32 = MeshSimplifier::uint32;
+
+namespace
+{
+	struct Vec3
+	{
+		double x, y, z;
+	};
+
+	Vec3 Sub(const Vec3& a, const Vec3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	double Dot(const Vec3& a, const Vec3& b) { return a.x*b.x + a.y*b.y + a.z*b.z; }
+	Vec3 Cross(const Vec3& a, const Vec3& b) { return { a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x }; }
+
+	// Symmetric 4x4 plane quadric, upper triangle only.
+	struct Quadric
+	{
+		double a2 = 0, ab = 0, ac = 0, ad = 0;
+		double b2 = 0, bc = 0, bd = 0;
+		double c2 = 0, cd = 0;
+		double d2 = 0;
+
+		void AddPlane(double a, double b, double c, double d, double w)
+		{
+			a2 += w*a*a; ab += w*a*b; ac += w*a*c; ad += w*a*d;
+			b2 += w*b*b; bc += w*b*c; bd += w*b*d;
+			c2 += w*c*c; cd += w*c*d;
+			d2 += w*d*d;
+		}
+
+		void Add(const Quadric& q)
+		{
+			a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+			b2 += q.b2; bc += q.bc; bd += q.bd;
+			c2 += q.c2; cd += q.cd;
+			d2 += q.d2;
+		}
+
+		// Sum of squared distances from p to every accumulated plane.
+		double Evaluate(const Vec3& p)const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double r = a2*x*x + 2*ab*x*y + 2*ac*x*z + 2*ad*x
+				+ b2*y*y + 2*bc*y*z + 2*bd*y
+				+ c2*z*z + 2*cd*z
+				+ d2;
+			return std::max(r, 0.0);
+		}
+	};
+
+	struct Collapse
+	{
+		double Cost;
+		uint32 From;
+		uint32 To;
+
+		bool operator<(const Collapse& rhs)const { return Cost < rhs.Cost; }
+	};
+
+	std::uint64_t EdgeKey(uint32 a, uint32 b)
+	{
+		return ((std::uint64_t)a << 32) | b;
+	}
+}
+
+float MeshSimplifier::Simplify(const GeometryGenerator::MeshData& meshData,
+	const uint32* indices, size_t indexCount,
+	size_t targetIndexCount, float targetError,
+	std::vector<uint32>& out)
+{
+	out.assign(indices, indices + indexCount);
+
+	const std::vector<GeometryGenerator::Vertex>& vertices = meshData.Vertices;
+	size_t vertexCount = vertices.size();
+	if(vertexCount == 0 || indexCount <= targetIndexCount)
+		return 0.0f;
+
+	//
+	// Work in coordinates normalized to the bounding sphere so errors are
+	// relative to the mesh size.
+	//
+
+	Vec3 lo = { +1e30, +1e30, +1e30 };
+	Vec3 hi = { -1e30, -1e30, -1e30 };
+	for(const auto& v : vertices)
+	{
+		lo = { std::min(lo.x, (double)v.Position.x), std::min(lo.y, (double)v.Position.y), std::min(lo.z, (double)v.Position.z) };
+		hi = { std::max(hi.x, (double)v.Position.x), std::max(hi.y, (double)v.Position.y), std::max(hi.z, (double)v.Position.z) };
+	}
+
+	Vec3 center = { 0.5*(lo.x + hi.x), 0.5*(lo.y + hi.y), 0.5*(lo.z + hi.z) };
+	double radius = 0.5*std::sqrt(Dot(Sub(hi, lo), Sub(hi, lo)));
+	double invRadius = radius > 0.0 ? 1.0/radius : 1.0;
+
+	std::vector<Vec3> positions(vertexCount);
+	for(size_t v = 0; v < vertexCount; ++v)
+	{
+		const auto& p = vertices[v].Position;
+		positions[v] = { (p.x - center.x)*invRadius, (p.y - center.y)*invRadius, (p.z - center.z)*invRadius };
+	}
+
+	//
+	// Group vertices by position.  Vertices that share a position with another
+	// vertex sit on an attribute seam and are locked.
+	//
+
+	std::vector<uint32> byPosition(vertexCount);
+	for(size_t v = 0; v < vertexCount; ++v)
+		byPosition[v] = (uint32)v;
+
+	auto positionLess = [&](uint32 a, uint32 b)
+	{
+		const auto& pa = vertices[a].Position;
+		const auto& pb = vertices[b].Position;
+		if(pa.x != pb.x) return pa.x < pb.x;
+		if(pa.y != pb.y) return pa.y < pb.y;
+		return pa.z < pb.z;
+	};
+	std::sort(byPosition.begin(), byPosition.end(), positionLess);
+
+	std::vector<uint32> positionId(vertexCount);
+	std::vector<bool> locked(vertexCount, false);
+	for(size_t i = 0; i < vertexCount; )
+	{
+		size_t j = i + 1;
+		while(j < vertexCount && !positionLess(byPosition[i], byPosition[j]))
+			++j;
+
+		for(size_t k = i; k < j; ++k)
+		{
+			positionId[byPosition[k]] = byPosition[i];
+			if(j - i > 1)
+				locked[byPosition[k]] = true;
+		}
+		i = j;
+	}
+
+	//
+	// Lock open borders: an edge is on the border if no triangle walks it in the
+	// opposite direction.
+	//
+
+	std::vector<std::uint64_t> halfEdges;
+	halfEdges.reserve(indexCount);
+	for(size_t t = 0; t < indexCount; t += 3)
+	{
+		for(int k = 0; k < 3; ++k)
+			halfEdges.push_back(EdgeKey(positionId[indices[t+k]], positionId[indices[t+(k+1)%3]]));
+	}
+	std::sort(halfEdges.begin(), halfEdges.end());
+
+	for(size_t t = 0; t < indexCount; t += 3)
+	{
+		for(int k = 0; k < 3; ++k)
+		{
+			uint32 a = indices[t+k];
+			uint32 b = indices[t+(k+1)%3];
+			if(!std::binary_search(halfEdges.begin(), halfEdges.end(), EdgeKey(positionId[b], positionId[a])))
+				locked[a] = locked[b] = true;
+		}
+	}
+
+	//
+	// Plane quadrics per vertex.  The planes are not area weighted, so the square
+	// root of a cost bounds the distance to every plane it was built from and
+	// reads directly as a (relative) geometric error.
+	//
+
+	std::vector<Quadric> quadrics(vertexCount);
+	for(size_t t = 0; t < indexCount; t += 3)
+	{
+		const Vec3& p0 = positions[indices[t+0]];
+		const Vec3& p1 = positions[indices[t+1]];
+		const Vec3& p2 = positions[indices[t+2]];
+
+		Vec3 n = Cross(Sub(p1, p0), Sub(p2, p0));
+		double len = std::sqrt(Dot(n, n));
+		if(len <= 0.0)
+			continue;
+
+		n = { n.x/len, n.y/len, n.z/len };
+		double d = -Dot(n, p0);
+
+		for(int k = 0; k < 3; ++k)
+			quadrics[indices[t+k]].AddPlane(n.x, n.y, n.z, d, 1.0);
+	}
+
+	//
+	// Collapse passes.  Each pass ranks every candidate by cost and applies as
+	// many as it can without two collapses touching the same neighbourhood, then
+	// rebuilds the index list and repeats.
+	//
+
+	double maxCost = (double)targetError*targetError;
+	double reachedCost = 0.0;
+
+	std::vector<uint32> firstTriangle(vertexCount + 1);
+	std::vector<uint32> vertexTriangles;
+	std::vector<Collapse> candidates;
+	std::vector<uint32> collapseTo(vertexCount);
+	std::vector<bool> touched(vertexCount);
+
+	while(out.size() > targetIndexCount)
+	{
+		size_t triCount = out.size()/3;
+
+		// Vertex -> triangle adjacency for this pass.
+		std::fill(firstTriangle.begin(), firstTriangle.end(), 0);
+		for(uint32 index : out)
+			++firstTriangle[index + 1];
+		for(size_t v = 0; v < vertexCount; ++v)
+			firstTriangle[v+1] += firstTriangle[v];
+
+		vertexTriangles.resize(out.size());
+		{
+			std::vector<uint32> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+			for(size_t t = 0; t < triCount; ++t)
+			{
+				for(int k = 0; k < 3; ++k)
+					vertexTriangles[fill[out[t*3+k]]++] = (uint32)t;
+			}
+		}
+
+		candidates.clear();
+		for(size_t t = 0; t < triCount; ++t)
+		{
+			for(int k = 0; k < 3; ++k)
+			{
+				uint32 a = out[t*3+k];
+				uint32 b = out[t*3+(k+1)%3];
+				if(locked[a])
+					continue;
+
+				double cost = quadrics[a].Evaluate(positions[b]);
+				if(cost <= maxCost)
+					candidates.push_back({ cost, a, b });
+			}
+		}
+
+		if(candidates.empty())
+			break;
+
+		std::sort(candidates.begin(), candidates.end());
+
+		for(size_t v = 0; v < vertexCount; ++v)
+			collapseTo[v] = (uint32)v;
+		std::fill(touched.begin(), touched.end(), false);
+
+		size_t remainingTris = triCount;
+		size_t applied = 0;
+		for(const Collapse& c : candidates)
+		{
+			if(remainingTris*3 <= targetIndexCount)
+				break;
+
+			uint32 a = c.From;
+			uint32 b = c.To;
+			if(touched[a] || touched[b])
+				continue;
+
+			// Reject the collapse if any surviving triangle around a would flip.
+			bool flips = false;
+			size_t removed = 0;
+			for(uint32 j = firstTriangle[a]; j < firstTriangle[a+1] && !flips; ++j)
+			{
+				const uint32* tri = &out[vertexTriangles[j]*3];
+				if(tri[0] == b || tri[1] == b || tri[2] == b)
+				{
+					++removed;
+					continue;
+				}
+
+				Vec3 p[3] = { positions[tri[0]], positions[tri[1]], positions[tri[2]] };
+				Vec3 before = Cross(Sub(p[1], p[0]), Sub(p[2], p[0]));
+				for(int k = 0; k < 3; ++k)
+				{
+					if(tri[k] == a)
+						p[k] = positions[b];
+				}
+				Vec3 after = Cross(Sub(p[1], p[0]), Sub(p[2], p[0]));
+
+				flips = Dot(before, after) <= 0.0;
+			}
+
+			if(flips)
+				continue;
+
+			collapseTo[a] = b;
+			quadrics[b].Add(quadrics[a]);
+			reachedCost = std::max(reachedCost, c.Cost);
+			remainingTris -= removed;
+			++applied;
+
+			// Freeze a's whole one-ring so later collapses in this pass see the
+			// triangles exactly as the adjacency describes them.
+			for(uint32 j = firstTriangle[a]; j < firstTriangle[a+1]; ++j)
+			{
+				const uint32* tri = &out[vertexTriangles[j]*3];
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+			}
+		}
+
+		if(applied == 0)
+			break;
+
+		// Apply the collapses and drop the triangles that became degenerate.
+		size_t write = 0;
+		for(size_t t = 0; t < triCount; ++t)
+		{
+			uint32 i0 = collapseTo[out[t*3+0]];
+			uint32 i1 = collapseTo[out[t*3+1]];
+			uint32 i2 = collapseTo[out[t*3+2]];
+
+			if(positionId[i0] == positionId[i1] || positionId[i1] == positionId[i2] || positionId[i0] == positionId[i2])
+				continue;
+
+			out[write++] = i0;
+			out[write++] = i1;
+			out[write++] = i2;
+		}
+		out.resize(write);
+	}
+
+	return (float)std::sqrt(reachedCost);
+}
+
+std::vector<MeshSimplifier::LodLevel> MeshSimplifier::BuildLodChain(const GeometryGenerator::MeshData& meshData,
+	int maxLevels, float reduction, float maxError)
+{
+	std::vector<LodLevel> levels;
+
+	const std::vector<uint32>& full = meshData.Indices32;
+	size_t previousCount = full.size();
+	double target = (double)full.size()/3;
+
+	for(int level = 0; level < maxLevels; ++level)
+	{
+		// Every level starts from the full mesh so its quadrics, and therefore its
+		// error, are measured against the original surface.
+		target *= reduction;
+
+		LodLevel lod;
+		lod.Error = Simplify(meshData, full.data(), full.size(), (size_t)target*3, maxError, lod.Indices);
+
+		if(lod.Indices.size() > previousCount*9/10)
+			break;
+
+		if(!levels.empty())
+			lod.Error = std::max(lod.Error, levels.back().Error);
+
+		previousCount = lod.Indices.size();
+		levels.push_back(std::move(lod));
+	}
+
+	return levels;
+}
@@ -0,0 +1,41 @@
+//***************************************************************************************
+// MeshSimplifier.h
+//
+// Quadric error metric (Garland & Heckbert) edge-collapse simplifier.  Collapses
+// always move a vertex onto one of its neighbours, so a simplified mesh only needs
+// a new index list and can share the vertex buffer of the original.  Vertices on
+// open borders or attribute seams (same position, different normal/UV) are
+// locked so the silhouette and texture seams do not tear.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+
+class MeshSimplifier
+{
+public:
+	using uint32 = std::uint32_t;
+
+	struct LodLevel
+	{
+		std::vector<uint32> Indices;
+
+		// Largest collapse error, as a fraction of the mesh's bounding radius.
+		float Error = 0.0f;
+	};
+
+	// Simplifies meshData's triangles towards targetIndexCount indices, stopping
+	// early once a collapse would exceed targetError (relative to the bounding
+	// radius).  Writes the result to out and returns the error that was reached.
+	static float Simplify(const GeometryGenerator::MeshData& meshData,
+		const uint32* indices, size_t indexCount,
+		size_t targetIndexCount, float targetError,
+		std::vector<uint32>& out);
+
+	// Builds up to maxLevels successively coarser index lists, each aiming for
+	// reduction times the triangles of the previous one.  Level generation stops
+	// when a level would remove less than 10% of the triangles or exceed maxError.
+	static std::vector<LodLevel> BuildLodChain(const GeometryGenerator::MeshData& meshData,
+		int maxLevels, float reduction = 0.5f, float maxError = 0.1f);
+};
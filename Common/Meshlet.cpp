@@ -0,0 +1,559 @@
+//***************************************************************************************
+// Meshlet.cpp
+//***************************************************************************************
+
+#include "Meshlet.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define MESHLET_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define MESHLET_SIMD_SSE2 1
+#endif
+
+using namespace DirectX;
+using uint32 = MeshletBuilder::uint32;
+
+namespace
+{
+	const uint32 NotInMeshlet = 0xffffffff;
+
+	// Below this cos(half angle) the cone is close to a hemisphere and the back face
+	// test would almost never succeed, so it is switched off.
+	const float MinConeDot = 0.1f;
+
+	// How far, relative to the meshlet's current radius, the builder may jump to a
+	// triangle that shares no vertex with it.
+	const float MaxJumpDistance = 1.5f;
+
+	XMFLOAT3 LoadPosition(const XMFLOAT3* positions, size_t stride, uint32 index)
+	{
+		return *reinterpret_cast<const XMFLOAT3*>(reinterpret_cast<const char*>(positions) + stride*index);
+	}
+
+	float DistanceSq(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		float dx = a.x - b.x;
+		float dy = a.y - b.y;
+		float dz = a.z - b.z;
+		return dx*dx + dy*dy + dz*dz;
+	}
+
+	// Ritter's bounding sphere followed by a pass that makes sure every vertex is
+	// inside despite rounding.
+	void ComputeSphere(const XMFLOAT3* positions, size_t stride, const uint32* vertices, uint32 vertexCount,
+		MeshletBounds& bounds)
+	{
+		XMFLOAT3 a = LoadPosition(positions, stride, vertices[0]);
+		XMFLOAT3 b = a;
+		float best = 0.0f;
+		for(uint32 i = 0; i < vertexCount; ++i)
+		{
+			XMFLOAT3 p = LoadPosition(positions, stride, vertices[i]);
+			float d = DistanceSq(p, a);
+			if(d > best)
+			{
+				best = d;
+				b = p;
+			}
+		}
+
+		best = 0.0f;
+		for(uint32 i = 0; i < vertexCount; ++i)
+		{
+			XMFLOAT3 p = LoadPosition(positions, stride, vertices[i]);
+			float d = DistanceSq(p, b);
+			if(d > best)
+			{
+				best = d;
+				a = p;
+			}
+		}
+
+		XMFLOAT3 center(0.5f*(a.x + b.x), 0.5f*(a.y + b.y), 0.5f*(a.z + b.z));
+		float radius = 0.5f*sqrtf(best);
+
+		for(uint32 i = 0; i < vertexCount; ++i)
+		{
+			XMFLOAT3 p = LoadPosition(positions, stride, vertices[i]);
+			float d = sqrtf(DistanceSq(p, center));
+			if(d > radius)
+			{
+				float newRadius = 0.5f*(radius + d);
+				float t = (newRadius - radius) / d;
+				center.x += t*(p.x - center.x);
+				center.y += t*(p.y - center.y);
+				center.z += t*(p.z - center.z);
+				radius = newRadius;
+			}
+		}
+
+		for(uint32 i = 0; i < vertexCount; ++i)
+			radius = std::max(radius, sqrtf(DistanceSq(LoadPosition(positions, stride, vertices[i]), center)));
+
+		bounds.Center = center;
+		bounds.Radius = radius;
+	}
+
+	// Triangle normals follow the left-handed, clockwise front face convention used
+	// by GeometryGenerator, so the axis points out of the visible side.
+	void ComputeCone(const XMFLOAT3* positions, size_t stride, const uint32* indices, uint32 triangleCount,
+		MeshletBounds& bounds)
+	{
+		std::vector<XMFLOAT3> normals;
+		normals.reserve(triangleCount);
+
+		XMFLOAT3 axis(0.0f, 0.0f, 0.0f);
+		for(uint32 t = 0; t < triangleCount; ++t)
+		{
+			XMFLOAT3 p0 = LoadPosition(positions, stride, indices[3*t + 0]);
+			XMFLOAT3 p1 = LoadPosition(positions, stride, indices[3*t + 1]);
+			XMFLOAT3 p2 = LoadPosition(positions, stride, indices[3*t + 2]);
+
+			float e1x = p1.x - p0.x, e1y = p1.y - p0.y, e1z = p1.z - p0.z;
+			float e2x = p2.x - p0.x, e2y = p2.y - p0.y, e2z = p2.z - p0.z;
+
+			XMFLOAT3 n(e1y*e2z - e1z*e2y, e1z*e2x - e1x*e2z, e1x*e2y - e1y*e2x);
+			float length = sqrtf(n.x*n.x + n.y*n.y + n.z*n.z);
+			if(length <= 1e-20f)
+				continue;
+
+			n.x /= length;
+			n.y /= length;
+			n.z /= length;
+			normals.push_back(n);
+
+			axis.x += n.x;
+			axis.y += n.y;
+			axis.z += n.z;
+		}
+
+		bounds.ConeAxis = XMFLOAT3(0.0f, 0.0f, 1.0f);
+		bounds.ConeCutoff = 1.0f;
+
+		float axisLength = sqrtf(axis.x*axis.x + axis.y*axis.y + axis.z*axis.z);
+		if(normals.empty() || axisLength <= 1e-20f)
+			return;
+
+		axis.x /= axisLength;
+		axis.y /= axisLength;
+		axis.z /= axisLength;
+
+		float minDot = 1.0f;
+		for(auto& n : normals)
+			minDot = std::min(minDot, n.x*axis.x + n.y*axis.y + n.z*axis.z);
+
+		bounds.ConeAxis = axis;
+		if(minDot > MinConeDot)
+			bounds.ConeCutoff = sqrtf(1.0f - minDot*minDot);
+	}
+
+	bool IsVisible(const MeshletCuller::View& view,
+		float cx, float cy, float cz, float radius,
+		float ax, float ay, float az, float cutoff)
+	{
+		for(int i = 0; i < 6; ++i)
+		{
+			const XMFLOAT4& p = view.Planes[i];
+			if(p.x*cx + p.y*cy + p.z*cz + p.w < -radius)
+				return false;
+		}
+
+		// Every triangle faces away when the view direction to the cluster lies
+		// inside the cone's back side, widened by the sphere.
+		float dx = cx - view.Eye.x;
+		float dy = cy - view.Eye.y;
+		float dz = cz - view.Eye.z;
+		float distance = sqrtf(dx*dx + dy*dy + dz*dz);
+		return dx*ax + dy*ay + dz*az < cutoff*distance + radius;
+	}
+}
+
+void MeshletBuilder::Build(const XMFLOAT3* positions, size_t stride, size_t vertexCount,
+	const uint32* indices, size_t indexCount, MeshletMesh& out,
+	uint32 maxVertices, uint32 maxTriangles)
+{
+	// Local indices are packed into 10 bits.
+	assert(maxVertices >= 3 && maxVertices <= 1024);
+	assert(maxTriangles >= 1);
+
+	out.Meshlets.clear();
+	out.Bounds.clear();
+	out.UniqueVertexIndices.clear();
+	out.PrimitiveIndices.clear();
+	out.Indices.clear();
+
+	const size_t triangleCount = indexCount / 3;
+	if(triangleCount == 0)
+		return;
+
+	out.PrimitiveIndices.reserve(triangleCount);
+	out.Indices.reserve(triangleCount*3);
+
+	// Triangles around each vertex, as offsets into one flat array.
+	std::vector<uint32> adjacencyOffsets(vertexCount + 1, 0);
+	for(size_t i = 0; i < triangleCount*3; ++i)
+		++adjacencyOffsets[indices[i] + 1];
+	for(size_t v = 0; v < vertexCount; ++v)
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+	std::vector<uint32> adjacency(triangleCount*3);
+	std::vector<uint32> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for(size_t i = 0; i < triangleCount*3; ++i)
+		adjacency[cursor[indices[i]]++] = (uint32)(i / 3);
+
+	std::vector<XMFLOAT3> centroids(triangleCount);
+	for(size_t t = 0; t < triangleCount; ++t)
+	{
+		XMFLOAT3 p0 = LoadPosition(positions, stride, indices[3*t + 0]);
+		XMFLOAT3 p1 = LoadPosition(positions, stride, indices[3*t + 1]);
+		XMFLOAT3 p2 = LoadPosition(positions, stride, indices[3*t + 2]);
+		centroids[t] = XMFLOAT3((p0.x + p1.x + p2.x) / 3.0f, (p0.y + p1.y + p2.y) / 3.0f, (p0.z + p1.z + p2.z) / 3.0f);
+	}
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32> localIndex(vertexCount, NotInMeshlet);
+
+	Meshlet current;
+	size_t seed = 0;
+
+	auto flush = [&]()
+	{
+		const uint32* vertices = &out.UniqueVertexIndices[current.VertexOffset];
+		for(uint32 i = 0; i < current.VertexCount; ++i)
+			localIndex[vertices[i]] = NotInMeshlet;
+
+		MeshletBounds bounds;
+		ComputeSphere(positions, stride, vertices, current.VertexCount, bounds);
+		ComputeCone(positions, stride, &out.Indices[3*current.PrimitiveOffset], current.PrimitiveCount, bounds);
+
+		out.Meshlets.push_back(current);
+		out.Bounds.push_back(bounds);
+
+		current.VertexOffset += current.VertexCount;
+		current.VertexCount = 0;
+		current.PrimitiveOffset += current.PrimitiveCount;
+		current.PrimitiveCount = 0;
+	};
+
+	for(;;)
+	{
+		// Prefer the unused triangle touching the meshlet that brings in the fewest
+		// new vertices.
+		uint32 best = NotInMeshlet;
+		uint32 bestNew = 4;
+		for(uint32 i = 0; i < current.VertexCount && bestNew > 0; ++i)
+		{
+			uint32 v = out.UniqueVertexIndices[current.VertexOffset + i];
+			for(uint32 a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; ++a)
+			{
+				uint32 t = adjacency[a];
+				if(emitted[t])
+					continue;
+
+				uint32 newVertices =
+					(localIndex[indices[3*t + 0]] == NotInMeshlet ? 1 : 0) +
+					(localIndex[indices[3*t + 1]] == NotInMeshlet ? 1 : 0) +
+					(localIndex[indices[3*t + 2]] == NotInMeshlet ? 1 : 0);
+
+				if(newVertices < bestNew)
+				{
+					best = t;
+					bestNew = newVertices;
+				}
+			}
+		}
+
+		// Nothing connected is left, e.g. at a UV seam.  Jump to the nearest unused
+		// triangle if it is close enough that the meshlet stays compact.
+		if(best == NotInMeshlet && current.PrimitiveCount > 0 &&
+			current.VertexCount + 3 <= maxVertices && current.PrimitiveCount < maxTriangles)
+		{
+			const uint32* vertices = &out.UniqueVertexIndices[current.VertexOffset];
+
+			XMFLOAT3 center(0.0f, 0.0f, 0.0f);
+			for(uint32 i = 0; i < current.VertexCount; ++i)
+			{
+				XMFLOAT3 p = LoadPosition(positions, stride, vertices[i]);
+				center.x += p.x;
+				center.y += p.y;
+				center.z += p.z;
+			}
+			center.x /= current.VertexCount;
+			center.y /= current.VertexCount;
+			center.z /= current.VertexCount;
+
+			float radiusSq = 0.0f;
+			for(uint32 i = 0; i < current.VertexCount; ++i)
+				radiusSq = std::max(radiusSq, DistanceSq(LoadPosition(positions, stride, vertices[i]), center));
+
+			float bestDistance = MaxJumpDistance*MaxJumpDistance*radiusSq;
+			for(size_t t = seed; t < triangleCount; ++t)
+			{
+				if(emitted[t])
+					continue;
+
+				float d = DistanceSq(centroids[t], center);
+				if(d <= bestDistance)
+				{
+					best = (uint32)t;
+					bestDistance = d;
+				}
+			}
+
+			if(best != NotInMeshlet)
+				bestNew = 3;
+		}
+
+		if(best == NotInMeshlet || current.VertexCount + bestNew > maxVertices || current.PrimitiveCount == maxTriangles)
+		{
+			if(current.PrimitiveCount > 0)
+				flush();
+
+			// Carry on next to the finished meshlet if possible, otherwise from the
+			// first unused triangle in input order.
+			if(best == NotInMeshlet)
+			{
+				while(seed < triangleCount && emitted[seed])
+					++seed;
+				if(seed == triangleCount)
+					break;
+				best = (uint32)seed;
+			}
+		}
+
+		uint32 local[3];
+		for(int k = 0; k < 3; ++k)
+		{
+			uint32 v = indices[3*best + k];
+			if(localIndex[v] == NotInMeshlet)
+			{
+				localIndex[v] = current.VertexCount++;
+				out.UniqueVertexIndices.push_back(v);
+			}
+			local[k] = localIndex[v];
+			out.Indices.push_back(v);
+		}
+
+		out.PrimitiveIndices.push_back(local[0] | (local[1] << 10) | (local[2] << 20));
+		emitted[best] = true;
+		++current.PrimitiveCount;
+	}
+}
+
+void MeshletBuilder::Build(const GeometryGenerator::MeshData& meshData, MeshletMesh& out,
+	uint32 maxVertices, uint32 maxTriangles)
+{
+	if(meshData.Vertices.empty())
+	{
+		Build(nullptr, 0, 0, nullptr, 0, out, maxVertices, maxTriangles);
+		return;
+	}
+
+	Build(&meshData.Vertices[0].Position, sizeof(GeometryGenerator::Vertex), meshData.Vertices.size(),
+		meshData.Indices32.data(), meshData.Indices32.size(), out, maxVertices, maxTriangles);
+}
+
+MeshletCuller::MeshletCuller(const std::vector<MeshletBounds>& bounds)
+	: mCount(bounds.size())
+{
+	size_t padded = (mCount + 7) & ~size_t(7);
+
+	mCenterX.resize(padded, 0.0f);
+	mCenterY.resize(padded, 0.0f);
+	mCenterZ.resize(padded, 0.0f);
+	mRadius.resize(padded, 0.0f);
+	mConeX.resize(padded, 0.0f);
+	mConeY.resize(padded, 0.0f);
+	mConeZ.resize(padded, 1.0f);
+	mConeCutoff.resize(padded, 1.0f);
+
+	for(size_t i = 0; i < mCount; ++i)
+	{
+		mCenterX[i] = bounds[i].Center.x;
+		mCenterY[i] = bounds[i].Center.y;
+		mCenterZ[i] = bounds[i].Center.z;
+		mRadius[i] = bounds[i].Radius;
+		mConeX[i] = bounds[i].ConeAxis.x;
+		mConeY[i] = bounds[i].ConeAxis.y;
+		mConeZ[i] = bounds[i].ConeAxis.z;
+		mConeCutoff[i] = bounds[i].ConeCutoff;
+	}
+}
+
+MeshletCuller::View MeshletCuller::MakeView(const Camera& camera, FXMMATRIX world)
+{
+	View view;
+
+	XMFLOAT4X4 m;
+	XMStoreFloat4x4(&m, XMMatrixMultiply(XMMatrixMultiply(world, camera.GetView()), camera.GetProj()));
+
+	// Gribb/Hartmann plane extraction.  Row vectors are used, so clip space x is
+	// dot(p, column 0) and so on; D3D clips z to [0, w].
+	auto column = [&m](int c) { return XMFLOAT4(m.m[0][c], m.m[1][c], m.m[2][c], m.m[3][c]); };
+	auto combine = [](const XMFLOAT4& a, const XMFLOAT4& b, float s)
+	{
+		return XMFLOAT4(a.x + s*b.x, a.y + s*b.y, a.z + s*b.z, a.w + s*b.w);
+	};
+
+	XMFLOAT4 x = column(0);
+	XMFLOAT4 y = column(1);
+	XMFLOAT4 z = column(2);
+	XMFLOAT4 w = column(3);
+
+	view.Planes[0] = combine(w, x, +1.0f); // left
+	view.Planes[1] = combine(w, x, -1.0f); // right
+	view.Planes[2] = combine(w, y, +1.0f); // bottom
+	view.Planes[3] = combine(w, y, -1.0f); // top
+	view.Planes[4] = z;                    // near
+	view.Planes[5] = combine(w, z, -1.0f); // far
+
+	for(auto& p : view.Planes)
+	{
+		float length = sqrtf(p.x*p.x + p.y*p.y + p.z*p.z);
+		p.x /= length;
+		p.y /= length;
+		p.z /= length;
+		p.w /= length;
+	}
+
+	XMVECTOR det = XMMatrixDeterminant(world);
+	XMMATRIX invWorld = XMMatrixInverse(&det, world);
+	XMStoreFloat3(&view.Eye, XMVector3TransformCoord(camera.GetPosition(), invWorld));
+
+	return view;
+}
+
+size_t MeshletCuller::Cull(const View& view, uint32* visible)const
+{
+	size_t visibleCount = 0;
+	size_t i = 0;
+
+#if defined(MESHLET_SIMD_AVX2)
+	__m256 px[6], py[6], pz[6], pw[6];
+	for(int p = 0; p < 6; ++p)
+	{
+		px[p] = _mm256_set1_ps(view.Planes[p].x);
+		py[p] = _mm256_set1_ps(view.Planes[p].y);
+		pz[p] = _mm256_set1_ps(view.Planes[p].z);
+		pw[p] = _mm256_set1_ps(view.Planes[p].w);
+	}
+	const __m256 ex = _mm256_set1_ps(view.Eye.x);
+	const __m256 ey = _mm256_set1_ps(view.Eye.y);
+	const __m256 ez = _mm256_set1_ps(view.Eye.z);
+
+	for(; i + 8 <= mCenterX.size() && i < mCount; i += 8)
+	{
+		__m256 cx = _mm256_loadu_ps(&mCenterX[i]);
+		__m256 cy = _mm256_loadu_ps(&mCenterY[i]);
+		__m256 cz = _mm256_loadu_ps(&mCenterZ[i]);
+		__m256 r = _mm256_loadu_ps(&mRadius[i]);
+		__m256 negR = _mm256_sub_ps(_mm256_setzero_ps(), r);
+
+		__m256 culled = _mm256_setzero_ps();
+		for(int p = 0; p < 6; ++p)
+		{
+			__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px[p], cx), _mm256_mul_ps(py[p], cy)),
+				_mm256_add_ps(_mm256_mul_ps(pz[p], cz), pw[p]));
+			culled = _mm256_or_ps(culled, _mm256_cmp_ps(d, negR, _CMP_LT_OQ));
+		}
+
+		__m256 dx = _mm256_sub_ps(cx, ex);
+		__m256 dy = _mm256_sub_ps(cy, ey);
+		__m256 dz = _mm256_sub_ps(cz, ez);
+		__m256 distance = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz)));
+		__m256 coneDot = _mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(dx, _mm256_loadu_ps(&mConeX[i])),
+			_mm256_mul_ps(dy, _mm256_loadu_ps(&mConeY[i]))),
+			_mm256_mul_ps(dz, _mm256_loadu_ps(&mConeZ[i])));
+		__m256 limit = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(&mConeCutoff[i]), distance), r);
+		culled = _mm256_or_ps(culled, _mm256_cmp_ps(coneDot, limit, _CMP_GE_OQ));
+
+		int mask = ~_mm256_movemask_ps(culled) & 0xff;
+		if(mCount - i < 8)
+			mask &= (1 << (mCount - i)) - 1;
+
+		while(mask != 0)
+		{
+			int lane = 0;
+			while(((mask >> lane) & 1) == 0)
+				++lane;
+			visible[visibleCount++] = (uint32)(i + lane);
+			mask &= mask - 1;
+		}
+	}
+#elif defined(MESHLET_SIMD_SSE2)
+	__m128 px[6], py[6], pz[6], pw[6];
+	for(int p = 0; p < 6; ++p)
+	{
+		px[p] = _mm_set1_ps(view.Planes[p].x);
+		py[p] = _mm_set1_ps(view.Planes[p].y);
+		pz[p] = _mm_set1_ps(view.Planes[p].z);
+		pw[p] = _mm_set1_ps(view.Planes[p].w);
+	}
+	const __m128 ex = _mm_set1_ps(view.Eye.x);
+	const __m128 ey = _mm_set1_ps(view.Eye.y);
+	const __m128 ez = _mm_set1_ps(view.Eye.z);
+
+	for(; i + 4 <= mCenterX.size() && i < mCount; i += 4)
+	{
+		__m128 cx = _mm_loadu_ps(&mCenterX[i]);
+		__m128 cy = _mm_loadu_ps(&mCenterY[i]);
+		__m128 cz = _mm_loadu_ps(&mCenterZ[i]);
+		__m128 r = _mm_loadu_ps(&mRadius[i]);
+		__m128 negR = _mm_sub_ps(_mm_setzero_ps(), r);
+
+		__m128 culled = _mm_setzero_ps();
+		for(int p = 0; p < 6; ++p)
+		{
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], cx), _mm_mul_ps(py[p], cy)),
+				_mm_add_ps(_mm_mul_ps(pz[p], cz), pw[p]));
+			culled = _mm_or_ps(culled, _mm_cmplt_ps(d, negR));
+		}
+
+		__m128 dx = _mm_sub_ps(cx, ex);
+		__m128 dy = _mm_sub_ps(cy, ey);
+		__m128 dz = _mm_sub_ps(cz, ez);
+		__m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+		__m128 coneDot = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(dx, _mm_loadu_ps(&mConeX[i])),
+			_mm_mul_ps(dy, _mm_loadu_ps(&mConeY[i]))),
+			_mm_mul_ps(dz, _mm_loadu_ps(&mConeZ[i])));
+		__m128 limit = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&mConeCutoff[i]), distance), r);
+		culled = _mm_or_ps(culled, _mm_cmpge_ps(coneDot, limit));
+
+		int mask = ~_mm_movemask_ps(culled) & 0xf;
+		if(mCount - i < 4)
+			mask &= (1 << (mCount - i)) - 1;
+
+		while(mask != 0)
+		{
+			int lane = 0;
+			while(((mask >> lane) & 1) == 0)
+				++lane;
+			visible[visibleCount++] = (uint32)(i + lane);
+			mask &= mask - 1;
+		}
+	}
+#endif
+
+	for(; i < mCount; ++i)
+	{
+		if(IsVisible(view, mCenterX[i], mCenterY[i], mCenterZ[i], mRadius[i],
+			mConeX[i], mConeY[i], mConeZ[i], mConeCutoff[i]))
+		{
+			visible[visibleCount++] = (uint32)i;
+		}
+	}
+
+	return visibleCount;
+}
+
+size_t MeshletCuller::MeshletCount()const
+{
+	return mCount;
+}
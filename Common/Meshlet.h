@@ -0,0 +1,113 @@
+//***************************************************************************************
+// Meshlet.h
+//
+// Splits an indexed triangle list into small clusters (meshlets) of at most 64
+// vertices and 124 triangles, the sizes recommended for D3D12 mesh shaders.  Every
+// meshlet gets a bounding sphere and a normal cone so whole clusters can be
+// rejected on the CPU when they are outside the frustum or facing away.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include "Camera.h"
+
+struct Meshlet
+{
+	// Range in MeshletMesh::UniqueVertexIndices.
+	std::uint32_t VertexOffset = 0;
+	std::uint32_t VertexCount = 0;
+
+	// Range in MeshletMesh::PrimitiveIndices, and in triangles of MeshletMesh::Indices.
+	std::uint32_t PrimitiveOffset = 0;
+	std::uint32_t PrimitiveCount = 0;
+};
+
+struct MeshletBounds
+{
+	DirectX::XMFLOAT3 Center = { 0.0f, 0.0f, 0.0f };
+	float Radius = 0.0f;
+
+	// Every triangle normal is within the cone around ConeAxis.  ConeCutoff is the
+	// sine of the cone's half angle, or 1 when the cone is too wide to ever cull.
+	DirectX::XMFLOAT3 ConeAxis = { 0.0f, 0.0f, 1.0f };
+	float ConeCutoff = 1.0f;
+};
+
+struct MeshletMesh
+{
+	std::vector<Meshlet> Meshlets;
+	std::vector<MeshletBounds> Bounds;
+
+	// Mesh vertex index for every meshlet-local vertex.
+	std::vector<std::uint32_t> UniqueVertexIndices;
+
+	// One entry per triangle: three meshlet-local indices packed 10:10:10, the
+	// layout the mesh shader samples read from a StructuredBuffer<uint>.
+	std::vector<std::uint32_t> PrimitiveIndices;
+
+	// The same triangles as a plain index list, meshlet after meshlet, so meshlet m
+	// covers indices [3*PrimitiveOffset, 3*(PrimitiveOffset + PrimitiveCount)).
+	// Upload this in place of the original indices to draw clusters with
+	// DrawIndexedInstanced.
+	std::vector<std::uint32_t> Indices;
+};
+
+class MeshletBuilder
+{
+public:
+	using uint32 = std::uint32_t;
+
+	static const uint32 MaxVertices = 64;
+	static const uint32 MaxTriangles = 124;
+
+	// Positions are read through a byte stride so the app's own vertex array can be
+	// passed, e.g. Build(&v[0].Pos, sizeof(Vertex), v.size(), ...).  Triangles are
+	// grown greedily from the ones that add the fewest new vertices, so the input
+	// order (ideally vertex cache optimized) only decides where each meshlet starts.
+	static void Build(const DirectX::XMFLOAT3* positions, size_t stride, size_t vertexCount,
+		const uint32* indices, size_t indexCount, MeshletMesh& out,
+		uint32 maxVertices = MaxVertices, uint32 maxTriangles = MaxTriangles);
+
+	static void Build(const GeometryGenerator::MeshData& meshData, MeshletMesh& out,
+		uint32 maxVertices = MaxVertices, uint32 maxTriangles = MaxTriangles);
+};
+
+class MeshletCuller
+{
+public:
+	using uint32 = std::uint32_t;
+
+	// The camera expressed in the mesh's local space.  Working in object space keeps
+	// the sphere and cone tests exact under non-uniform world scales.
+	struct View
+	{
+		// Inward facing, normalized: a point p is inside when dot(xyz, p) + w >= 0.
+		DirectX::XMFLOAT4 Planes[6];
+		DirectX::XMFLOAT3 Eye = { 0.0f, 0.0f, 0.0f };
+	};
+
+	explicit MeshletCuller(const std::vector<MeshletBounds>& bounds);
+
+	static View MakeView(const Camera& camera, DirectX::FXMMATRIX world);
+
+	// Writes the indices of the meshlets that are at least partly inside the frustum
+	// and not entirely back facing to visible, in increasing order, and returns how
+	// many there are.  visible must have room for MeshletCount() entries.
+	size_t Cull(const View& view, uint32* visible)const;
+
+	size_t MeshletCount()const;
+
+private:
+	size_t mCount = 0;
+
+	// Bounds in structure-of-arrays form, padded to a multiple of 8.
+	std::vector<float> mCenterX;
+	std::vector<float> mCenterY;
+	std::vector<float> mCenterZ;
+	std::vector<float> mRadius;
+	std::vector<float> mConeX;
+	std::vector<float> mConeY;
+	std::vector<float> mConeZ;
+	std::vector<float> mConeCutoff;
+};
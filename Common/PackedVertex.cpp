@@ -0,0 +1,404 @@
+//***************************************************************************************
+// PackedVertex.cpp
+//***************************************************************************************
+
+#include "PackedVertex.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define PACKEDVERTEX_SIMD_SSE2 1
+#endif
+
+#if defined(__F16C__) || defined(__AVX2__)
+	#include <immintrin.h>
+	#define PACKEDVERTEX_F16C 1
+#endif
+
+using namespace DirectX;
+
+// A dense sweep over the sphere peaks at about 6.3e-5 rad; rounded up for margin.
+const float VertexPacking::MaxNormalError = 7.5e-5f;
+
+namespace
+{
+	const float UnormMax = 65535.0f;
+	const float SnormMax = 32767.0f;
+
+	template<typename T>
+	const T* Strided(const T* base, size_t stride, size_t i)
+	{
+		return reinterpret_cast<const T*>(reinterpret_cast<const char*>(base) + i*stride);
+	}
+
+	template<typename T>
+	T* Strided(T* base, size_t stride, size_t i)
+	{
+		return reinterpret_cast<T*>(reinterpret_cast<char*>(base) + i*stride);
+	}
+
+	std::uint32_t FloatBits(float f)
+	{
+		std::uint32_t u;
+		std::memcpy(&u, &f, sizeof(u));
+		return u;
+	}
+
+	float BitsToFloat(std::uint32_t u)
+	{
+		float f;
+		std::memcpy(&f, &u, sizeof(f));
+		return f;
+	}
+
+	// The scalar paths below mirror the SIMD ones operation for operation so both
+	// produce identical bits.
+
+	std::uint16_t QuantizeUnorm(float p, float bias, float invStep)
+	{
+		float q = std::min(std::max((p - bias)*invStep, 0.0f), UnormMax);
+		return (std::uint16_t)std::lrint(q);
+	}
+
+	float DequantizeUnorm(std::uint16_t q, float bias, float step)
+	{
+		return (float)q*step + bias;
+	}
+
+	void OctahedralFold(float nx, float ny, float nz, float& x, float& y)
+	{
+		float l1 = std::fabs(nx) + std::fabs(ny) + std::fabs(nz);
+		float inv = 1.0f/std::max(l1, 1e-20f);
+		x = nx*inv;
+		y = ny*inv;
+
+		if(nz < 0.0f)
+		{
+			float fx = (1.0f - std::fabs(y))*std::copysign(1.0f, x);
+			float fy = (1.0f - std::fabs(x))*std::copysign(1.0f, y);
+			x = fx;
+			y = fy;
+		}
+	}
+
+	std::int16_t QuantizeSnorm(float v)
+	{
+		return (std::int16_t)std::lrint(std::min(std::max(v, -1.0f), 1.0f)*SnormMax);
+	}
+
+	void OctahedralUnfold(std::int16_t qx, std::int16_t qy, float& x, float& y, float& z)
+	{
+		x = std::max((float)qx/SnormMax, -1.0f);
+		y = std::max((float)qy/SnormMax, -1.0f);
+		z = 1.0f - std::fabs(x) - std::fabs(y);
+
+		float t = std::max(-z, 0.0f);
+		x -= std::copysign(t, x);
+		y -= std::copysign(t, y);
+
+		float len = std::sqrt(x*x + y*y + z*z);
+		x /= len;
+		y /= len;
+		z /= len;
+	}
+}
+
+PositionQuantization PositionQuantization::FromBounds(const XMFLOAT3& center, const XMFLOAT3& extents)
+{
+	PositionQuantization q;
+	q.Bias = XMFLOAT3(center.x - extents.x, center.y - extents.y, center.z - extents.z);
+	q.Scale = XMFLOAT3(2.0f*extents.x, 2.0f*extents.y, 2.0f*extents.z);
+	return q;
+}
+
+XMFLOAT3 PositionQuantization::MaxError()const
+{
+	// Half a step, plus a couple of float ulps for the multiply-add on decode.
+	auto axisError = [](float bias, float scale)
+	{
+		return 0.5f*scale/UnormMax + 2.0f*FLT_EPSILON*(std::fabs(bias) + scale);
+	};
+
+	return XMFLOAT3(axisError(Bias.x, Scale.x), axisError(Bias.y, Scale.y), axisError(Bias.z, Scale.z));
+}
+
+void VertexPacking::EncodeOctahedral(const XMFLOAT3& n, std::int16_t out[2])
+{
+	float x, y;
+	OctahedralFold(n.x, n.y, n.z, x, y);
+	out[0] = QuantizeSnorm(x);
+	out[1] = QuantizeSnorm(y);
+}
+
+XMFLOAT3 VertexPacking::DecodeOctahedral(const std::int16_t in[2])
+{
+	XMFLOAT3 n;
+	OctahedralUnfold(in[0], in[1], n.x, n.y, n.z);
+	return n;
+}
+
+std::uint16_t VertexPacking::FloatToHalf(float value)
+{
+	std::uint32_t f = FloatBits(value);
+	std::uint32_t sign = f & 0x80000000u;
+	f ^= sign;
+
+	std::uint32_t h;
+	if(f >= 0x47800000u)
+	{
+		// Too large for a half: infinity, or a quiet NaN.
+		h = f > 0x7F800000u ? 0x7E00u : 0x7C00u;
+	}
+	else if(f < 0x38800000u)
+	{
+		// Subnormal or zero.  Adding 0.5 lines the ten mantissa bits up at the
+		// bottom of the float and lets the FPU do the rounding.
+		h = FloatBits(BitsToFloat(f) + 0.5f) - 0x3F000000u;
+	}
+	else
+	{
+		// Rebias the exponent (127 - 15 = 112, i.e. 0x38000000 in the exponent field)
+		// and round to nearest even on the dropped bits.
+		std::uint32_t mantissaOdd = (f >> 13) & 1u;
+		f = f - 0x38000000u + 0xFFFu + mantissaOdd;
+		h = f >> 13;
+	}
+
+	return (std::uint16_t)(h | (sign >> 16));
+}
+
+float VertexPacking::HalfToFloat(std::uint16_t value)
+{
+	std::uint32_t sign = (std::uint32_t)(value & 0x8000u) << 16;
+	std::uint32_t exponent = (value >> 10) & 0x1Fu;
+	std::uint32_t mantissa = value & 0x3FFu;
+
+	if(exponent == 0)
+	{
+		float f = std::ldexp((float)mantissa, -24);
+		return sign ? -f : f;
+	}
+
+	if(exponent == 31)
+		return BitsToFloat(sign | 0x7F800000u | (mantissa << 13));
+
+	return BitsToFloat(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+void VertexPacking::Encode(
+	const XMFLOAT3* positions,
+	const XMFLOAT3* normals,
+	const XMFLOAT2* texCoords,
+	size_t stride, size_t count,
+	const PositionQuantization& quantization,
+	PackedVertex* out)
+{
+	const XMFLOAT3& bias = quantization.Bias;
+	const XMFLOAT3& scale = quantization.Scale;
+
+	// A flat axis (zero extent) quantizes everything to 0.
+	XMFLOAT3 invStep(
+		scale.x > 0.0f ? UnormMax/scale.x : 0.0f,
+		scale.y > 0.0f ? UnormMax/scale.y : 0.0f,
+		scale.z > 0.0f ? UnormMax/scale.z : 0.0f);
+
+	size_t i = 0;
+
+#if defined(PACKEDVERTEX_SIMD_SSE2)
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 minusOne = _mm_set1_ps(-1.0f);
+	const __m128 unormMax = _mm_set1_ps(UnormMax);
+	const __m128 snormMax = _mm_set1_ps(SnormMax);
+	const __m128 tiny = _mm_set1_ps(1e-20f);
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+
+	// Four vertices at a time in SoA form.
+	for(; i + 4 <= count; i += 4)
+	{
+		const XMFLOAT3* p[4] = {
+			Strided(positions, stride, i), Strided(positions, stride, i+1),
+			Strided(positions, stride, i+2), Strided(positions, stride, i+3) };
+		const XMFLOAT3* n[4] = {
+			Strided(normals, stride, i), Strided(normals, stride, i+1),
+			Strided(normals, stride, i+2), Strided(normals, stride, i+3) };
+		const XMFLOAT2* t[4] = {
+			Strided(texCoords, stride, i), Strided(texCoords, stride, i+1),
+			Strided(texCoords, stride, i+2), Strided(texCoords, stride, i+3) };
+
+		//
+		// Positions.
+		//
+
+		__m128 px = _mm_setr_ps(p[0]->x, p[1]->x, p[2]->x, p[3]->x);
+		__m128 py = _mm_setr_ps(p[0]->y, p[1]->y, p[2]->y, p[3]->y);
+		__m128 pz = _mm_setr_ps(p[0]->z, p[1]->z, p[2]->z, p[3]->z);
+
+		px = _mm_mul_ps(_mm_sub_ps(px, _mm_set1_ps(bias.x)), _mm_set1_ps(invStep.x));
+		py = _mm_mul_ps(_mm_sub_ps(py, _mm_set1_ps(bias.y)), _mm_set1_ps(invStep.y));
+		pz = _mm_mul_ps(_mm_sub_ps(pz, _mm_set1_ps(bias.z)), _mm_set1_ps(invStep.z));
+
+		alignas(16) std::int32_t qx[4], qy[4], qz[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(qx), _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(px, zero), unormMax)));
+		_mm_store_si128(reinterpret_cast<__m128i*>(qy), _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(py, zero), unormMax)));
+		_mm_store_si128(reinterpret_cast<__m128i*>(qz), _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(pz, zero), unormMax)));
+
+		//
+		// Normals: project onto the octahedron and fold the lower half over.
+		//
+
+		__m128 nx = _mm_setr_ps(n[0]->x, n[1]->x, n[2]->x, n[3]->x);
+		__m128 ny = _mm_setr_ps(n[0]->y, n[1]->y, n[2]->y, n[3]->y);
+		__m128 nz = _mm_setr_ps(n[0]->z, n[1]->z, n[2]->z, n[3]->z);
+
+		__m128 l1 = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, nx), _mm_andnot_ps(signMask, ny)), _mm_andnot_ps(signMask, nz));
+		__m128 inv = _mm_div_ps(one, _mm_max_ps(l1, tiny));
+		__m128 ox = _mm_mul_ps(nx, inv);
+		__m128 oy = _mm_mul_ps(ny, inv);
+
+		__m128 fx = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, oy)), _mm_or_ps(one, _mm_and_ps(ox, signMask)));
+		__m128 fy = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, ox)), _mm_or_ps(one, _mm_and_ps(oy, signMask)));
+
+		__m128 lower = _mm_cmplt_ps(nz, zero);
+		ox = _mm_or_ps(_mm_and_ps(lower, fx), _mm_andnot_ps(lower, ox));
+		oy = _mm_or_ps(_mm_and_ps(lower, fy), _mm_andnot_ps(lower, oy));
+
+		alignas(16) std::int32_t ex[4], ey[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(ex), _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(ox, minusOne), one), snormMax)));
+		_mm_store_si128(reinterpret_cast<__m128i*>(ey), _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(oy, minusOne), one), snormMax)));
+
+		//
+		// Texture coordinates.
+		//
+
+		alignas(16) std::uint16_t uv[8];
+#if defined(PACKEDVERTEX_F16C)
+		__m128i h0 = _mm_cvtps_ph(_mm_setr_ps(t[0]->x, t[0]->y, t[1]->x, t[1]->y), _MM_FROUND_TO_NEAREST_INT);
+		__m128i h1 = _mm_cvtps_ph(_mm_setr_ps(t[2]->x, t[2]->y, t[3]->x, t[3]->y), _MM_FROUND_TO_NEAREST_INT);
+		_mm_store_si128(reinterpret_cast<__m128i*>(uv), _mm_unpacklo_epi64(h0, h1));
+#else
+		for(int k = 0; k < 4; ++k)
+		{
+			uv[k*2+0] = FloatToHalf(t[k]->x);
+			uv[k*2+1] = FloatToHalf(t[k]->y);
+		}
+#endif
+
+		for(int k = 0; k < 4; ++k)
+		{
+			PackedVertex& v = out[i+k];
+			v.Pos[0] = (std::uint16_t)qx[k];
+			v.Pos[1] = (std::uint16_t)qy[k];
+			v.Pos[2] = (std::uint16_t)qz[k];
+			v.Pos[3] = 0;
+			v.Normal[0] = (std::int16_t)ex[k];
+			v.Normal[1] = (std::int16_t)ey[k];
+			v.TexC[0] = uv[k*2+0];
+			v.TexC[1] = uv[k*2+1];
+		}
+	}
+#endif
+
+	for(; i < count; ++i)
+	{
+		const XMFLOAT3& p = *Strided(positions, stride, i);
+		const XMFLOAT2& t = *Strided(texCoords, stride, i);
+
+		PackedVertex& v = out[i];
+		v.Pos[0] = QuantizeUnorm(p.x, bias.x, invStep.x);
+		v.Pos[1] = QuantizeUnorm(p.y, bias.y, invStep.y);
+		v.Pos[2] = QuantizeUnorm(p.z, bias.z, invStep.z);
+		v.Pos[3] = 0;
+		EncodeOctahedral(*Strided(normals, stride, i), v.Normal);
+		v.TexC[0] = FloatToHalf(t.x);
+		v.TexC[1] = FloatToHalf(t.y);
+	}
+}
+
+void VertexPacking::Decode(
+	const PackedVertex* in, size_t count,
+	const PositionQuantization& quantization,
+	XMFLOAT3* positions,
+	XMFLOAT3* normals,
+	XMFLOAT2* texCoords,
+	size_t stride)
+{
+	const XMFLOAT3& bias = quantization.Bias;
+	XMFLOAT3 step(quantization.Scale.x/UnormMax, quantization.Scale.y/UnormMax, quantization.Scale.z/UnormMax);
+
+	size_t i = 0;
+
+#if defined(PACKEDVERTEX_SIMD_SSE2)
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 minusOne = _mm_set1_ps(-1.0f);
+	const __m128 snormMax = _mm_set1_ps(SnormMax);
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+
+	for(; i + 4 <= count; i += 4)
+	{
+		const PackedVertex* v = in + i;
+
+		__m128 px = _mm_setr_ps(v[0].Pos[0], v[1].Pos[0], v[2].Pos[0], v[3].Pos[0]);
+		__m128 py = _mm_setr_ps(v[0].Pos[1], v[1].Pos[1], v[2].Pos[1], v[3].Pos[1]);
+		__m128 pz = _mm_setr_ps(v[0].Pos[2], v[1].Pos[2], v[2].Pos[2], v[3].Pos[2]);
+
+		alignas(16) float x[4], y[4], z[4];
+		_mm_store_ps(x, _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(step.x)), _mm_set1_ps(bias.x)));
+		_mm_store_ps(y, _mm_add_ps(_mm_mul_ps(py, _mm_set1_ps(step.y)), _mm_set1_ps(bias.y)));
+		_mm_store_ps(z, _mm_add_ps(_mm_mul_ps(pz, _mm_set1_ps(step.z)), _mm_set1_ps(bias.z)));
+
+		for(int k = 0; k < 4; ++k)
+			*Strided(positions, stride, i+k) = XMFLOAT3(x[k], y[k], z[k]);
+
+		// Unfold the octahedron and renormalize.
+		__m128 ox = _mm_setr_ps(v[0].Normal[0], v[1].Normal[0], v[2].Normal[0], v[3].Normal[0]);
+		__m128 oy = _mm_setr_ps(v[0].Normal[1], v[1].Normal[1], v[2].Normal[1], v[3].Normal[1]);
+		ox = _mm_max_ps(_mm_div_ps(ox, snormMax), minusOne);
+		oy = _mm_max_ps(_mm_div_ps(oy, snormMax), minusOne);
+
+		__m128 oz = _mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, ox)), _mm_andnot_ps(signMask, oy));
+		__m128 t = _mm_max_ps(_mm_sub_ps(zero, oz), zero);
+		ox = _mm_sub_ps(ox, _mm_or_ps(t, _mm_and_ps(ox, signMask)));
+		oy = _mm_sub_ps(oy, _mm_or_ps(t, _mm_and_ps(oy, signMask)));
+
+		__m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, ox), _mm_mul_ps(oy, oy)), _mm_mul_ps(oz, oz)));
+		_mm_store_ps(x, _mm_div_ps(ox, len));
+		_mm_store_ps(y, _mm_div_ps(oy, len));
+		_mm_store_ps(z, _mm_div_ps(oz, len));
+
+		for(int k = 0; k < 4; ++k)
+			*Strided(normals, stride, i+k) = XMFLOAT3(x[k], y[k], z[k]);
+
+#if defined(PACKEDVERTEX_F16C)
+		alignas(16) float uv[8];
+		__m128i h = _mm_setr_epi16(
+			(short)v[0].TexC[0], (short)v[0].TexC[1], (short)v[1].TexC[0], (short)v[1].TexC[1],
+			(short)v[2].TexC[0], (short)v[2].TexC[1], (short)v[3].TexC[0], (short)v[3].TexC[1]);
+		_mm_store_ps(uv, _mm_cvtph_ps(h));
+		_mm_store_ps(uv + 4, _mm_cvtph_ps(_mm_unpackhi_epi64(h, h)));
+
+		for(int k = 0; k < 4; ++k)
+			*Strided(texCoords, stride, i+k) = XMFLOAT2(uv[k*2+0], uv[k*2+1]);
+#else
+		for(int k = 0; k < 4; ++k)
+			*Strided(texCoords, stride, i+k) = XMFLOAT2(HalfToFloat(v[k].TexC[0]), HalfToFloat(v[k].TexC[1]));
+#endif
+	}
+#endif
+
+	for(; i < count; ++i)
+	{
+		const PackedVertex& v = in[i];
+
+		*Strided(positions, stride, i) = XMFLOAT3(
+			DequantizeUnorm(v.Pos[0], bias.x, step.x),
+			DequantizeUnorm(v.Pos[1], bias.y, step.y),
+			DequantizeUnorm(v.Pos[2], bias.z, step.z));
+		*Strided(normals, stride, i) = DecodeOctahedral(v.Normal);
+		*Strided(texCoords, stride, i) = XMFLOAT2(HalfToFloat(v.TexC[0]), HalfToFloat(v.TexC[1]));
+	}
+}
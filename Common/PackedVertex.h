@@ -0,0 +1,72 @@
+//***************************************************************************************
+// PackedVertex.h
+//
+// Compact 16 byte vertex for static geometry, plus SIMD routines to convert to and
+// from full float attributes.  Positions are stored as UNORM16 inside the mesh
+// bounds, normals as octahedral SNORM16 and texture coordinates as half floats.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <DirectXMath.h>
+
+struct PackedVertex
+{
+	std::uint16_t Pos[4];   // DXGI_FORMAT_R16G16B16A16_UNORM, w is always 0
+	std::int16_t Normal[2]; // DXGI_FORMAT_R16G16_SNORM, octahedral
+	std::uint16_t TexC[2];  // DXGI_FORMAT_R16G16_FLOAT
+};
+
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex is meant to be 16 bytes.");
+
+// Maps a box onto the [0,1] range stored in PackedVertex::Pos.  The shader gets the
+// position back with Pos*Scale + Bias.
+struct PositionQuantization
+{
+	DirectX::XMFLOAT3 Bias = { 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT3 Scale = { 1.0f, 1.0f, 1.0f };
+
+	// Takes the same Center/Extents pair as DirectX::BoundingBox.
+	static PositionQuantization FromBounds(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents);
+
+	// Largest distance a decoded position can be from the original along each
+	// axis: half of one quantization step plus float rounding.
+	DirectX::XMFLOAT3 MaxError()const;
+};
+
+class VertexPacking
+{
+public:
+	// Attributes are read through byte strides so any vertex struct with float3
+	// position/normal and float2 texture coordinates can be fed in directly, e.g.
+	// Encode(&v[0].Pos, &v[0].Normal, &v[0].TexC, sizeof(Vertex), ...).
+	static void Encode(
+		const DirectX::XMFLOAT3* positions,
+		const DirectX::XMFLOAT3* normals,
+		const DirectX::XMFLOAT2* texCoords,
+		size_t stride, size_t count,
+		const PositionQuantization& quantization,
+		PackedVertex* out);
+
+	static void Decode(
+		const PackedVertex* in, size_t count,
+		const PositionQuantization& quantization,
+		DirectX::XMFLOAT3* positions,
+		DirectX::XMFLOAT3* normals,
+		DirectX::XMFLOAT2* texCoords,
+		size_t stride);
+
+	// Octahedral mapping of a unit vector onto two SNORM16 values.  Also suitable
+	// for tangents if a mesh needs them.
+	static void EncodeOctahedral(const DirectX::XMFLOAT3& n, std::int16_t out[2]);
+	static DirectX::XMFLOAT3 DecodeOctahedral(const std::int16_t in[2]);
+
+	// IEEE half conversion with round-to-nearest-even.
+	static std::uint16_t FloatToHalf(float value);
+	static float HalfToFloat(std::uint16_t value);
+
+	// Worst case angle between a unit normal and its decoded octahedral SNORM16
+	// form, in radians.
+	static const float MaxNormalError;
+};
@@ -0,0 +1,220 @@
+//***************************************************************************************
+// SceneStore.cpp
+//***************************************************************************************
+
+#include "SceneStore.h"
+#include <cassert>
+
+using namespace DirectX;
+
+namespace
+{
+	BoundingBox TransformBounds(const BoundingBox& local, const XMFLOAT4X4& world)
+	{
+		BoundingBox result;
+		local.Transform(result, XMLoadFloat4x4(&world));
+		return result;
+	}
+}
+
+SceneStore::SceneStore(int frameResourceCount)
+	: mFrameResourceCount(frameResourceCount)
+{
+}
+
+SceneStore::Handle SceneStore::Add(const Desc& desc)
+{
+	uint32 slot;
+	if(!mFreeSlots.empty())
+	{
+		slot = mFreeSlots.back();
+		mFreeSlots.pop_back();
+	}
+	else
+	{
+		slot = (uint32)mSlots.size();
+		mSlots.push_back(Slot());
+	}
+
+	mSlots[slot].Dense = (uint32)mWorlds.size();
+
+	mWorlds.push_back(desc.World);
+	mTexTransforms.push_back(desc.TexTransform);
+	mLocalBounds.push_back(desc.LocalBounds);
+	mWorldBounds.push_back(TransformBounds(desc.LocalBounds, desc.World));
+	mFramesDirty.push_back(mFrameResourceCount);
+	mObjCBIndices.push_back(desc.ObjCBIndex);
+	mMaterials.push_back(desc.Mat);
+	mGeometries.push_back(desc.Geo);
+	mLayers.push_back(desc.Layers);
+	mSlotOfDense.push_back(slot);
+	mNames.push_back(desc.Name);
+
+	Handle handle;
+	handle.Slot = slot;
+	handle.Generation = mSlots[slot].Generation;
+	return handle;
+}
+
+void SceneStore::Remove(Handle handle)
+{
+	uint32 dense = DenseIndex(handle);
+	uint32 last = (uint32)mWorlds.size() - 1;
+
+	if(dense != last)
+	{
+		mWorlds[dense] = mWorlds[last];
+		mTexTransforms[dense] = mTexTransforms[last];
+		mLocalBounds[dense] = mLocalBounds[last];
+		mWorldBounds[dense] = mWorldBounds[last];
+		mFramesDirty[dense] = mFramesDirty[last];
+		mObjCBIndices[dense] = mObjCBIndices[last];
+		mMaterials[dense] = mMaterials[last];
+		mGeometries[dense] = mGeometries[last];
+		mLayers[dense] = mLayers[last];
+		mSlotOfDense[dense] = mSlotOfDense[last];
+		mNames[dense] = std::move(mNames[last]);
+
+		mSlots[mSlotOfDense[dense]].Dense = dense;
+	}
+
+	mWorlds.pop_back();
+	mTexTransforms.pop_back();
+	mLocalBounds.pop_back();
+	mWorldBounds.pop_back();
+	mFramesDirty.pop_back();
+	mObjCBIndices.pop_back();
+	mMaterials.pop_back();
+	mGeometries.pop_back();
+	mLayers.pop_back();
+	mSlotOfDense.pop_back();
+	mNames.pop_back();
+
+	Slot& slot = mSlots[handle.Slot];
+	slot.Dense = UINT32_MAX;
+	slot.Generation++;
+	mFreeSlots.push_back(handle.Slot);
+}
+
+bool SceneStore::IsAlive(Handle handle)const
+{
+	return handle.Slot < mSlots.size() &&
+		mSlots[handle.Slot].Generation == handle.Generation &&
+		mSlots[handle.Slot].Dense != UINT32_MAX;
+}
+
+size_t SceneStore::Size()const
+{
+	return mWorlds.size();
+}
+
+SceneStore::uint32 SceneStore::DenseIndex(Handle handle)const
+{
+	assert(IsAlive(handle));
+	return mSlots[handle.Slot].Dense;
+}
+
+SceneStore::Handle SceneStore::HandleAt(uint32 denseIndex)const
+{
+	Handle handle;
+	handle.Slot = mSlotOfDense[denseIndex];
+	handle.Generation = mSlots[handle.Slot].Generation;
+	return handle;
+}
+
+void SceneStore::SetWorld(Handle handle, const XMFLOAT4X4& world)
+{
+	uint32 i = DenseIndex(handle);
+	mWorlds[i] = world;
+	mWorldBounds[i] = TransformBounds(mLocalBounds[i], world);
+	mFramesDirty[i] = mFrameResourceCount;
+}
+
+void SceneStore::SetTexTransform(Handle handle, const XMFLOAT4X4& texTransform)
+{
+	uint32 i = DenseIndex(handle);
+	mTexTransforms[i] = texTransform;
+	mFramesDirty[i] = mFrameResourceCount;
+}
+
+void SceneStore::SetLocalBounds(Handle handle, const BoundingBox& bounds)
+{
+	uint32 i = DenseIndex(handle);
+	mLocalBounds[i] = bounds;
+	mWorldBounds[i] = TransformBounds(bounds, mWorlds[i]);
+}
+
+void SceneStore::SetMaterial(Handle handle, Material* mat)
+{
+	mMaterials[DenseIndex(handle)] = mat;
+}
+
+const XMFLOAT4X4& SceneStore::GetWorld(Handle handle)const
+{
+	return mWorlds[DenseIndex(handle)];
+}
+
+const BoundingBox& SceneStore::GetLocalBounds(Handle handle)const
+{
+	return mLocalBounds[DenseIndex(handle)];
+}
+
+const BoundingBox& SceneStore::GetWorldBounds(Handle handle)const
+{
+	return mWorldBounds[DenseIndex(handle)];
+}
+
+SceneStore::uint32 SceneStore::GetObjCBIndex(Handle handle)const
+{
+	return mObjCBIndices[DenseIndex(handle)];
+}
+
+Material* SceneStore::GetMaterial(Handle handle)const
+{
+	return mMaterials[DenseIndex(handle)];
+}
+
+MeshGeometry* SceneStore::GetGeometry(Handle handle)const
+{
+	return mGeometries[DenseIndex(handle)];
+}
+
+const std::string& SceneStore::GetName(Handle handle)const
+{
+	return mNames[DenseIndex(handle)];
+}
+
+const XMFLOAT4X4* SceneStore::GetWorlds()const
+{
+	return mWorlds.data();
+}
+
+const XMFLOAT4X4* SceneStore::GetTexTransforms()const
+{
+	return mTexTransforms.data();
+}
+
+const BoundingBox* SceneStore::GetLocalBounds()const
+{
+	return mLocalBounds.data();
+}
+
+const BoundingBox* SceneStore::GetWorldBounds()const
+{
+	return mWorldBounds.data();
+}
+
+const SceneStore::uint32* SceneStore::GetObjCBIndices()const
+{
+	return mObjCBIndices.data();
+}
+
+const SceneStore::uint32* SceneStore::GetLayers()const
+{
+	return mLayers.data();
+}
+
+int* SceneStore::GetFramesDirty()
+{
+	return mFramesDirty.data();
+}
@@ -0,0 +1,120 @@
+//***************************************************************************************
+// SceneStore.h
+//
+// Per-object scene data kept as parallel arrays (structure of arrays) instead of one
+// heap allocation per object.  The data every frame touches -- world and texture
+// transforms, bounds, dirty counts, constant buffer slots, materials, geometry and
+// layer masks -- is packed densely so whole-scene passes stream through memory;
+// names are only read for debugging and live in their own array.
+//
+// Objects are addressed by handles that stay valid while other objects are added
+// and removed.  Removing an object moves the last one into its place, so dense
+// indices are only stable until the next Remove.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <DirectXCollision.h>
+#include "MathHelper.h"
+
+// Only stored as pointers, so the store builds without the D3D headers.
+struct Material;
+struct MeshGeometry;
+
+class SceneStore
+{
+public:
+	using uint32 = std::uint32_t;
+
+	// Objects start out dirty for this many frame resources.
+	explicit SceneStore(int frameResourceCount);
+
+	struct Handle
+	{
+		uint32 Slot = UINT32_MAX;
+		uint32 Generation = 0;
+
+		bool IsValid()const { return Slot != UINT32_MAX; }
+	};
+
+	// Everything needed to add an object; the world bounds are derived from the
+	// local ones.
+	struct Desc
+	{
+		std::string Name;
+		DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
+		DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
+		DirectX::BoundingBox LocalBounds;
+		uint32 ObjCBIndex = 0;
+		Material* Mat = nullptr;
+		MeshGeometry* Geo = nullptr;
+
+		// Bit per render layer (or any grouping the app likes).
+		uint32 Layers = 0;
+	};
+
+	Handle Add(const Desc& desc);
+	void Remove(Handle handle);
+	bool IsAlive(Handle handle)const;
+
+	// Number of live objects; dense indices run over [0, Size()).
+	size_t Size()const;
+	uint32 DenseIndex(Handle handle)const;
+	Handle HandleAt(uint32 denseIndex)const;
+
+	// Marks the object's constants dirty for every frame resource and refreshes its
+	// world bounds.
+	void SetWorld(Handle handle, const DirectX::XMFLOAT4X4& world);
+	void SetTexTransform(Handle handle, const DirectX::XMFLOAT4X4& texTransform);
+	void SetLocalBounds(Handle handle, const DirectX::BoundingBox& bounds);
+	void SetMaterial(Handle handle, Material* mat);
+
+	const DirectX::XMFLOAT4X4& GetWorld(Handle handle)const;
+	const DirectX::BoundingBox& GetLocalBounds(Handle handle)const;
+	const DirectX::BoundingBox& GetWorldBounds(Handle handle)const;
+	uint32 GetObjCBIndex(Handle handle)const;
+	Material* GetMaterial(Handle handle)const;
+	MeshGeometry* GetGeometry(Handle handle)const;
+	const std::string& GetName(Handle handle)const;
+
+	// Dense arrays for whole-scene passes, Size() entries each.  FramesDirty counts
+	// the frame resources whose object constants are still stale; passes that
+	// write the constants decrement it.
+	const DirectX::XMFLOAT4X4* GetWorlds()const;
+	const DirectX::XMFLOAT4X4* GetTexTransforms()const;
+	const DirectX::BoundingBox* GetLocalBounds()const;
+	const DirectX::BoundingBox* GetWorldBounds()const;
+	const uint32* GetObjCBIndices()const;
+	const uint32* GetLayers()const;
+	int* GetFramesDirty();
+
+private:
+	// Dense arrays.
+	std::vector<DirectX::XMFLOAT4X4> mWorlds;
+	std::vector<DirectX::XMFLOAT4X4> mTexTransforms;
+	std::vector<DirectX::BoundingBox> mLocalBounds;
+	std::vector<DirectX::BoundingBox> mWorldBounds;
+	std::vector<int> mFramesDirty;
+	std::vector<uint32> mObjCBIndices;
+	std::vector<Material*> mMaterials;
+	std::vector<MeshGeometry*> mGeometries;
+	std::vector<uint32> mLayers;
+	std::vector<uint32> mSlotOfDense;
+
+	// Cold data, also dense.
+	std::vector<std::string> mNames;
+
+	// Slot -> dense index, with a generation per slot so stale handles are caught.
+	struct Slot
+	{
+		uint32 Dense = UINT32_MAX;
+		uint32 Generation = 0;
+	};
+	std::vector<Slot> mSlots;
+	std::vector<uint32> mFreeSlots;
+
+	int mFrameResourceCount = 1;
+};
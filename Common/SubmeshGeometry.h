@@ -0,0 +1,30 @@
+//***************************************************************************************
+// SubmeshGeometry.h
+//
+// The draw range of one shape inside a shared vertex/index buffer.  Kept apart from
+// d3dUtil.h so code that only fills in draw ranges builds without Windows headers.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <DirectXCollision.h>
+
+// Defines a subrange of geometry in a MeshGeometry.  This is for when multiple
+// geometries are stored in one vertex and index buffer.  It provides the offsets
+// and data needed to draw a subset of geometry stores in the vertex and index 
+// buffers so that we can implement the technique described by Figure 6.3.
+struct SubmeshGeometry
+{
+	std::uint32_t IndexCount = 0;
+	std::uint32_t StartIndexLocation = 0;
+	std::int32_t BaseVertexLocation = 0;
+
+	// Bounding box of the geometry defined by this submesh. 
+	// This is used in later chapters of the book.
+	DirectX::BoundingBox Bounds;
+
+	// For simplified LOD ranges: geometric error relative to the bounding radius
+	// of the full-detail mesh.  Zero for full-detail submeshes.
+	float LodError = 0.0f;
+};
@@ -0,0 +1,181 @@
+//***************************************************************************************
+// TerrainQuadtree.cpp
+//***************************************************************************************
+
+#include "TerrainQuadtree.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	float DistanceSqToBox(const XMFLOAT3& p, const XMFLOAT3& boxMin, const XMFLOAT3& boxMax)
+	{
+		float dx = std::max(std::max(boxMin.x - p.x, p.x - boxMax.x), 0.0f);
+		float dy = std::max(std::max(boxMin.y - p.y, p.y - boxMax.y), 0.0f);
+		float dz = std::max(std::max(boxMin.z - p.z, p.z - boxMax.z), 0.0f);
+		return dx*dx + dy*dy + dz*dz;
+	}
+}
+
+TerrainQuadtree::TerrainQuadtree(const Settings& settings, const float* heights, uint32 rows, uint32 columns)
+	: mSettings(settings)
+{
+	assert(settings.LodCount >= 1 && settings.LodCount <= 16);
+	assert(settings.PatchResolution >= 2 && (settings.PatchResolution & (settings.PatchResolution - 1)) == 0);
+	assert(rows >= 2 && columns >= 2);
+
+	const uint32 lodCount = settings.LodCount;
+
+	float previous = 0.0f;
+	float range = settings.FinestLodDistance;
+	for(uint32 level = 0; level < lodCount; ++level)
+	{
+		mRanges.push_back(range);
+		mMorphStarts.push_back(previous + (range - previous)*settings.MorphStartRatio);
+		previous = range;
+		range *= settings.LodDistanceRatio;
+	}
+
+	// Leaf height ranges from the samples under each leaf, edges included since
+	// the surface is interpolated between samples.
+	const uint32 leaves = 1u << (lodCount - 1);
+	mHeightRanges.resize(lodCount);
+	mHeightRanges[0].resize(leaves*leaves);
+	for(uint32 z = 0; z < leaves; ++z)
+	{
+		uint32 r0 = (uint32)floorf((float)z / leaves*(rows - 1));
+		uint32 r1 = std::min((uint32)ceilf((float)(z + 1) / leaves*(rows - 1)), rows - 1);
+		for(uint32 x = 0; x < leaves; ++x)
+		{
+			uint32 c0 = (uint32)floorf((float)x / leaves*(columns - 1));
+			uint32 c1 = std::min((uint32)ceilf((float)(x + 1) / leaves*(columns - 1)), columns - 1);
+
+			XMFLOAT2 range(+FLT_MAX, -FLT_MAX);
+			for(uint32 r = r0; r <= r1; ++r)
+			{
+				for(uint32 c = c0; c <= c1; ++c)
+				{
+					float h = heights[r*columns + c];
+					range.x = std::min(range.x, h);
+					range.y = std::max(range.y, h);
+				}
+			}
+			mHeightRanges[0][z*leaves + x] = range;
+		}
+	}
+
+	for(uint32 level = 1; level < lodCount; ++level)
+	{
+		const uint32 count = leaves >> level;
+		const auto& children = mHeightRanges[level - 1];
+		mHeightRanges[level].resize(count*count);
+		for(uint32 z = 0; z < count; ++z)
+		{
+			for(uint32 x = 0; x < count; ++x)
+			{
+				XMFLOAT2 range(+FLT_MAX, -FLT_MAX);
+				for(uint32 q = 0; q < 4; ++q)
+				{
+					const XMFLOAT2& child = children[(2*z + (q >> 1))*(2*count) + 2*x + (q & 1)];
+					range.x = std::min(range.x, child.x);
+					range.y = std::max(range.y, child.y);
+				}
+				mHeightRanges[level][z*count + x] = range;
+			}
+		}
+	}
+}
+
+size_t TerrainQuadtree::Select(const XMFLOAT3& eye, const XMFLOAT4 planes[6], std::vector<Node>& out)const
+{
+	out.clear();
+	SelectNode(mSettings.LodCount - 1, 0, 0, false, eye, planes, out);
+	return out.size();
+}
+
+TerrainQuadtree::Visit TerrainQuadtree::SelectNode(uint32 level, uint32 x, uint32 z, bool inside,
+	const XMFLOAT3& eye, const XMFLOAT4 planes[6], std::vector<Node>& out)const
+{
+	const uint32 count = 1u << (mSettings.LodCount - 1 - level);
+	const float size = NodeSize(level);
+	const XMFLOAT2& heights = mHeightRanges[level][z*count + x];
+
+	XMFLOAT3 boxMin(mSettings.Origin.x + x*size, heights.x, mSettings.Origin.y + z*size);
+	XMFLOAT3 boxMax(boxMin.x + size, heights.y, boxMin.z + size);
+
+	// Outside this level's range: the parent covers the area at its own level.
+	if(DistanceSqToBox(eye, boxMin, boxMax) > mRanges[level]*mRanges[level])
+		return Visit::OutOfRange;
+
+	// Once a node is entirely inside the frustum its children are too.
+	if(!inside)
+	{
+		inside = true;
+		for(int i = 0; i < 6; ++i)
+		{
+			const XMFLOAT4& p = planes[i];
+			float farthest = p.x*(p.x > 0.0f ? boxMax.x : boxMin.x) + p.y*(p.y > 0.0f ? boxMax.y : boxMin.y) +
+				p.z*(p.z > 0.0f ? boxMax.z : boxMin.z) + p.w;
+			if(farthest < 0.0f)
+				return Visit::OutOfFrustum;
+
+			float nearest = p.x*(p.x > 0.0f ? boxMin.x : boxMax.x) + p.y*(p.y > 0.0f ? boxMin.y : boxMax.y) +
+				p.z*(p.z > 0.0f ? boxMin.z : boxMax.z) + p.w;
+			if(nearest < 0.0f)
+				inside = false;
+		}
+	}
+
+	Node node;
+	node.X = boxMin.x;
+	node.Z = boxMin.z;
+	node.Size = size;
+	node.MinY = heights.x;
+	node.MaxY = heights.y;
+	node.Level = level;
+
+	// Leaves, and nodes the camera is too far from to need the next level, are
+	// drawn whole.
+	if(level == 0 || DistanceSqToBox(eye, boxMin, boxMax) > mRanges[level - 1]*mRanges[level - 1])
+	{
+		out.push_back(node);
+		return Visit::Selected;
+	}
+
+	// Quadrants whose child is out of the child's range are drawn at this level.
+	node.QuadrantMask = 0;
+	for(uint32 q = 0; q < 4; ++q)
+	{
+		if(SelectNode(level - 1, 2*x + (q & 1), 2*z + (q >> 1), inside, eye, planes, out) == Visit::OutOfRange)
+			node.QuadrantMask |= 1u << q;
+	}
+
+	if(node.QuadrantMask != 0)
+		out.push_back(node);
+
+	return Visit::Selected;
+}
+
+float TerrainQuadtree::MorphStart(uint32 level)const
+{
+	return mMorphStarts[level];
+}
+
+float TerrainQuadtree::MorphEnd(uint32 level)const
+{
+	return mRanges[level];
+}
+
+float TerrainQuadtree::NodeSize(uint32 level)const
+{
+	return mSettings.Size / (float)(1u << (mSettings.LodCount - 1 - level));
+}
+
+const TerrainQuadtree::Settings& TerrainQuadtree::GetSettings()const
+{
+	return mSettings;
+}
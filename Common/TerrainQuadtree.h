@@ -0,0 +1,103 @@
+//***************************************************************************************
+// TerrainQuadtree.h
+//
+// Continuous distance-dependent LOD (CDLOD) node selection for a square heightmap
+// terrain.  Every quadtree node is drawn with the same grid patch, scaled to the
+// node's size; each level has a distance range, and a node is split when the camera
+// is inside the range of the level below.  Vertices morph towards the next coarser
+// grid over the last part of a level's range, so there are no seams or pops.
+//
+// Selection only needs DirectXMath, so it can be run and timed without a device.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+class TerrainQuadtree
+{
+public:
+	using uint32 = std::uint32_t;
+
+	struct Settings
+	{
+		// The terrain covers [Origin.x, Origin.x + Size] in world x and
+		// [Origin.y, Origin.y + Size] in world z.
+		DirectX::XMFLOAT2 Origin = { 0.0f, 0.0f };
+		float Size = 1.0f;
+
+		// Level 0 holds the leaves, the root is level LodCount-1.
+		uint32 LodCount = 5;
+
+		// Quads along an edge of the shared patch.  A power of two.
+		uint32 PatchResolution = 32;
+
+		// Range of the finest level; each coarser level reaches LodDistanceRatio times
+		// further.  Keep it at least twice the leaf size so neighbouring nodes never
+		// differ by more than one level.
+		float FinestLodDistance = 32.0f;
+		float LodDistanceRatio = 2.0f;
+
+		// Fraction of a level's range after which its vertices start to morph.
+		float MorphStartRatio = 0.66f;
+	};
+
+	struct Node
+	{
+		// World xz of the node's minimum corner, and its edge length.
+		float X = 0.0f;
+		float Z = 0.0f;
+		float Size = 0.0f;
+
+		// Height range of the terrain under the node.
+		float MinY = 0.0f;
+		float MaxY = 0.0f;
+
+		uint32 Level = 0;
+
+		// Quadrants to draw, bit (2*zHalf + xHalf).  A node is only partly drawn when
+		// some of its children are close enough to be drawn at the finer level.
+		uint32 QuadrantMask = 0xf;
+	};
+
+	// heights is a rows x columns grid spanning the terrain, row-major, with row 0
+	// at the minimum z and column 0 at the minimum x.  It is only read here to find
+	// the height range of every node.
+	TerrainQuadtree(const Settings& settings, const float* heights, uint32 rows, uint32 columns);
+
+	// Replaces out with the nodes to draw this frame and returns how many there are.
+	// Children come before their partly drawn parents.
+	// eye and planes are in world space, planes inward facing and normalized (a point
+	// p is inside when dot(xyz, p) + w >= 0), e.g. from Camera::GetWorldFrustumPlanes.
+	size_t Select(const DirectX::XMFLOAT3& eye, const DirectX::XMFLOAT4 planes[6], std::vector<Node>& out)const;
+
+	// Morph range of a level, for the vertex shader.
+	float MorphStart(uint32 level)const;
+	float MorphEnd(uint32 level)const;
+
+	float NodeSize(uint32 level)const;
+	const Settings& GetSettings()const;
+
+private:
+	enum class Visit
+	{
+		OutOfRange,
+		OutOfFrustum,
+		Selected
+	};
+
+	Visit SelectNode(uint32 level, uint32 x, uint32 z, bool inside, const DirectX::XMFLOAT3& eye,
+		const DirectX::XMFLOAT4 planes[6], std::vector<Node>& out)const;
+
+	Settings mSettings;
+
+	// Visibility range and morph start of every level.
+	std::vector<float> mRanges;
+	std::vector<float> mMorphStarts;
+
+	// Min/max height of every node, per level; level L is a square of
+	// 2^(LodCount-1-L) nodes per side.
+	std::vector<std::vector<DirectX::XMFLOAT2>> mHeightRanges;
+};
@@ -0,0 +1,145 @@
+//***************************************************************************************
+// ThreadPool.cpp 
+//***************************************************************************************
+
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace
+{
+	// Set on pool worker threads and while the caller is inside a ParallelFor, so
+	// nested calls fall back to running inline instead of deadlocking.
+	thread_local bool tInsideParallelFor = false;
+
+	// Restores tInsideParallelFor even when the caller's chunks throw.
+	struct InsideParallelForScope
+	{
+		InsideParallelForScope() { tInsideParallelFor = true; }
+		~InsideParallelForScope() { tInsideParallelFor = false; }
+	};
+}
+
+ThreadPool::ThreadPool(unsigned workerCount)
+{
+	if(workerCount == 0)
+	{
+		unsigned hw = std::thread::hardware_concurrency();
+		workerCount = hw > 1 ? hw - 1 : 0;
+	}
+
+	mWorkers.reserve(workerCount);
+	for(unsigned i = 0; i < workerCount; ++i)
+		mWorkers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mWake.notify_all();
+
+	for(auto& t : mWorkers)
+		t.join();
+}
+
+unsigned ThreadPool::ThreadCount()const
+{
+	return (unsigned)mWorkers.size() + 1;
+}
+
+void ThreadPool::ParallelFor(int first, int last, int grain, const std::function<void(int, int)>& body)
+{
+	if(first >= last)
+		return;
+
+	grain = std::max(grain, 1);
+
+	// Not worth waking anybody up.
+	if(mWorkers.empty() || tInsideParallelFor || last - first <= grain)
+	{
+		body(first, last);
+		return;
+	}
+
+	std::lock_guard<std::mutex> submit(mSubmitMutex);
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mBody = &body;
+		mNext.store(first);
+		mLast = last;
+		mGrain = grain;
+		mError = nullptr;
+		mBusyWorkers = (unsigned)mWorkers.size();
+		++mGeneration;
+	}
+	mWake.notify_all();
+
+	{
+		InsideParallelForScope inside;
+		RunChunks();
+	}
+
+	// Workers still hold a pointer to body, so always wait for them before leaving.
+	std::exception_ptr error;
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mDone.wait(lock, [this]{ return mBusyWorkers == 0; });
+		mBody = nullptr;
+		error = mError;
+		mError = nullptr;
+	}
+
+	if(error)
+		std::rethrow_exception(error);
+}
+
+ThreadPool& ThreadPool::Shared()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool::WorkerLoop()
+{
+	tInsideParallelFor = true;
+
+	unsigned seenGeneration = 0;
+	while(true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [&]{ return mQuit || mGeneration != seenGeneration; });
+			if(mQuit)
+				return;
+			seenGeneration = mGeneration;
+		}
+
+		RunChunks();
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		if(--mBusyWorkers == 0)
+			mDone.notify_one();
+	}
+}
+
+void ThreadPool::RunChunks()
+{
+	// Grab grain-sized chunks until the range is exhausted.
+	try
+	{
+		for(int begin = mNext.fetch_add(mGrain); begin < mLast; begin = mNext.fetch_add(mGrain))
+			(*mBody)(begin, std::min(begin + mGrain, mLast));
+	}
+	catch(...)
+	{
+		// Keep the first failure and stop everybody else from starting new chunks.
+		mNext.store(mLast);
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		if(!mError)
+			mError = std::current_exception();
+	}
+}
@@ -0,0 +1,61 @@
+//***************************************************************************************
+// ThreadPool.h 
+//
+// Small portable worker pool built on std::thread.  It only knows how to run a
+// blocking ParallelFor over an integer range; the calling thread takes part in the
+// work, so a pool with N workers keeps N+1 threads busy.
+//***************************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+	// workerCount == 0 picks hardware_concurrency()-1 workers.
+	explicit ThreadPool(unsigned workerCount = 0);
+	ThreadPool(const ThreadPool& rhs) = delete;
+	ThreadPool& operator=(const ThreadPool& rhs) = delete;
+	~ThreadPool();
+
+	// Number of threads that take part in a ParallelFor (workers + caller).
+	unsigned ThreadCount()const;
+
+	// Calls body(begin, end) on disjoint sub-ranges of [first, last), each at most
+	// grain elements long, and returns once the whole range has been processed.
+	// Calls made from inside a body run serially on the calling thread.  If body
+	// throws, the remaining chunks are skipped and the first exception is rethrown
+	// on the caller once every worker has finished.
+	void ParallelFor(int first, int last, int grain, const std::function<void(int, int)>& body);
+
+	// Process wide pool shared by the framework.
+	static ThreadPool& Shared();
+
+private:
+	void WorkerLoop();
+	void RunChunks();
+
+	std::vector<std::thread> mWorkers;
+
+	std::mutex mSubmitMutex;
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	std::condition_variable mDone;
+
+	const std::function<void(int, int)>* mBody = nullptr;
+	std::atomic<int> mNext{ 0 };
+	int mLast = 0;
+	int mGrain = 1;
+	std::exception_ptr mError;
+
+	unsigned mGeneration = 0;
+	unsigned mBusyWorkers = 0;
+	bool mQuit = false;
+};
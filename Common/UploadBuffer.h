@@ -57,6 +57,15 @@ public:
         memcpy(&mMappedData[elementIndex*mElementByteSize], &data, sizeof(T));
     }
 
+    // Pointer to the mapped elements, for producers that write a whole buffer in place.
+    // Only valid for non-constant buffers, where elements are tightly packed.  The
+    // memory is write-combined, so write it sequentially and never read it back.
+    T* MappedData()
+    {
+        assert(!mIsConstantBuffer);
+        return reinterpret_cast<T*>(mMappedData);
+    }
+
 private:
     Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
     BYTE* mMappedData = nullptr;
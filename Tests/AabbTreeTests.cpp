@@ -0,0 +1,155 @@
+//***************************************************************************************
+// AabbTreeTests.cpp
+//***************************************************************************************
+
+#include "TestHarness.h"
+#include "AabbTree.h"
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	float Random(float low, float high)
+	{
+		return low + (high - low)*std::rand() / RAND_MAX;
+	}
+
+	BoundingBox RandomBox(float range, float maxExtent)
+	{
+		return BoundingBox(
+			XMFLOAT3(Random(-range, range), Random(-range, range), Random(-range, range)),
+			XMFLOAT3(Random(0.1f, maxExtent), Random(0.1f, maxExtent), Random(0.1f, maxExtent)));
+	}
+
+	// Overlap of two boxes, optionally growing the first by slack on every side.
+	bool Overlaps(const BoundingBox& a, const BoundingBox& b, float slack = 0.0f)
+	{
+		return std::fabs(a.Center.x - b.Center.x) <= a.Extents.x + b.Extents.x + slack &&
+			std::fabs(a.Center.y - b.Center.y) <= a.Extents.y + b.Extents.y + slack &&
+			std::fabs(a.Center.z - b.Center.z) <= a.Extents.z + b.Extents.z + slack;
+	}
+
+	// Largest height an AVL balanced tree with leafCount leaves can have.
+	int MaxBalancedHeight(size_t leafCount)
+	{
+		return (int)std::ceil(1.45*std::log2((double)leafCount + 2.0));
+	}
+
+	struct Object
+	{
+		BoundingBox Box;
+		int Proxy = AabbTree::NullProxy;
+	};
+
+	// Checks a query against a brute force pass over the live objects: every object
+	// whose box overlaps is reported exactly once, and everything reported is live
+	// and has a fat box that overlaps.
+	void CheckQuery(const AabbTree& tree, const std::vector<Object>& objects, const BoundingBox& query)
+	{
+		std::vector<int> reported(objects.size(), 0);
+		tree.Query(query, [&](AabbTree::uint32 userData)
+		{
+			CHECK(userData < objects.size());
+			++reported[userData];
+			return true;
+		});
+
+		for(size_t i = 0; i < objects.size(); ++i)
+		{
+			const Object& object = objects[i];
+			if(object.Proxy == AabbTree::NullProxy)
+			{
+				CHECK(reported[i] == 0);
+				continue;
+			}
+
+			CHECK(reported[i] <= 1);
+			if(Overlaps(object.Box, query))
+				CHECK(reported[i] == 1);
+			if(reported[i] == 1)
+				CHECK(Overlaps(tree.GetFatBox(object.Proxy), query, 1.0e-3f));
+		}
+	}
+}
+
+TEST_CASE(AabbTree_RandomOperationsMatchBruteForce)
+{
+	std::srand(3);
+	AabbTree tree(0.5f);
+	std::vector<Object> objects(400);
+	size_t live = 0;
+
+	for(int step = 0; step < 20000; ++step)
+	{
+		Object& object = objects[std::rand() % objects.size()];
+		int op = std::rand() % 4;
+
+		if(object.Proxy == AabbTree::NullProxy)
+		{
+			object.Box = RandomBox(100.0f, 5.0f);
+			object.Proxy = tree.Insert(object.Box, (AabbTree::uint32)(&object - objects.data()));
+			++live;
+		}
+		else if(op == 0)
+		{
+			tree.Remove(object.Proxy);
+			object.Proxy = AabbTree::NullProxy;
+			--live;
+		}
+		else
+		{
+			// Small moves mostly stay inside the fat box, large ones reinsert.
+			float distance = op == 1 ? 0.2f : 20.0f;
+			object.Box.Center.x += Random(-distance, distance);
+			object.Box.Center.y += Random(-distance, distance);
+			object.Box.Center.z += Random(-distance, distance);
+			tree.Move(object.Proxy, object.Box);
+			CHECK(tree.GetUserData(object.Proxy) == (AabbTree::uint32)(&object - objects.data()));
+		}
+
+		CHECK(tree.GetProxyCount() == live);
+		if(step % 50 == 0)
+		{
+			CheckQuery(tree, objects, RandomBox(100.0f, 30.0f));
+			CHECK(tree.GetHeight() <= MaxBalancedHeight(live));
+		}
+	}
+
+	// Everything, then nothing.
+	CheckQuery(tree, objects, BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1000.0f, 1000.0f, 1000.0f)));
+	for(Object& object : objects)
+	{
+		if(object.Proxy != AabbTree::NullProxy)
+			tree.Remove(object.Proxy);
+		object.Proxy = AabbTree::NullProxy;
+	}
+	CHECK(tree.GetProxyCount() == 0);
+	CHECK(tree.GetHeight() == 0);
+	CheckQuery(tree, objects, BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1000.0f, 1000.0f, 1000.0f)));
+}
+
+TEST_CASE(AabbTree_HeightStaysLogarithmic)
+{
+	// Boxes in a sorted row are the worst case for insertion without rotations: every
+	// new leaf lands at the same end and the tree degenerates into a list.
+	AabbTree tree(0.1f);
+	std::vector<int> proxies;
+	for(int i = 0; i < 4096; ++i)
+	{
+		proxies.push_back(tree.Insert(BoundingBox(XMFLOAT3(2.0f*i, 0.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f)), (AabbTree::uint32)i));
+		CHECK(tree.GetHeight() <= MaxBalancedHeight(proxies.size()));
+	}
+
+	// Removing every other proxy and moving the rest to the far end of the row keeps
+	// the tree balanced too.
+	for(size_t i = 0; i < proxies.size(); i += 2)
+		tree.Remove(proxies[i]);
+	CHECK(tree.GetHeight() <= MaxBalancedHeight(proxies.size()/2));
+
+	for(size_t i = 1; i < proxies.size(); i += 2)
+		tree.Move(proxies[i], BoundingBox(XMFLOAT3(10000.0f + 2.0f*i, 0.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f)));
+	CHECK(tree.GetHeight() <= MaxBalancedHeight(proxies.size()/2));
+}
@@ -0,0 +1,53 @@
+//***************************************************************************************
+// FrustumCullerBench.cpp
+//***************************************************************************************
+
+#include "TestHarness.h"
+#include "FrustumCuller.h"
+#include <cstdlib>
+#include <vector>
+
+using namespace DirectX;
+
+BENCHMARK(FrustumCuller_Cull)
+{
+	// A 90 degree frustum looking down +z, with boxes scattered around it so about a
+	// fifth of them are visible.
+	const float s = 0.70710678f;
+	const XMFLOAT4 planes[6] =
+	{
+		XMFLOAT4(0.0f, 0.0f, 1.0f, -1.0f),
+		XMFLOAT4(0.0f, 0.0f, -1.0f, 100.0f),
+		XMFLOAT4(s, 0.0f, s, 0.0f),
+		XMFLOAT4(-s, 0.0f, s, 0.0f),
+		XMFLOAT4(0.0f, s, s, 0.0f),
+		XMFLOAT4(0.0f, -s, s, 0.0f),
+	};
+
+	for(size_t count : { 1000u, 8000u, 100000u, 1000000u })
+	{
+		std::vector<BoundingBox> boxes(count);
+		std::srand(5);
+		for(BoundingBox& box : boxes)
+		{
+			box.Center = XMFLOAT3(
+				-120.0f + 240.0f*std::rand() / RAND_MAX,
+				-120.0f + 240.0f*std::rand() / RAND_MAX,
+				-20.0f + 140.0f*std::rand() / RAND_MAX);
+			box.Extents = XMFLOAT3(1.0f, 1.0f, 1.0f);
+		}
+
+		std::vector<FrustumCuller::uint32> visible(count);
+		size_t visibleCount = 0;
+		Harness::Measurement m = Harness::Measure([&]
+		{
+			visibleCount = FrustumCuller::Cull(planes, boxes.data(), count, visible.data());
+		});
+
+		reporter.Add("FrustumCuller::Cull", m, {
+			{ "boxes", (double)count },
+			{ "visible", (double)visibleCount },
+			{ "parallel", count >= FrustumCuller::ParallelThreshold ? 1.0 : 0.0 },
+			{ "boxes_per_s", (double)count / m.SecondsPerCall } });
+	}
+}
@@ -0,0 +1,100 @@
+//***************************************************************************************
+// FrustumCullerTests.cpp
+//***************************************************************************************
+
+#include "TestHarness.h"
+#include "FrustumCuller.h"
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// A 90 degree frustum looking down +z from the origin, near 1, far 100.
+	void MakePlanes(XMFLOAT4 planes[6])
+	{
+		const float s = 0.70710678f;
+		planes[0] = XMFLOAT4(0.0f, 0.0f, 1.0f, -1.0f);
+		planes[1] = XMFLOAT4(0.0f, 0.0f, -1.0f, 100.0f);
+		planes[2] = XMFLOAT4(s, 0.0f, s, 0.0f);
+		planes[3] = XMFLOAT4(-s, 0.0f, s, 0.0f);
+		planes[4] = XMFLOAT4(0.0f, s, s, 0.0f);
+		planes[5] = XMFLOAT4(0.0f, -s, s, 0.0f);
+	}
+
+	// Signed distance of the box's farthest point in front of each plane; the box is
+	// culled if any of them is negative.
+	void PlaneDistances(const XMFLOAT4 planes[6], const BoundingBox& box, double distances[6])
+	{
+		for(int p = 0; p < 6; ++p)
+		{
+			const XMFLOAT4& plane = planes[p];
+			distances[p] = (double)plane.x*box.Center.x + (double)plane.y*box.Center.y +
+				(double)plane.z*box.Center.z + plane.w +
+				std::fabs(plane.x)*(double)box.Extents.x + std::fabs(plane.y)*(double)box.Extents.y +
+				std::fabs(plane.z)*(double)box.Extents.z;
+		}
+	}
+
+	// Random boxes around the frustum.  Boxes within rounding distance of a plane are
+	// regenerated, so float and double plane tests agree on every box.
+	std::vector<BoundingBox> MakeBoxes(const XMFLOAT4 planes[6], size_t count)
+	{
+		std::vector<BoundingBox> boxes(count);
+		std::srand(5);
+		for(BoundingBox& box : boxes)
+		{
+			bool ambiguous;
+			do
+			{
+				box.Center = XMFLOAT3(
+					-120.0f + 240.0f*std::rand() / RAND_MAX,
+					-120.0f + 240.0f*std::rand() / RAND_MAX,
+					-20.0f + 140.0f*std::rand() / RAND_MAX);
+				float extent = 0.1f + 4.0f*std::rand() / RAND_MAX;
+				box.Extents = XMFLOAT3(extent, 0.5f*extent, extent);
+
+				double distances[6];
+				PlaneDistances(planes, box, distances);
+				ambiguous = false;
+				for(double d : distances)
+					ambiguous = ambiguous || std::fabs(d) < 1.0e-3;
+			} while(ambiguous);
+		}
+		return boxes;
+	}
+}
+
+TEST_CASE(FrustumCuller_ParallelMatchesSerialPlaneTest)
+{
+	XMFLOAT4 planes[6];
+	MakePlanes(planes);
+
+	// Several chunks, the last one partial and not a whole number of SIMD groups.
+	const size_t count = 5*FrustumCuller::ChunkSize + 1234 + 3;
+	CHECK(count >= FrustumCuller::ParallelThreshold);
+	std::vector<BoundingBox> boxes = MakeBoxes(planes, count);
+
+	std::vector<FrustumCuller::uint32> expected;
+	for(size_t i = 0; i < count; ++i)
+	{
+		double distances[6];
+		PlaneDistances(planes, boxes[i], distances);
+		bool inside = true;
+		for(double d : distances)
+			inside = inside && d >= 0.0;
+		if(inside)
+			expected.push_back((FrustumCuller::uint32)i);
+	}
+	CHECK(!expected.empty() && expected.size() < count);
+
+	ThreadPool pool(3);
+	std::vector<FrustumCuller::uint32> visible(count);
+	size_t visibleCount = FrustumCuller::Cull(planes, boxes.data(), count, visible.data(), pool);
+
+	CHECK(visibleCount == expected.size());
+	for(size_t i = 0; i < visibleCount; ++i)
+		CHECK(visible[i] == expected[i]);
+}
@@ -0,0 +1,199 @@
+//***************************************************************************************
+// GeometryGeneratorBench.cpp
+//
+// Tessellation sweeps for the GeometryGenerator shapes.  Each shape is measured both
+// returning a new MeshData and refilling a reused one.  CreateTriangularPrism, CreateCone,
+// CreatePyramid, CreateDiamond, CreateWedge and CreateTorus are declared but have no
+// definition in Common, so they are not part of the sweep.
+//***************************************************************************************
+
+#include "TestHarness.h"
+#include "GeometryGenerator.h"
+#include <string>
+
+using namespace DirectX;
+
+namespace
+{
+	using MeshData = GeometryGenerator::MeshData;
+	using Vertex = GeometryGenerator::Vertex;
+
+	Vertex LegacyMidPoint(const Vertex& v0, const Vertex& v1)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&v0.Position);
+		XMVECTOR p1 = XMLoadFloat3(&v1.Position);
+		XMVECTOR n0 = XMLoadFloat3(&v0.Normal);
+		XMVECTOR n1 = XMLoadFloat3(&v1.Normal);
+		XMVECTOR tan0 = XMLoadFloat3(&v0.TangentU);
+		XMVECTOR tan1 = XMLoadFloat3(&v1.TangentU);
+		XMVECTOR tex0 = XMLoadFloat2(&v0.TexC);
+		XMVECTOR tex1 = XMLoadFloat2(&v1.TexC);
+
+		Vertex v;
+		XMStoreFloat3(&v.Position, 0.5f*(p0 + p1));
+		XMStoreFloat3(&v.Normal, XMVector3Normalize(0.5f*(n0 + n1)));
+		XMStoreFloat3(&v.TangentU, XMVector3Normalize(0.5f*(tan0 + tan1)));
+		XMStoreFloat2(&v.TexC, 0.5f*(tex0 + tex1));
+		return v;
+	}
+
+	// The Subdivide GeometryGenerator used to have: copy the mesh, then emit six
+	// vertices per triangle, so shared edges get their midpoints computed and
+	// stored once per triangle.  Kept as the baseline for the shared-midpoint version.
+	void LegacySubdivide(MeshData& meshData)
+	{
+		MeshData inputCopy = meshData;
+
+		meshData.Vertices.resize(0);
+		meshData.Indices32.resize(0);
+
+		GeometryGenerator::uint32 numTris = (GeometryGenerator::uint32)inputCopy.Indices32.size()/3;
+		for(GeometryGenerator::uint32 i = 0; i < numTris; ++i)
+		{
+			Vertex v0 = inputCopy.Vertices[inputCopy.Indices32[i*3+0]];
+			Vertex v1 = inputCopy.Vertices[inputCopy.Indices32[i*3+1]];
+			Vertex v2 = inputCopy.Vertices[inputCopy.Indices32[i*3+2]];
+
+			meshData.Vertices.push_back(v0);
+			meshData.Vertices.push_back(v1);
+			meshData.Vertices.push_back(v2);
+			meshData.Vertices.push_back(LegacyMidPoint(v0, v1));
+			meshData.Vertices.push_back(LegacyMidPoint(v1, v2));
+			meshData.Vertices.push_back(LegacyMidPoint(v0, v2));
+
+			for(GeometryGenerator::uint32 k : { 0, 3, 5, 3, 4, 5, 5, 4, 2, 3, 1, 4 })
+				meshData.Indices32.push_back(i*6 + k);
+		}
+	}
+
+	// Measures build(geoGen, mesh) both into a fresh MeshData and into one kept
+	// across calls, and reports vertices per second for each.
+	template<typename Build>
+	void Sweep(Harness::BenchmarkReporter& reporter, const std::string& name,
+		const char* parameter, double value, Build build)
+	{
+		GeometryGenerator geoGen;
+
+		MeshData probe;
+		build(geoGen, probe);
+		const double vertices = (double)probe.Vertices.size();
+		const double indices = (double)probe.Indices32.size();
+
+		Harness::Measurement fresh = Harness::Measure([&]
+		{
+			MeshData mesh;
+			build(geoGen, mesh);
+		});
+		reporter.Add(name, fresh, {
+			{ parameter, value },
+			{ "reuse", 0.0 },
+			{ "vertices", vertices },
+			{ "indices", indices },
+			{ "vertices_per_s", vertices / fresh.SecondsPerCall } });
+
+		MeshData reused;
+		Harness::Measurement warm = Harness::Measure([&]
+		{
+			build(geoGen, reused);
+		});
+		reporter.Add(name, warm, {
+			{ parameter, value },
+			{ "reuse", 1.0 },
+			{ "vertices", vertices },
+			{ "indices", indices },
+			{ "vertices_per_s", vertices / warm.SecondsPerCall } });
+	}
+}
+
+BENCHMARK(GeometryGenerator_Box)
+{
+	for(GeometryGenerator::uint32 subdivisions = 0; subdivisions <= 6; ++subdivisions)
+	{
+		Sweep(reporter, "CreateBox", "subdivisions", subdivisions, [=](GeometryGenerator& g, MeshData& mesh)
+		{
+			g.CreateBox(1.0f, 1.0f, 1.0f, subdivisions, mesh);
+		});
+	}
+}
+
+BENCHMARK(GeometryGenerator_Sphere)
+{
+	for(GeometryGenerator::uint32 slices : { 8u, 32u, 128u, 512u })
+	{
+		Sweep(reporter, "CreateSphere", "slices", slices, [=](GeometryGenerator& g, MeshData& mesh)
+		{
+			g.CreateSphere(1.0f, slices, slices, mesh);
+		});
+	}
+}
+
+BENCHMARK(GeometryGenerator_Geosphere)
+{
+	for(GeometryGenerator::uint32 subdivisions = 0; subdivisions <= 6; ++subdivisions)
+	{
+		Sweep(reporter, "CreateGeosphere", "subdivisions", subdivisions, [=](GeometryGenerator& g, MeshData& mesh)
+		{
+			g.CreateGeosphere(1.0f, subdivisions, mesh);
+		});
+	}
+}
+
+BENCHMARK(GeometryGenerator_Cylinder)
+{
+	for(GeometryGenerator::uint32 slices : { 8u, 32u, 128u, 512u })
+	{
+		Sweep(reporter, "CreateCylinder", "slices", slices, [=](GeometryGenerator& g, MeshData& mesh)
+		{
+			g.CreateCylinder(1.0f, 0.5f, 2.0f, slices, slices, mesh);
+		});
+	}
+}
+
+BENCHMARK(GeometryGenerator_Grid)
+{
+	for(GeometryGenerator::uint32 size : { 16u, 64u, 256u, 1024u })
+	{
+		Sweep(reporter, "CreateGrid", "rows", size, [=](GeometryGenerator& g, MeshData& mesh)
+		{
+			g.CreateGrid(100.0f, 100.0f, size, size, mesh);
+		});
+	}
+}
+
+BENCHMARK(GeometryGenerator_Subdivide)
+{
+	// Subdivide applied depth times to an unsubdivided box, next to the old
+	// copy-and-split version ("SubdivideCopySplit") on the same input.
+	for(int depth = 0; depth <= 6; ++depth)
+	{
+		Sweep(reporter, "Subdivide", "depth", depth, [=](GeometryGenerator& g, MeshData& mesh)
+		{
+			g.CreateBox(1.0f, 1.0f, 1.0f, 0, mesh);
+			for(int d = 0; d < depth; ++d)
+				g.Subdivide(mesh);
+		});
+
+		GeometryGenerator geoGen;
+		auto legacy = [&](MeshData& mesh)
+		{
+			geoGen.CreateBox(1.0f, 1.0f, 1.0f, 0, mesh);
+			for(int d = 0; d < depth; ++d)
+				LegacySubdivide(mesh);
+		};
+
+		MeshData probe;
+		legacy(probe);
+		const double vertices = (double)probe.Vertices.size();
+
+		Harness::Measurement m = Harness::Measure([&]
+		{
+			MeshData mesh;
+			legacy(mesh);
+		});
+		reporter.Add("SubdivideCopySplit", m, {
+			{ "depth", (double)depth },
+			{ "vertices", vertices },
+			{ "indices", (double)probe.Indices32.size() },
+			{ "vertices_per_s", vertices / m.SecondsPerCall } });
+	}
+}
@@ -0,0 +1,73 @@
+//***************************************************************************************
+// GeometryGeneratorTests.cpp
+//***************************************************************************************
+
+#include "TestHarness.h"
+#include "GeometryGenerator.h"
+#include <functional>
+#include <vector>
+
+namespace
+{
+	using MeshData = GeometryGenerator::MeshData;
+	using Build = std::function<void(GeometryGenerator&, MeshData&)>;
+
+	std::vector<Build> AllShapes()
+	{
+		std::vector<Build> shapes;
+		for(GeometryGenerator::uint32 level = 0; level <= 6; ++level)
+		{
+			shapes.push_back([=](GeometryGenerator& g, MeshData& m) { g.CreateBox(2.0f, 3.0f, 4.0f, level, m); });
+			shapes.push_back([=](GeometryGenerator& g, MeshData& m) { g.CreateGeosphere(1.0f, level, m); });
+		}
+		for(GeometryGenerator::uint32 slices : { 3u, 8u, 20u, 64u })
+		{
+			shapes.push_back([=](GeometryGenerator& g, MeshData& m) { g.CreateSphere(1.0f, slices, slices + 1, m); });
+			shapes.push_back([=](GeometryGenerator& g, MeshData& m) { g.CreateCylinder(1.0f, 0.5f, 2.0f, slices, slices + 2, m); });
+			shapes.push_back([=](GeometryGenerator& g, MeshData& m) { g.CreateGrid(10.0f, 20.0f, slices, slices + 5, m); });
+		}
+		shapes.push_back([](GeometryGenerator& g, MeshData& m) { g.CreateQuad(0.0f, 0.0f, 1.0f, 1.0f, 0.0f, m); });
+		return shapes;
+	}
+}
+
+TEST_CASE(GeometryGenerator_FreshMeshIsSizedExactly)
+{
+	GeometryGenerator geoGen;
+	for(const Build& build : AllShapes())
+	{
+		// Warm the generator's own scratch tables so only the mesh is counted.
+		{
+			MeshData warm;
+			build(geoGen, warm);
+		}
+
+		MeshData mesh;
+		std::uint64_t before = Harness::AllocationCount();
+		build(geoGen, mesh);
+		std::uint64_t allocations = Harness::AllocationCount() - before;
+
+		// One block for the vertices and one for the indices, never regrown.
+		CHECK(allocations == 2);
+		CHECK(mesh.Vertices.capacity() == mesh.Vertices.size());
+		CHECK(mesh.Indices32.capacity() == mesh.Indices32.size());
+	}
+}
+
+TEST_CASE(GeometryGenerator_ReusedMeshDoesNotAllocate)
+{
+	GeometryGenerator geoGen;
+	std::vector<Build> shapes = AllShapes();
+
+	// Grow the mesh to the largest shape first, then every rebuild must fit.
+	MeshData mesh;
+	for(const Build& build : shapes)
+		build(geoGen, mesh);
+	for(const Build& build : shapes)
+		build(geoGen, mesh);
+
+	std::uint64_t before = Harness::AllocationCount();
+	for(const Build& build : shapes)
+		build(geoGen, mesh);
+	CHECK(Harness::AllocationCount() == before);
+}
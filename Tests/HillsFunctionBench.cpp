@@ -0,0 +1,61 @@
+//***************************************************************************************
+// HillsFunctionBench.cpp
+//
+// A CreateGrid-layout grid of hills evaluated three ways: Height/Normal per vertex,
+// the SoA batch functions, and EvaluateGrid on the shared ThreadPool.
+//***************************************************************************************
+
+#include "TestHarness.h"
+#include "GeometryGenerator.h"
+#include "HillsFunction.h"
+#include <vector>
+
+using namespace DirectX;
+
+BENCHMARK(HillsFunction_Grid)
+{
+	for(HillsFunction::uint32 size : { 256u, 1024u })
+	{
+		GeometryGenerator geoGen;
+		GeometryGenerator::MeshData grid = geoGen.CreateGrid(160.0f, 160.0f, size, size);
+		std::vector<GeometryGenerator::Vertex>& vertices = grid.Vertices;
+		const double points = (double)vertices.size();
+
+		Harness::Measurement scalar = Harness::Measure([&]
+		{
+			for(auto& v : vertices)
+			{
+				v.Position.y = HillsFunction::Height(v.Position.x, v.Position.z);
+				v.Normal = HillsFunction::Normal(v.Position.x, v.Position.z);
+			}
+		});
+		reporter.Add("HillsFunction::Height+Normal", scalar, {
+			{ "rows", (double)size },
+			{ "points_per_s", points / scalar.SecondsPerCall } });
+
+		std::vector<float> x(vertices.size()), z(vertices.size());
+		for(size_t i = 0; i < vertices.size(); ++i)
+		{
+			x[i] = vertices[i].Position.x;
+			z[i] = vertices[i].Position.z;
+		}
+		std::vector<float> heights(x.size()), nx(x.size()), ny(x.size()), nz(x.size());
+		Harness::Measurement batch = Harness::Measure([&]
+		{
+			HillsFunction::Heights(x.data(), z.data(), heights.data(), x.size());
+			HillsFunction::Normals(x.data(), z.data(), nx.data(), ny.data(), nz.data(), x.size());
+		});
+		reporter.Add("HillsFunction::Heights+Normals", batch, {
+			{ "rows", (double)size },
+			{ "points_per_s", points / batch.SecondsPerCall } });
+
+		Harness::Measurement evaluate = Harness::Measure([&]
+		{
+			HillsFunction::EvaluateGrid(160.0f, 160.0f, size, size, &vertices[0].Position,
+				&vertices[0].Normal, sizeof(GeometryGenerator::Vertex));
+		});
+		reporter.Add("HillsFunction::EvaluateGrid", evaluate, {
+			{ "rows", (double)size },
+			{ "points_per_s", points / evaluate.SecondsPerCall } });
+	}
+}
@@ -0,0 +1,78 @@
+//***************************************************************************************
+// HillsFunctionTests.cpp
+//***************************************************************************************
+
+#include "TestHarness.h"
+#include "GeometryGenerator.h"
+#include "HillsFunction.h"
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// The vector sin/cos agree with sinf/cosf to about 1e-6, and the height multiplies
+	// them by x and z, so the error grows with distance from the origin.
+	double Tolerance(float x, float z)
+	{
+		return 1.0e-5*(1.0 + std::fabs(x) + std::fabs(z));
+	}
+}
+
+TEST_CASE(HillsFunction_BatchesMatchScalar)
+{
+	// Odd count, so the last batch is partial.
+	const size_t count = 1000 + HillsFunction::BatchSize/2 + 1;
+	std::vector<float> x(count), z(count);
+	std::srand(11);
+	for(size_t i = 0; i < count; ++i)
+	{
+		x[i] = -200.0f + 400.0f*std::rand() / RAND_MAX;
+		z[i] = -200.0f + 400.0f*std::rand() / RAND_MAX;
+	}
+
+	std::vector<float> heights(count), nx(count), ny(count), nz(count);
+	HillsFunction::Heights(x.data(), z.data(), heights.data(), count);
+	HillsFunction::Normals(x.data(), z.data(), nx.data(), ny.data(), nz.data(), count);
+
+	for(size_t i = 0; i < count; ++i)
+	{
+		const double tolerance = Tolerance(x[i], z[i]);
+		CHECK_NEAR(heights[i], HillsFunction::Height(x[i], z[i]), tolerance);
+
+		XMFLOAT3 n = HillsFunction::Normal(x[i], z[i]);
+		CHECK_NEAR(nx[i], n.x, tolerance);
+		CHECK_NEAR(ny[i], n.y, tolerance);
+		CHECK_NEAR(nz[i], n.z, tolerance);
+	}
+}
+
+TEST_CASE(HillsFunction_GridMatchesScalar)
+{
+	// Neither size is a multiple of the batch size.
+	const HillsFunction::uint32 m = 37, n = 53;
+	GeometryGenerator geoGen;
+	GeometryGenerator::MeshData grid = geoGen.CreateGrid(160.0f, 120.0f, m, n);
+	GeometryGenerator::MeshData expected = grid;
+
+	HillsFunction::EvaluateGrid(160.0f, 120.0f, m, n, &grid.Vertices[0].Position,
+		&grid.Vertices[0].Normal, sizeof(GeometryGenerator::Vertex));
+
+	for(size_t i = 0; i < grid.Vertices.size(); ++i)
+	{
+		const XMFLOAT3& p = expected.Vertices[i].Position;
+		const XMFLOAT3& q = grid.Vertices[i].Position;
+		const double tolerance = Tolerance(p.x, p.z);
+		CHECK_NEAR(q.x, p.x, 1.0e-4);
+		CHECK_NEAR(q.z, p.z, 1.0e-4);
+		CHECK_NEAR(q.y, HillsFunction::Height(p.x, p.z), tolerance);
+
+		XMFLOAT3 normal = HillsFunction::Normal(p.x, p.z);
+		const XMFLOAT3& r = grid.Vertices[i].Normal;
+		CHECK_NEAR(r.x, normal.x, tolerance);
+		CHECK_NEAR(r.y, normal.y, tolerance);
+		CHECK_NEAR(r.z, normal.z, tolerance);
+	}
+}
@@ -0,0 +1,124 @@
+//***************************************************************************************
+// PackedVertexTests.cpp
+//***************************************************************************************
+
+#include "TestHarness.h"
+#include "GeometryGenerator.h"
+#include "PackedVertex.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// A sphere offset from the origin, so the bounds are not symmetric about zero.
+	GeometryGenerator::MeshData TestMesh()
+	{
+		GeometryGenerator geoGen;
+		GeometryGenerator::MeshData mesh = geoGen.CreateSphere(3.5f, 61, 47);
+		for(auto& v : mesh.Vertices)
+		{
+			v.Position.x += 10.0f;
+			v.Position.y -= 2.0f;
+			v.TexC.x *= 4.0f;
+		}
+		return mesh;
+	}
+
+	void Bounds(const GeometryGenerator::MeshData& mesh, XMFLOAT3& center, XMFLOAT3& extents)
+	{
+		XMFLOAT3 lo = mesh.Vertices[0].Position;
+		XMFLOAT3 hi = lo;
+		for(const auto& v : mesh.Vertices)
+		{
+			lo = XMFLOAT3(std::min(lo.x, v.Position.x), std::min(lo.y, v.Position.y), std::min(lo.z, v.Position.z));
+			hi = XMFLOAT3(std::max(hi.x, v.Position.x), std::max(hi.y, v.Position.y), std::max(hi.z, v.Position.z));
+		}
+		center = XMFLOAT3(0.5f*(lo.x + hi.x), 0.5f*(lo.y + hi.y), 0.5f*(lo.z + hi.z));
+		extents = XMFLOAT3(0.5f*(hi.x - lo.x), 0.5f*(hi.y - lo.y), 0.5f*(hi.z - lo.z));
+	}
+}
+
+TEST_CASE(PackedVertex_RoundTripStaysWithinErrorBounds)
+{
+	GeometryGenerator::MeshData mesh = TestMesh();
+	const size_t count = mesh.Vertices.size();
+	const size_t stride = sizeof(GeometryGenerator::Vertex);
+
+	XMFLOAT3 center, extents;
+	Bounds(mesh, center, extents);
+	PositionQuantization quantization = PositionQuantization::FromBounds(center, extents);
+
+	std::vector<PackedVertex> packed(count);
+	VertexPacking::Encode(&mesh.Vertices[0].Position, &mesh.Vertices[0].Normal, &mesh.Vertices[0].TexC,
+		stride, count, quantization, packed.data());
+
+	std::vector<GeometryGenerator::Vertex> decoded(count);
+	VertexPacking::Decode(packed.data(), count, quantization,
+		&decoded[0].Position, &decoded[0].Normal, &decoded[0].TexC, stride);
+
+	const XMFLOAT3 maxError = quantization.MaxError();
+	for(size_t i = 0; i < count; ++i)
+	{
+		const auto& a = mesh.Vertices[i];
+		const auto& b = decoded[i];
+
+		CHECK_NEAR(a.Position.x, b.Position.x, maxError.x);
+		CHECK_NEAR(a.Position.y, b.Position.y, maxError.y);
+		CHECK_NEAR(a.Position.z, b.Position.z, maxError.z);
+
+		// acos is useless this close to 1, so take the angle from the cross product.
+		double ax = a.Normal.x, ay = a.Normal.y, az = a.Normal.z;
+		double bx = b.Normal.x, by = b.Normal.y, bz = b.Normal.z;
+		double cx = ay*bz - az*by, cy = az*bx - ax*bz, cz = ax*by - ay*bx;
+		double angle = std::atan2(std::sqrt(cx*cx + cy*cy + cz*cz), ax*bx + ay*by + az*bz);
+		CHECK(angle <= VertexPacking::MaxNormalError);
+
+		// Half floats keep 11 significant bits, so rounding is within 2^-11 relative.
+		CHECK_NEAR(a.TexC.x, b.TexC.x, std::fabs(a.TexC.x)*(1.0f/2048.0f) + 1.0e-7f);
+		CHECK_NEAR(a.TexC.y, b.TexC.y, std::fabs(a.TexC.y)*(1.0f/2048.0f) + 1.0e-7f);
+	}
+}
+
+TEST_CASE(PackedVertex_BatchEncodeMatchesScalar)
+{
+	GeometryGenerator::MeshData mesh = TestMesh();
+	const size_t count = mesh.Vertices.size();
+
+	XMFLOAT3 center, extents;
+	Bounds(mesh, center, extents);
+	PositionQuantization quantization = PositionQuantization::FromBounds(center, extents);
+
+	std::vector<PackedVertex> packed(count);
+	VertexPacking::Encode(&mesh.Vertices[0].Position, &mesh.Vertices[0].Normal, &mesh.Vertices[0].TexC,
+		sizeof(GeometryGenerator::Vertex), count, quantization, packed.data());
+
+	for(size_t i = 0; i < count; ++i)
+	{
+		std::int16_t normal[2];
+		VertexPacking::EncodeOctahedral(mesh.Vertices[i].Normal, normal);
+		CHECK(packed[i].Normal[0] == normal[0] && packed[i].Normal[1] == normal[1]);
+		CHECK(packed[i].TexC[0] == VertexPacking::FloatToHalf(mesh.Vertices[i].TexC.x));
+		CHECK(packed[i].TexC[1] == VertexPacking::FloatToHalf(mesh.Vertices[i].TexC.y));
+		CHECK(packed[i].Pos[3] == 0);
+	}
+}
+
+TEST_CASE(PackedVertex_HalfConversion)
+{
+	CHECK(VertexPacking::FloatToHalf(0.0f) == 0x0000);
+	CHECK(VertexPacking::FloatToHalf(1.0f) == 0x3c00);
+	CHECK(VertexPacking::FloatToHalf(-2.0f) == 0xc000);
+	CHECK(VertexPacking::FloatToHalf(65504.0f) == 0x7bff);
+	CHECK(VertexPacking::FloatToHalf(1.0e6f) == 0x7c00);
+
+	// Every finite half survives a round trip through float.
+	for(std::uint32_t h = 0; h < 0x7c00; ++h)
+	{
+		float f = VertexPacking::HalfToFloat((std::uint16_t)h);
+		CHECK(VertexPacking::FloatToHalf(f) == h);
+		CHECK(VertexPacking::FloatToHalf(-f) == (h | 0x8000));
+	}
+}
@@ -0,0 +1,53 @@
+//***************************************************************************************
+// TerrainQuadtreeBench.cpp
+//***************************************************************************************
+
+#include "TestHarness.h"
+#include "Camera.h"
+#include "TerrainQuadtree.h"
+#include <cmath>
+#include <vector>
+
+using namespace DirectX;
+
+BENCHMARK(TerrainQuadtree_Select)
+{
+	// A 4 km terrain over a 1025^2 heightmap of rolling hills.
+	const uint32_t samples = 1025;
+	std::vector<float> heights(samples*samples);
+	for(uint32_t r = 0; r < samples; ++r)
+		for(uint32_t c = 0; c < samples; ++c)
+			heights[r*samples + c] = 40.0f*std::sin(0.02f*c)*std::cos(0.015f*r);
+
+	for(uint32_t lodCount : { 6u, 8u, 10u })
+	{
+		TerrainQuadtree::Settings settings;
+		settings.Origin = XMFLOAT2(-2048.0f, -2048.0f);
+		settings.Size = 4096.0f;
+		settings.LodCount = lodCount;
+		settings.FinestLodDistance = 2.5f*settings.Size / (float)(1u << (lodCount - 1));
+		TerrainQuadtree tree(settings, heights.data(), samples, samples);
+
+		Camera camera;
+		camera.SetLens(0.25f*XM_PI, 16.0f / 9.0f, 1.0f, 5000.0f);
+		camera.LookAt(XMFLOAT3(0.0f, 60.0f, 0.0f), XMFLOAT3(300.0f, 0.0f, 400.0f), XMFLOAT3(0.0f, 1.0f, 0.0f));
+		camera.UpdateViewMatrix();
+
+		XMFLOAT4 planes[6];
+		camera.GetWorldFrustumPlanes(planes);
+		const XMFLOAT3 eye = camera.GetPosition3f();
+
+		std::vector<TerrainQuadtree::Node> nodes;
+		size_t selected = tree.Select(eye, planes, nodes);
+
+		Harness::Measurement m = Harness::Measure([&]
+		{
+			tree.Select(eye, planes, nodes);
+		});
+
+		reporter.Add("TerrainQuadtree::Select", m, {
+			{ "lod_count", (double)lodCount },
+			{ "nodes", (double)selected },
+			{ "selections_per_s", 1.0 / m.SecondsPerCall } });
+	}
+}
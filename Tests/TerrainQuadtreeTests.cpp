@@ -0,0 +1,181 @@
+//***************************************************************************************
+// TerrainQuadtreeTests.cpp
+//***************************************************************************************
+
+#include "TestHarness.h"
+#include "TerrainQuadtree.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// Planes that keep every point.
+	void OpenFrustum(XMFLOAT4 planes[6])
+	{
+		for(int i = 0; i < 6; ++i)
+			planes[i] = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	TerrainQuadtree::Settings FlatSettings(uint32_t lodCount, float finestLodDistance)
+	{
+		TerrainQuadtree::Settings settings;
+		settings.Size = 160.0f;
+		settings.LodCount = lodCount;
+		settings.FinestLodDistance = finestLodDistance;
+		settings.LodDistanceRatio = 2.0f;
+		settings.MorphStartRatio = 0.5f;
+		return settings;
+	}
+
+	const std::vector<float> FlatHeights(17*17, 0.0f);
+
+	float DistanceToSquare(const XMFLOAT3& eye, float x, float z, float size)
+	{
+		float dx = std::max(std::max(x - eye.x, eye.x - (x + size)), 0.0f);
+		float dz = std::max(std::max(z - eye.z, eye.z - (z + size)), 0.0f);
+		return std::sqrt(dx*dx + eye.y*eye.y + dz*dz);
+	}
+}
+
+TEST_CASE(TerrainQuadtree_MorphRanges)
+{
+	TerrainQuadtree tree(FlatSettings(4, 10.0f), FlatHeights.data(), 17, 17);
+
+	const float ranges[] = { 10.0f, 20.0f, 40.0f, 80.0f };
+	const float starts[] = { 5.0f, 15.0f, 30.0f, 60.0f };
+	for(uint32_t level = 0; level < 4; ++level)
+	{
+		CHECK_NEAR(tree.MorphEnd(level), ranges[level], 1.0e-5);
+		CHECK_NEAR(tree.MorphStart(level), starts[level], 1.0e-5);
+		CHECK_NEAR(tree.NodeSize(level), 20.0f*(1u << level), 1.0e-5);
+	}
+}
+
+TEST_CASE(TerrainQuadtree_NodeHeightRanges)
+{
+	// A ramp rising one unit per column; a leaf covers two columns of samples.
+	std::vector<float> ramp(17*17);
+	for(int r = 0; r < 17; ++r)
+		for(int c = 0; c < 17; ++c)
+			ramp[r*17 + c] = (float)c;
+
+	TerrainQuadtree tree(FlatSettings(4, 10.0f), ramp.data(), 17, 17);
+
+	XMFLOAT4 planes[6];
+	OpenFrustum(planes);
+
+	// High above the middle only the root is in range.
+	std::vector<TerrainQuadtree::Node> nodes;
+	CHECK(tree.Select(XMFLOAT3(80.0f, 70.0f, 80.0f), planes, nodes) == 1);
+	CHECK(nodes[0].Level == 3 && nodes[0].QuadrantMask == 0xf);
+	CHECK(nodes[0].MinY == 0.0f && nodes[0].MaxY == 16.0f);
+
+	// Next to the x = 0 edge the leaf there spans samples 0..2.
+	tree.Select(XMFLOAT3(1.0f, 1.0f, 1.0f), planes, nodes);
+	CHECK(nodes[0].Level == 0);
+	CHECK(nodes[0].MinY == 0.0f && nodes[0].MaxY == 2.0f);
+}
+
+TEST_CASE(TerrainQuadtree_SelectsNodesForFixedEye)
+{
+	TerrainQuadtree tree(FlatSettings(4, 10.0f), FlatHeights.data(), 17, 17);
+
+	XMFLOAT4 planes[6];
+	OpenFrustum(planes);
+
+	// Near the origin corner every level keeps its first quadrant for the level below
+	// and draws the other three itself.
+	std::vector<TerrainQuadtree::Node> nodes;
+	CHECK(tree.Select(XMFLOAT3(1.0f, 5.0f, 1.0f), planes, nodes) == 4);
+	for(uint32_t level = 0; level < 4; ++level)
+	{
+		const TerrainQuadtree::Node& node = nodes[level];
+		CHECK(node.Level == level);
+		CHECK(node.X == 0.0f && node.Z == 0.0f);
+		CHECK(node.Size == 20.0f*(1u << level));
+		CHECK(node.QuadrantMask == (level == 0 ? 0xfu : 0xeu));
+	}
+
+	// A plane keeping x >= 25 culls the leaf; its parent still leaves that quadrant
+	// to the culled child.
+	planes[0] = XMFLOAT4(1.0f, 0.0f, 0.0f, -25.0f);
+	CHECK(tree.Select(XMFLOAT3(1.0f, 5.0f, 1.0f), planes, nodes) == 3);
+	for(uint32_t i = 0; i < 3; ++i)
+	{
+		CHECK(nodes[i].Level == i + 1);
+		CHECK(nodes[i].QuadrantMask == 0xeu);
+	}
+}
+
+TEST_CASE(TerrainQuadtree_SelectionTilesTerrain)
+{
+	// Leaf size 10 and finest range 20, so neighbours differ by at most one level.
+	const uint32_t lodCount = 5;
+	const int leaves = 1 << (lodCount - 1);
+	TerrainQuadtree tree(FlatSettings(lodCount, 20.0f), FlatHeights.data(), 17, 17);
+
+	XMFLOAT4 planes[6];
+	OpenFrustum(planes);
+
+	std::srand(7);
+	std::vector<TerrainQuadtree::Node> nodes;
+	for(int trial = 0; trial < 200; ++trial)
+	{
+		XMFLOAT3 eye(
+			160.0f*std::rand() / RAND_MAX,
+			1.0f + 50.0f*std::rand() / RAND_MAX,
+			160.0f*std::rand() / RAND_MAX);
+		tree.Select(eye, planes, nodes);
+
+		// Level drawn over each leaf cell, -1 while uncovered.
+		std::vector<int> cover(leaves*leaves, -1);
+		for(const TerrainQuadtree::Node& node : nodes)
+		{
+			// Leaves are always drawn whole; split the others into their quadrants.
+			const int parts = node.Level == 0 ? 1 : 4;
+			const float half = node.Level == 0 ? node.Size : 0.5f*node.Size;
+			for(int q = 0; q < parts; ++q)
+			{
+				if((node.QuadrantMask & (1u << q)) == 0)
+					continue;
+
+				float x = node.X + (q & 1)*half;
+				float z = node.Z + (q >> 1)*half;
+
+				// Drawn at this level: inside its range, beyond the finer level's.
+				float d = DistanceToSquare(eye, node.X, node.Z, node.Size);
+				CHECK(d <= tree.MorphEnd(node.Level) + 1.0e-3f);
+				if(node.Level > 0)
+					CHECK(DistanceToSquare(eye, x, z, half) >= tree.MorphEnd(node.Level - 1) - 1.0e-3f);
+
+				int cells = (int)std::lround(half / 10.0f);
+				int cx = (int)std::lround(x / 10.0f);
+				int cz = (int)std::lround(z / 10.0f);
+				for(int j = cz; j < cz + cells; ++j)
+				{
+					for(int i = cx; i < cx + cells; ++i)
+					{
+						CHECK(cover[j*leaves + i] == -1);
+						cover[j*leaves + i] = (int)node.Level;
+					}
+				}
+			}
+		}
+
+		for(int j = 0; j < leaves; ++j)
+		{
+			for(int i = 0; i < leaves; ++i)
+			{
+				CHECK(cover[j*leaves + i] >= 0);
+				if(i + 1 < leaves)
+					CHECK(std::abs(cover[j*leaves + i] - cover[j*leaves + i + 1]) <= 1);
+				if(j + 1 < leaves)
+					CHECK(std::abs(cover[j*leaves + i] - cover[(j + 1)*leaves + i]) <= 1);
+			}
+		}
+	}
+}
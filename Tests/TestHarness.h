@@ -0,0 +1,140 @@
+//***************************************************************************************
+// TestHarness.h
+//
+// Minimal self-registering test and benchmark harness for framework_tests.  Tests
+// throw on the first failed CHECK; benchmarks time a callable and report named
+// numbers, which TestMain prints as one JSON document.
+//
+// Every heap allocation made through operator new is counted (TestMain.cpp replaces
+// the global operators), so tests can assert on allocation counts and benchmarks can
+// report allocations and peak heap use per call.
+//***************************************************************************************
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Harness
+{
+	using TestFn = void(*)();
+
+	class BenchmarkReporter;
+	using BenchmarkFn = void(*)(BenchmarkReporter&);
+
+	struct Registrar
+	{
+		Registrar(const char* name, TestFn fn);
+		Registrar(const char* name, BenchmarkFn fn);
+	};
+
+	struct Failure : std::runtime_error
+	{
+		using std::runtime_error::runtime_error;
+	};
+
+	// Heap statistics since the start of the process.
+	std::uint64_t AllocationCount();
+	std::size_t LiveHeapBytes();
+
+	// Restarts peak tracking at the current live size and returns the highest live size
+	// seen since the previous call.
+	std::size_t ResetPeakHeapBytes();
+
+	struct Measurement
+	{
+		int Calls = 0;
+		double SecondsPerCall = 0.0;
+		double AllocationsPerCall = 0.0;
+
+		// Highest live heap size during a call, above what was live before it.
+		std::size_t PeakHeapBytes = 0;
+	};
+
+	// Calls fn once to warm up, then repeatedly until at least minSeconds have passed.
+	template<typename Fn>
+	Measurement Measure(Fn&& fn, double minSeconds = 0.25)
+	{
+		using Clock = std::chrono::steady_clock;
+
+		fn();
+
+		Measurement m;
+		const std::size_t baseBytes = LiveHeapBytes();
+		const std::uint64_t baseAllocs = AllocationCount();
+		ResetPeakHeapBytes();
+
+		const Clock::time_point start = Clock::now();
+		double elapsed = 0.0;
+		do
+		{
+			fn();
+			++m.Calls;
+			elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+		} while(elapsed < minSeconds);
+
+		const std::size_t peak = ResetPeakHeapBytes();
+		m.SecondsPerCall = elapsed / m.Calls;
+		m.AllocationsPerCall = (double)(AllocationCount() - baseAllocs) / m.Calls;
+		m.PeakHeapBytes = peak > baseBytes ? peak - baseBytes : 0;
+		return m;
+	}
+
+	// Collects one JSON object per Add call.
+	class BenchmarkReporter
+	{
+	public:
+		using Field = std::pair<std::string, double>;
+
+		void Add(const std::string& name, const std::vector<Field>& fields);
+
+		// Adds the standard fields of a Measurement plus fields of the caller's own.
+		void Add(const std::string& name, const Measurement& m, std::vector<Field> fields = {});
+
+		const std::vector<std::string>& Results()const { return mResults; }
+
+	private:
+		std::vector<std::string> mResults;
+	};
+}
+
+#define HARNESS_CONCAT_IMPL(a, b) a##b
+#define HARNESS_CONCAT(a, b) HARNESS_CONCAT_IMPL(a, b)
+
+#define TEST_CASE(name) \
+	static void HARNESS_CONCAT(TestFn_, name)(); \
+	static Harness::Registrar HARNESS_CONCAT(TestReg_, name)(#name, &HARNESS_CONCAT(TestFn_, name)); \
+	static void HARNESS_CONCAT(TestFn_, name)()
+
+#define BENCHMARK(name) \
+	static void HARNESS_CONCAT(BenchFn_, name)(Harness::BenchmarkReporter& reporter); \
+	static Harness::Registrar HARNESS_CONCAT(BenchReg_, name)(#name, &HARNESS_CONCAT(BenchFn_, name)); \
+	static void HARNESS_CONCAT(BenchFn_, name)(Harness::BenchmarkReporter& reporter)
+
+#define CHECK(cond) \
+	do { if(!(cond)) { \
+		std::ostringstream harnessMsg; \
+		harnessMsg << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed"; \
+		throw Harness::Failure(harnessMsg.str()); } } while(false)
+
+#define CHECK_NEAR(a, b, tolerance) \
+	do { const double harnessA = (a), harnessB = (b); \
+		if(!(harnessA - harnessB <= (tolerance) && harnessB - harnessA <= (tolerance))) { \
+		std::ostringstream harnessMsg; \
+		harnessMsg << __FILE__ << ":" << __LINE__ << ": CHECK_NEAR(" #a ", " #b ") failed: " \
+			<< harnessA << " vs " << harnessB; \
+		throw Harness::Failure(harnessMsg.str()); } } while(false)
+
+#define CHECK_THROWS(expr) \
+	do { bool harnessThrew = false; \
+		try { expr; } catch(...) { harnessThrew = true; } \
+		if(!harnessThrew) { \
+		std::ostringstream harnessMsg; \
+		harnessMsg << __FILE__ << ":" << __LINE__ << ": CHECK_THROWS(" #expr ") did not throw"; \
+		throw Harness::Failure(harnessMsg.str()); } } while(false)
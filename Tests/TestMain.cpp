@@ -0,0 +1,227 @@
+//***************************************************************************************
+// TestMain.cpp
+//
+// Entry point of framework_tests and the global allocation hooks behind the
+// harness' heap statistics.
+//***************************************************************************************
+
+#include "TestHarness.h"
+#include "ThreadPool.h"
+#include "Waves.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+namespace
+{
+	std::atomic<std::uint64_t> gAllocationCount{ 0 };
+	std::atomic<std::size_t> gLiveBytes{ 0 };
+	std::atomic<std::size_t> gPeakBytes{ 0 };
+
+	// Every block carries its size and the pointer malloc returned just below the
+	// address handed out, which also lets the aligned operators share one path.
+	const std::size_t HeaderBytes = 2*sizeof(void*);
+
+	void* Allocate(std::size_t size, std::size_t alignment)
+	{
+		alignment = alignment < HeaderBytes ? HeaderBytes : alignment;
+
+		void* raw = std::malloc(size + HeaderBytes + alignment);
+		if(raw == nullptr)
+			return nullptr;
+
+		std::uintptr_t address = ((std::uintptr_t)raw + HeaderBytes + alignment - 1) & ~(std::uintptr_t)(alignment - 1);
+		void** header = (void**)address;
+		header[-1] = raw;
+		header[-2] = (void*)size;
+
+		++gAllocationCount;
+		std::size_t live = gLiveBytes += size;
+		std::size_t peak = gPeakBytes.load();
+		while(live > peak && !gPeakBytes.compare_exchange_weak(peak, live))
+			;
+
+		return header;
+	}
+
+	void* AllocateOrThrow(std::size_t size, std::size_t alignment)
+	{
+		void* p = Allocate(size, alignment);
+		if(p == nullptr)
+			throw std::bad_alloc();
+		return p;
+	}
+
+	void Free(void* p)
+	{
+		if(p == nullptr)
+			return;
+
+		void** header = (void**)p;
+		gLiveBytes -= (std::size_t)header[-2];
+		std::free(header[-1]);
+	}
+
+	struct Entry
+	{
+		const char* Name;
+		Harness::TestFn Test;
+		Harness::BenchmarkFn Benchmark;
+	};
+
+	std::vector<Entry>& Tests()
+	{
+		static std::vector<Entry> tests;
+		return tests;
+	}
+
+	std::vector<Entry>& Benchmarks()
+	{
+		static std::vector<Entry> benchmarks;
+		return benchmarks;
+	}
+
+	bool Matches(const char* name, const char* filter)
+	{
+		return filter == nullptr || std::strstr(name, filter) != nullptr;
+	}
+
+	std::string JsonNumber(double value)
+	{
+		char buffer[64];
+		std::snprintf(buffer, sizeof(buffer), "%.6g", value);
+		return buffer;
+	}
+}
+
+void* operator new(std::size_t size) { return AllocateOrThrow(size, 0); }
+void* operator new[](std::size_t size) { return AllocateOrThrow(size, 0); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return Allocate(size, 0); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return Allocate(size, 0); }
+void* operator new(std::size_t size, std::align_val_t al) { return AllocateOrThrow(size, (std::size_t)al); }
+void* operator new[](std::size_t size, std::align_val_t al) { return AllocateOrThrow(size, (std::size_t)al); }
+void operator delete(void* p) noexcept { Free(p); }
+void operator delete[](void* p) noexcept { Free(p); }
+void operator delete(void* p, std::size_t) noexcept { Free(p); }
+void operator delete[](void* p, std::size_t) noexcept { Free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { Free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { Free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { Free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { Free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { Free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { Free(p); }
+
+namespace Harness
+{
+	Registrar::Registrar(const char* name, TestFn fn)
+	{
+		Tests().push_back({ name, fn, nullptr });
+	}
+
+	Registrar::Registrar(const char* name, BenchmarkFn fn)
+	{
+		Benchmarks().push_back({ name, nullptr, fn });
+	}
+
+	std::uint64_t AllocationCount()
+	{
+		return gAllocationCount.load();
+	}
+
+	std::size_t LiveHeapBytes()
+	{
+		return gLiveBytes.load();
+	}
+
+	std::size_t ResetPeakHeapBytes()
+	{
+		return gPeakBytes.exchange(gLiveBytes.load());
+	}
+
+	void BenchmarkReporter::Add(const std::string& name, const std::vector<Field>& fields)
+	{
+		std::string json = "{\"name\": \"" + name + "\"";
+		for(const Field& field : fields)
+			json += ", \"" + field.first + "\": " + JsonNumber(field.second);
+		json += "}";
+		mResults.push_back(json);
+	}
+
+	void BenchmarkReporter::Add(const std::string& name, const Measurement& m, std::vector<Field> fields)
+	{
+		fields.insert(fields.begin(), {
+			{ "calls", (double)m.Calls },
+			{ "ns_per_call", m.SecondsPerCall*1.0e9 },
+			{ "allocations_per_call", m.AllocationsPerCall },
+			{ "peak_heap_bytes", (double)m.PeakHeapBytes } });
+		Add(name, fields);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bool bench = false;
+	const char* filter = nullptr;
+	for(int i = 1; i < argc; ++i)
+	{
+		if(std::strcmp(argv[i], "-bench") == 0)
+			bench = true;
+		else if(std::strcmp(argv[i], "-filter") == 0 && i + 1 < argc)
+			filter = argv[++i];
+		else if(bench && filter == nullptr)
+			filter = argv[i];
+		else
+		{
+			std::fprintf(stderr, "usage: %s [-filter <text>] | -bench [<text>]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if(bench)
+	{
+		Harness::BenchmarkReporter reporter;
+		for(const Entry& entry : Benchmarks())
+		{
+			if(!Matches(entry.Name, filter))
+				continue;
+
+			std::fprintf(stderr, "running %s\n", entry.Name);
+			entry.Benchmark(reporter);
+		}
+
+		std::cout << "{\n  \"simd\": \"" << Waves::SimdPath() << "\",\n"
+			<< "  \"threads\": " << ThreadPool::Shared().ThreadCount() << ",\n"
+			<< "  \"benchmarks\": [";
+		const auto& results = reporter.Results();
+		for(std::size_t i = 0; i < results.size(); ++i)
+			std::cout << (i ? ",\n    " : "\n    ") << results[i];
+		std::cout << "\n  ]\n}\n";
+		return 0;
+	}
+
+	int failed = 0;
+	int run = 0;
+	for(const Entry& entry : Tests())
+	{
+		if(!Matches(entry.Name, filter))
+			continue;
+
+		++run;
+		try
+		{
+			entry.Test();
+			std::printf("[  OK  ] %s\n", entry.Name);
+		}
+		catch(const std::exception& e)
+		{
+			++failed;
+			std::printf("[ FAIL ] %s\n         %s\n", entry.Name, e.what());
+		}
+	}
+
+	std::printf("%d/%d tests passed\n", run - failed, run);
+	return failed == 0 ? 0 : 1;
+}
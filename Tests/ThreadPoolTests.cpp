@@ -0,0 +1,65 @@
+//***************************************************************************************
+// ThreadPoolTests.cpp
+//***************************************************************************************
+
+#include "TestHarness.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+TEST_CASE(ThreadPool_ParallelForCoversRangeOnce)
+{
+	ThreadPool pool(3);
+
+	std::vector<std::atomic<int>> hits(1000);
+	pool.ParallelFor(7, 1000, 13, [&](int begin, int end)
+	{
+		CHECK(end - begin <= 13);
+		for(int i = begin; i < end; ++i)
+			++hits[i];
+	});
+
+	for(int i = 0; i < 1000; ++i)
+		CHECK(hits[i].load() == (i >= 7 ? 1 : 0));
+}
+
+TEST_CASE(ThreadPool_NestedParallelForRunsInline)
+{
+	ThreadPool pool(3);
+
+	std::atomic<int> total{ 0 };
+	pool.ParallelFor(0, 64, 1, [&](int begin, int end)
+	{
+		for(int i = begin; i < end; ++i)
+		{
+			pool.ParallelFor(0, 10, 1, [&](int b, int e)
+			{
+				total += e - b;
+			});
+		}
+	});
+
+	CHECK(total.load() == 640);
+}
+
+TEST_CASE(ThreadPool_ParallelForRethrowsOnCaller)
+{
+	ThreadPool pool(3);
+
+	std::atomic<int> chunks{ 0 };
+	CHECK_THROWS(pool.ParallelFor(0, 1000, 1, [&](int begin, int)
+	{
+		++chunks;
+		if(begin == 500)
+			throw std::runtime_error("chunk failed");
+	}));
+
+	// The pool is still usable and not stuck in nested mode.
+	std::atomic<int> total{ 0 };
+	pool.ParallelFor(0, 100, 1, [&](int begin, int end)
+	{
+		total += end - begin;
+	});
+	CHECK(total.load() == 100);
+}
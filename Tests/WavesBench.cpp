@@ -0,0 +1,73 @@
+//***************************************************************************************
+// WavesBench.cpp
+//***************************************************************************************
+
+#include "TestHarness.h"
+#include "Waves.h"
+#include <cstring>
+#include <vector>
+
+BENCHMARK(Waves_Step)
+{
+	for(int size : { 128, 512, 2048 })
+	{
+		for(Waves::UpdateMode mode : { Waves::UpdateMode::TwoPass, Waves::UpdateMode::Tiled })
+		{
+			Waves waves(size, size, 1.0f, 0.03f, 4.0f, 0.2f);
+			waves.SetUpdateMode(mode);
+			waves.Disturb(size/2, size/2, 1.0f);
+
+			// One fixed sub-step per call.
+			Harness::Measurement m = Harness::Measure([&]
+			{
+				waves.Update(0.03f);
+			});
+
+			double cells = (double)size*size;
+			reporter.Add("Waves::Update", m, {
+				{ "size", (double)size },
+				{ "tiled", mode == Waves::UpdateMode::Tiled ? 1.0 : 0.0 },
+				{ "cells_per_s", cells / m.SecondsPerCall } });
+		}
+	}
+}
+
+BENCHMARK(Waves_WriteVertices)
+{
+	const int size = 512;
+	Waves waves(size, size, 1.0f, 0.03f, 4.0f, 0.2f);
+	waves.Disturb(size/2, size/2, 1.0f);
+	for(int s = 0; s < 10; ++s)
+		waves.Update(0.03f);
+
+	std::vector<Waves::Vertex> buffer(waves.VertexCount());
+
+	// What UpdateWaves used to do: assemble each vertex from the accessors and copy it
+	// into the upload buffer one vertex at a time.
+	Harness::Measurement perVertex = Harness::Measure([&]
+	{
+		Waves::Vertex* dst = buffer.data();
+		for(int i = 0; i < waves.VertexCount(); ++i)
+		{
+			Waves::Vertex v;
+			v.Pos = waves.Position(i);
+			v.Normal = waves.Normal(i);
+			v.TexC.x = 0.5f + v.Pos.x / waves.Width();
+			v.TexC.y = 0.5f - v.Pos.z / waves.Depth();
+			std::memcpy(&dst[i], &v, sizeof(Waves::Vertex));
+		}
+	});
+
+	Harness::Measurement streamed = Harness::Measure([&]
+	{
+		waves.WriteVertices(buffer.data());
+	});
+
+	const double vertices = (double)waves.VertexCount();
+	reporter.Add("Waves per-vertex copy", perVertex, {
+		{ "size", (double)size },
+		{ "vertices_per_s", vertices / perVertex.SecondsPerCall } });
+	reporter.Add("Waves::WriteVertices", streamed, {
+		{ "size", (double)size },
+		{ "vertices_per_s", vertices / streamed.SecondsPerCall } });
+}
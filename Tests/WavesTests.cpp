@@ -0,0 +1,189 @@
+//***************************************************************************************
+// WavesTests.cpp
+//***************************************************************************************
+
+#include "TestHarness.h"
+#include "Waves.h"
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// The solver as it was before the SoA height planes: one height per grid point,
+	// a scalar stencil, and normals and tangents from central differences.  Update
+	// always takes one step.
+	class ReferenceWaves
+	{
+	public:
+		ReferenceWaves(int m, int n, float dx, float dt, float speed, float damping)
+			: mNumRows(m), mNumCols(n), mSpatialStep(dx), mPrev(m*n), mCurr(m*n),
+			mNormals(m*n, XMFLOAT3(0.0f, 1.0f, 0.0f)), mTangentX(m*n, XMFLOAT3(1.0f, 0.0f, 0.0f))
+		{
+			float d = damping*dt + 2.0f;
+			float e = (speed*speed)*(dt*dt) / (dx*dx);
+			mK1 = (damping*dt - 2.0f) / d;
+			mK2 = (4.0f - 8.0f*e) / d;
+			mK3 = (2.0f*e) / d;
+		}
+
+		int RowCount()const { return mNumRows; }
+		int ColumnCount()const { return mNumCols; }
+		float Height(int i)const { return mCurr[i]; }
+		const XMFLOAT3& Normal(int i)const { return mNormals[i]; }
+		const XMFLOAT3& TangentX(int i)const { return mTangentX[i]; }
+
+		void Update(float)
+		{
+			const int n = mNumCols;
+			for(int i = 1; i < mNumRows - 1; ++i)
+			{
+				for(int j = 1; j < n - 1; ++j)
+				{
+					mPrev[i*n + j] = mK1*mPrev[i*n + j] + mK2*mCurr[i*n + j] +
+						mK3*(mCurr[(i + 1)*n + j] + mCurr[(i - 1)*n + j] + mCurr[i*n + j + 1] + mCurr[i*n + j - 1]);
+				}
+			}
+			std::swap(mPrev, mCurr);
+
+			for(int i = 1; i < mNumRows - 1; ++i)
+			{
+				for(int j = 1; j < n - 1; ++j)
+				{
+					float l = mCurr[i*n + j - 1];
+					float r = mCurr[i*n + j + 1];
+					float t = mCurr[(i - 1)*n + j];
+					float b = mCurr[(i + 1)*n + j];
+					mNormals[i*n + j] = Normalize(XMFLOAT3(-r + l, 2.0f*mSpatialStep, b - t));
+					mTangentX[i*n + j] = Normalize(XMFLOAT3(2.0f*mSpatialStep, r - l, 0.0f));
+				}
+			}
+		}
+
+		void Disturb(int i, int j, float magnitude)
+		{
+			const int n = mNumCols;
+			mCurr[i*n + j] += magnitude;
+			mCurr[i*n + j + 1] += 0.5f*magnitude;
+			mCurr[i*n + j - 1] += 0.5f*magnitude;
+			mCurr[(i + 1)*n + j] += 0.5f*magnitude;
+			mCurr[(i - 1)*n + j] += 0.5f*magnitude;
+		}
+
+	private:
+		static XMFLOAT3 Normalize(const XMFLOAT3& v)
+		{
+			float length = std::sqrt(v.x*v.x + v.y*v.y + v.z*v.z);
+			return XMFLOAT3(v.x / length, v.y / length, v.z / length);
+		}
+
+		int mNumRows;
+		int mNumCols;
+		float mSpatialStep;
+		float mK1 = 0.0f;
+		float mK2 = 0.0f;
+		float mK3 = 0.0f;
+		std::vector<float> mPrev;
+		std::vector<float> mCurr;
+		std::vector<XMFLOAT3> mNormals;
+		std::vector<XMFLOAT3> mTangentX;
+	};
+
+	// Disturbs at fixed fractions of the grid, which stay inside the boundary for any
+	// grid of at least 25x25.
+	template<typename WavesT>
+	void Simulate(WavesT& waves, int steps)
+	{
+		const int m = waves.RowCount();
+		const int n = waves.ColumnCount();
+
+		waves.Disturb(m*2/13, n/5, 1.0f);
+		waves.Disturb(m*7/13, n*3/5, 0.5f);
+		for(int s = 0; s < steps; ++s)
+		{
+			waves.Update(0.03f);
+			if(s == steps/2)
+				waves.Disturb(m*10/13, n*2/25, -0.75f);
+		}
+	}
+
+	bool SameSolution(const Waves& a, const Waves& b)
+	{
+		if(std::memcmp(a.Heights(), b.Heights(), sizeof(float)*a.RowCount()*a.RowPitch()) != 0)
+			return false;
+
+		for(int i = 0; i < a.VertexCount(); ++i)
+		{
+			if(std::memcmp(&a.Normal(i), &b.Normal(i), sizeof(DirectX::XMFLOAT3)) != 0 ||
+				std::memcmp(&a.TangentX(i), &b.TangentX(i), sizeof(DirectX::XMFLOAT3)) != 0)
+				return false;
+		}
+		return true;
+	}
+}
+
+TEST_CASE(Waves_MatchesScalarReference)
+{
+	// 61 columns, so every row ends in a partial SIMD register.
+	Waves waves(45, 61, 1.0f, 0.03f, 4.0f, 0.2f);
+	ReferenceWaves reference(45, 61, 1.0f, 0.03f, 4.0f, 0.2f);
+	Simulate(waves, 150);
+	Simulate(reference, 150);
+
+	// The kernels may contract to FMA, so allow for rounding.
+	for(int i = 0; i < waves.VertexCount(); ++i)
+	{
+		CHECK_NEAR(waves.Height(i), reference.Height(i), 1.0e-4);
+		CHECK_NEAR(waves.Normal(i).x, reference.Normal(i).x, 1.0e-4);
+		CHECK_NEAR(waves.Normal(i).y, reference.Normal(i).y, 1.0e-4);
+		CHECK_NEAR(waves.Normal(i).z, reference.Normal(i).z, 1.0e-4);
+		CHECK_NEAR(waves.TangentX(i).x, reference.TangentX(i).x, 1.0e-4);
+		CHECK_NEAR(waves.TangentX(i).y, reference.TangentX(i).y, 1.0e-4);
+	}
+}
+
+TEST_CASE(Waves_SleepingIsOffByDefault)
+{
+	Waves waves(64, 64, 1.0f, 0.03f, 4.0f, 0.2f);
+	CHECK(waves.SleepEpsilon() <= 0.0f);
+
+	waves.Update(0.03f);
+	CHECK(waves.ActiveTileCount() == 16);
+}
+
+TEST_CASE(Waves_TiledMatchesTwoPass)
+{
+	for(float epsilon : { 0.0f, 1.0e-4f })
+	{
+		Waves tiled(130, 150, 1.0f, 0.03f, 4.0f, 0.2f);
+		Waves twoPass(130, 150, 1.0f, 0.03f, 4.0f, 0.2f);
+		tiled.SetUpdateMode(Waves::UpdateMode::Tiled);
+		twoPass.SetUpdateMode(Waves::UpdateMode::TwoPass);
+		tiled.SetSleepEpsilon(epsilon);
+		twoPass.SetSleepEpsilon(epsilon);
+
+		Simulate(tiled, 200);
+		Simulate(twoPass, 200);
+
+		CHECK(SameSolution(tiled, twoPass));
+	}
+}
+
+TEST_CASE(Waves_WriteVerticesMatchesAccessors)
+{
+	Waves waves(40, 56, 1.0f, 0.03f, 4.0f, 0.2f);
+	Simulate(waves, 20);
+
+	std::vector<Waves::Vertex> vertices(waves.VertexCount());
+	waves.WriteVertices(vertices.data());
+
+	for(int i = 0; i < waves.VertexCount(); ++i)
+	{
+		DirectX::XMFLOAT3 p = waves.Position(i);
+		CHECK(vertices[i].Pos.x == p.x && vertices[i].Pos.y == p.y && vertices[i].Pos.z == p.z);
+		CHECK(vertices[i].Normal.y == waves.Normal(i).y);
+		CHECK(vertices[i].TexC.x >= 0.0f && vertices[i].TexC.x <= 1.0f);
+	}
+}
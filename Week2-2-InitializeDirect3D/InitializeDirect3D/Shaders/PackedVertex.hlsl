@@ -0,0 +1,27 @@
+//***************************************************************************************
+// PackedVertex.hlsl
+//
+// Decodes the 16 byte PackedVertex from Common/PackedVertex.h.  Bind the stream as
+//   POSITION R16G16B16A16_UNORM, NORMAL R16G16_SNORM, TEXCOORD R16G16_FLOAT
+// and pass the mesh's PositionQuantization Scale/Bias in a constant buffer.
+//***************************************************************************************
+
+struct PackedVertexIn
+{
+    float4 PosQ    : POSITION;
+    float2 NormalQ : NORMAL;
+    float2 TexC    : TEXCOORD;
+};
+
+float3 DecodePackedPosition(float4 posQ, float3 scale, float3 bias)
+{
+    return posQ.xyz*scale + bias;
+}
+
+float3 DecodeOctahedral(float2 e)
+{
+    float3 n = float3(e, 1.0f - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.xy += (n.xy >= 0.0f) ? -t : t;
+    return normalize(n);
+}
@@ -0,0 +1,75 @@
+//***************************************************************************************
+// Terrain.hlsl
+//
+// CDLOD terrain vertex shader (see Common/TerrainQuadtree.h).  Every selected node
+// draws the same unit grid patch; the node constants place and scale it, heights
+// and normals come from the baked height buffer, and vertices slide onto the next
+// coarser grid as they approach the end of the node's LOD range.  Lighting uses
+// the PS from Default.hlsl.
+//***************************************************************************************
+
+#include "Default.hlsl"
+
+Buffer<float> gTerrainHeights : register(t1);
+
+// Root constants, set per node.
+cbuffer cbTerrainNode : register(b3)
+{
+	float2 gNodeOrigin;      // world xz of the node's minimum corner
+	float  gNodeSize;
+	float  gPatchResolution; // quads along a patch edge
+	float  gMorphStart;
+	float  gMorphEnd;
+	float  gHeightmapSize;   // world size covered by gTerrainHeights
+	uint   gHeightmapDim;    // samples along an edge of gTerrainHeights
+	float2 gHeightmapOrigin;
+};
+
+// Bilinear height at world xz.  Row 0 of the buffer is at the minimum z.
+float TerrainHeight(float2 posW)
+{
+	float2 uv = saturate((posW - gHeightmapOrigin) / gHeightmapSize) * (gHeightmapDim - 1);
+	uint2 i0 = min((uint2)uv, gHeightmapDim - 2);
+	float2 f = uv - i0;
+
+	uint i = i0.y*gHeightmapDim + i0.x;
+	float h00 = gTerrainHeights[i];
+	float h10 = gTerrainHeights[i + 1];
+	float h01 = gTerrainHeights[i + gHeightmapDim];
+	float h11 = gTerrainHeights[i + gHeightmapDim + 1];
+
+	return lerp(lerp(h00, h10, f.x), lerp(h01, h11, f.x), f.y);
+}
+
+VertexOut TerrainVS(VertexIn vin)
+{
+	VertexOut vout = (VertexOut)0.0f;
+
+	// The patch spans [-0.5, 0.5] in x and z.
+	float2 gridPos = vin.PosL.xz + 0.5f;
+	float2 posW = gNodeOrigin + gridPos*gNodeSize;
+
+	// Odd vertices move onto the midpoint of their coarser neighbours, so at
+	// gMorphEnd the node matches its parent exactly.
+	float distance = length(float3(posW.x, TerrainHeight(posW), posW.y) - gEyePosW);
+	float morph = saturate((distance - gMorphStart) / (gMorphEnd - gMorphStart));
+	float2 offset = frac(gridPos*gPatchResolution*0.5f)*2.0f/gPatchResolution;
+	posW -= offset*gNodeSize*morph;
+
+	float step = gHeightmapSize / (gHeightmapDim - 1);
+	float hl = TerrainHeight(posW - float2(step, 0.0f));
+	float hr = TerrainHeight(posW + float2(step, 0.0f));
+	float hd = TerrainHeight(posW - float2(0.0f, step));
+	float hu = TerrainHeight(posW + float2(0.0f, step));
+
+	vout.PosW = float3(posW.x, TerrainHeight(posW), posW.y);
+	vout.NormalW = normalize(float3(hl - hr, 2.0f*step, hd - hu));
+	vout.PosH = mul(float4(vout.PosW, 1.0f), gViewProj);
+
+	// Same mapping as the old land grid, which was turned a quarter turn.
+	float2 texC = (posW.yx - gHeightmapOrigin.yx) / gHeightmapSize;
+	float4 texT = mul(float4(texC, 0.0f, 1.0f), gTexTransform);
+	vout.TexC = mul(texT, gMatTransform).xy;
+
+	return vout;
+}
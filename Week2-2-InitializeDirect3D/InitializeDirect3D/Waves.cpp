@@ -3,17 +3,100 @@
 //***************************************************************************************
 
 #include "Waves.h"
-#include <ppl.h>
+#include "../../Common/ThreadPool.h"
 #include <algorithm>
 #include <vector>
 #include <cassert>
+#include <cmath>
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define WAVES_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define WAVES_SIMD_SSE2 1
+#endif
 
 using namespace DirectX;
 
+namespace
+{
+	// Height rows are padded to a multiple of this many floats.
+	const int RowAlign = 8;
+
+	// Rows handed to a worker at a time.
+	const int RowGrain = 16;
+
+	// Working set budget of one tile in UpdateMode::Tiled.
+	const int TileBytes = 256 * 1024;
+
+	// Advances one row of the height field in place:
+	//   prev[j] = k1*prev[j] + k2*curr[j] + k3*(down + up + right + left)
+	// The scalar and SIMD versions evaluate the sum in the same order so they
+	// produce bit-identical results.
+	void StepRowScalar(float* prev, const float* curr, int pitch, int first, int last,
+		float k1, float k2, float k3)
+	{
+		for(int j = first; j < last; ++j)
+		{
+			prev[j] = k1*prev[j] + k2*curr[j] +
+				k3*(curr[j + pitch] + curr[j - pitch] + curr[j + 1] + curr[j - 1]);
+		}
+	}
+
+	void StepRow(float* prev, const float* curr, int pitch, int first, int last,
+		float k1, float k2, float k3)
+	{
+		int j = first;
+
+#if defined(WAVES_SIMD_AVX2)
+		const __m256 vk1 = _mm256_set1_ps(k1);
+		const __m256 vk2 = _mm256_set1_ps(k2);
+		const __m256 vk3 = _mm256_set1_ps(k3);
+		for(; j + 8 <= last; j += 8)
+		{
+			__m256 sum = _mm256_add_ps(_mm256_loadu_ps(curr + j + pitch), _mm256_loadu_ps(curr + j - pitch));
+			sum = _mm256_add_ps(sum, _mm256_loadu_ps(curr + j + 1));
+			sum = _mm256_add_ps(sum, _mm256_loadu_ps(curr + j - 1));
+
+			__m256 h = _mm256_add_ps(
+				_mm256_mul_ps(vk1, _mm256_loadu_ps(prev + j)),
+				_mm256_mul_ps(vk2, _mm256_loadu_ps(curr + j)));
+			h = _mm256_add_ps(h, _mm256_mul_ps(vk3, sum));
+			_mm256_storeu_ps(prev + j, h);
+		}
+#elif defined(WAVES_SIMD_SSE2)
+		const __m128 vk1 = _mm_set1_ps(k1);
+		const __m128 vk2 = _mm_set1_ps(k2);
+		const __m128 vk3 = _mm_set1_ps(k3);
+		for(; j + 4 <= last; j += 4)
+		{
+			__m128 sum = _mm_add_ps(_mm_loadu_ps(curr + j + pitch), _mm_loadu_ps(curr + j - pitch));
+			sum = _mm_add_ps(sum, _mm_loadu_ps(curr + j + 1));
+			sum = _mm_add_ps(sum, _mm_loadu_ps(curr + j - 1));
+
+			__m128 h = _mm_add_ps(
+				_mm_mul_ps(vk1, _mm_loadu_ps(prev + j)),
+				_mm_mul_ps(vk2, _mm_loadu_ps(curr + j)));
+			h = _mm_add_ps(h, _mm_mul_ps(vk3, sum));
+			_mm_storeu_ps(prev + j, h);
+		}
+#endif
+
+		// Remainder of the row (or the whole row without SIMD).
+		StepRowScalar(prev, curr, pitch, j, last, k1, k2, k3);
+	}
+}
+
 Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
 {
     mNumRows = m;
     mNumCols = n;
+	mRowPitch = (n + RowAlign - 1) / RowAlign * RowAlign;
+
+	// Per row a tile touches both height planes plus the normal and tangent rows.
+	int rowBytes = 2*mRowPitch*(int)sizeof(float) + 2*n*(int)sizeof(XMFLOAT3);
+	mTileRows = std::max(4, TileBytes / rowBytes);
 
     mVertexCount = m*n;
     mTriangleCount = (m - 1)*(n - 1) * 2;
@@ -27,28 +110,41 @@ Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
     mK2 = (4.0f - 8.0f*e) / d;
     mK3 = (2.0f*e) / d;
 
-    mPrevSolution.resize(m*n);
-    mCurrSolution.resize(m*n);
-    mNormals.resize(m*n);
-    mTangentX.resize(m*n);
+    mPrevHeights.assign(m*mRowPitch, 0.0f);
+    mCurrHeights.assign(m*mRowPitch, 0.0f);
+    mNormals.assign(m*n, XMFLOAT3(0.0f, 1.0f, 0.0f));
+    mTangentX.assign(m*n, XMFLOAT3(1.0f, 0.0f, 0.0f));
+
+	mTileRowCount = (m + RegionTileSize - 1) / RegionTileSize;
+	mTileColCount = (n + RegionTileSize - 1) / RegionTileSize;
+	mTileLive.assign(mTileRowCount*mTileColCount, 0);
+	mTileActive.assign(mTileRowCount*mTileColCount, 0);
+	mTileFramesDirty.assign(mTileRowCount*mTileColCount, mFrameResourceCount);
 
-    // Generate grid vertices in system memory.
+    // Generate grid coordinates in system memory.
 
     float halfWidth = (n - 1)*dx*0.5f;
     float halfDepth = (m - 1)*dx*0.5f;
-    for(int i = 0; i < m; ++i)
-    {
-        float z = halfDepth - i*dx;
-        for(int j = 0; j < n; ++j)
-        {
-            float x = -halfWidth + j*dx;
 
-            mPrevSolution[i*n + j] = XMFLOAT3(x, 0.0f, z);
-            mCurrSolution[i*n + j] = XMFLOAT3(x, 0.0f, z);
-            mNormals[i*n + j] = XMFLOAT3(0.0f, 1.0f, 0.0f);
-            mTangentX[i*n + j] = XMFLOAT3(1.0f, 0.0f, 0.0f);
-        }
-    }
+	mColumnX.resize(n);
+	for(int j = 0; j < n; ++j)
+		mColumnX[j] = -halfWidth + j*dx;
+
+	mRowZ.resize(m);
+	for(int i = 0; i < m; ++i)
+		mRowZ[i] = halfDepth - i*dx;
+
+	// Derive tex-coords from position by 
+	// mapping [-w/2,w/2] --> [0,1]
+	mTexC.resize(m*n);
+	for(int i = 0; i < m; ++i)
+	{
+		for(int j = 0; j < n; ++j)
+		{
+			mTexC[i*n + j].x = 0.5f + mColumnX[j] / Width();
+			mTexC[i*n + j].y = 0.5f - mRowZ[i] / Depth();
+		}
+	}
 }
 
 Waves::~Waves()
@@ -85,72 +181,500 @@ float Waves::Depth()const
 	return mNumRows*mSpatialStep;
 }
 
-void Waves::Update(float dt)
+const char* Waves::SimdPath()
+{
+#if defined(WAVES_SIMD_AVX2)
+	return "avx2";
+#elif defined(WAVES_SIMD_SSE2)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
+
+void Waves::WriteVertices(Vertex* dst)const
+{
+	ThreadPool::Shared().ParallelFor(0, mNumRows, RowGrain, [this, dst](int firstRow, int lastRow)
+	{
+		for(int i = firstRow; i < lastRow; ++i)
+		{
+			const float* h = &mCurrHeights[i*mRowPitch];
+			const XMFLOAT3* normals = &mNormals[i*mNumCols];
+			const XMFLOAT2* texC = &mTexC[i*mNumCols];
+			Vertex* out = dst + i*mNumCols;
+
+			const float z = mRowZ[i];
+			for(int j = 0; j < mNumCols; ++j)
+			{
+				// Assemble the whole vertex first so the destination only sees
+				// sequential full writes.
+				Vertex v;
+				v.Pos = XMFLOAT3(mColumnX[j], h[j], z);
+				v.Normal = normals[j];
+				v.TexC = texC[j];
+				out[j] = v;
+			}
+		}
+	});
+}
+
+int Waves::WriteDirtyVertices(Vertex* dst, std::vector<ByteRange>* dirtyRanges)
+{
+	if(dirtyRanges)
+		dirtyRanges->clear();
+
+	// Rows of tiles are written in parallel; each writes the dirty tile spans of its rows.
+	ThreadPool::Shared().ParallelFor(0, mTileRowCount, 1, [this, dst](int firstTileRow, int lastTileRow)
+	{
+		for(int tr = firstTileRow; tr < lastTileRow; ++tr)
+		{
+			const int* framesDirty = &mTileFramesDirty[tr*mTileColCount];
+
+			int r0 = tr*RegionTileSize;
+			int r1 = std::min(r0 + RegionTileSize, mNumRows);
+			for(int i = r0; i < r1; ++i)
+			{
+				const float* h = &mCurrHeights[i*mRowPitch];
+				const XMFLOAT3* normals = &mNormals[i*mNumCols];
+				const XMFLOAT2* texC = &mTexC[i*mNumCols];
+				Vertex* out = dst + i*mNumCols;
+				const float z = mRowZ[i];
+
+				for(int tc = 0; tc < mTileColCount; ++tc)
+				{
+					if(framesDirty[tc] == 0)
+						continue;
+
+					int c0 = tc*RegionTileSize;
+					int c1 = std::min(c0 + RegionTileSize, mNumCols);
+					for(int j = c0; j < c1; ++j)
+					{
+						Vertex v;
+						v.Pos = XMFLOAT3(mColumnX[j], h[j], z);
+						v.Normal = normals[j];
+						v.TexC = texC[j];
+						out[j] = v;
+					}
+				}
+			}
+		}
+	});
+
+	// Report what was written and retire one buffer's worth of dirtiness.
+	int written = 0;
+	for(int tr = 0; tr < mTileRowCount; ++tr)
+	{
+		int r0 = tr*RegionTileSize;
+		int r1 = std::min(r0 + RegionTileSize, mNumRows);
+
+		for(int tc = 0; tc < mTileColCount; )
+		{
+			if(mTileFramesDirty[tr*mTileColCount + tc] == 0)
+			{
+				++tc;
+				continue;
+			}
+
+			// Span of consecutive dirty tiles in this tile row.
+			int firstTile = tc;
+			while(tc < mTileColCount && mTileFramesDirty[tr*mTileColCount + tc] > 0)
+				--mTileFramesDirty[tr*mTileColCount + tc++];
+
+			int c0 = firstTile*RegionTileSize;
+			int c1 = std::min(tc*RegionTileSize, mNumCols);
+			written += (r1 - r0)*(c1 - c0);
+
+			if(dirtyRanges == nullptr)
+				continue;
+
+			for(int i = r0; i < r1; ++i)
+			{
+				ByteRange range = { (std::size_t)(i*mNumCols + c0)*sizeof(Vertex), (std::size_t)(c1 - c0)*sizeof(Vertex) };
+
+				// Full-width spans on consecutive rows merge into one range.
+				if(!dirtyRanges->empty() && dirtyRanges->back().Offset + dirtyRanges->back().Size == range.Offset)
+					dirtyRanges->back().Size += range.Size;
+				else
+					dirtyRanges->push_back(range);
+			}
+		}
+	}
+
+	return written;
+}
+
+void Waves::SetFrameResourceCount(int count)
 {
-	static float t = 0;
+	mFrameResourceCount = std::max(count, 1);
+	std::fill(mTileFramesDirty.begin(), mTileFramesDirty.end(), mFrameResourceCount);
+}
 
+int Waves::Update(float dt)
+{
 	// Accumulate time.
-	t += dt;
+	mAccumulator += dt;
 
 	// Only update the simulation at the specified time step.
-	if( t >= mTimeStep )
+	int steps = 0;
+	while(mAccumulator >= mTimeStep && steps < mMaxSubSteps)
+	{
+		if(mSleepEpsilon > 0.0f)
+			StepActiveTiles();
+		else
+		{
+			if(mUpdateMode == UpdateMode::Tiled)
+				StepTiled();
+			else
+				StepTwoPass();
+
+			// Everything moved.
+			mActiveTileCount = mTileRowCount*mTileColCount;
+			std::fill(mTileActive.begin(), mTileActive.end(), (std::uint8_t)1);
+			std::fill(mTileLive.begin(), mTileLive.end(), (std::uint8_t)1);
+			std::fill(mTileFramesDirty.begin(), mTileFramesDirty.end(), mFrameResourceCount);
+		}
+
+		mAccumulator -= mTimeStep;
+		++steps;
+	}
+
+	// Hit the cap: drop the whole steps we could not afford and keep the remainder.
+	if(mAccumulator >= mTimeStep)
+		mAccumulator = fmodf(mAccumulator, mTimeStep);
+
+	mAlpha = mAccumulator / mTimeStep;
+
+	return steps;
+}
+
+void Waves::StepTwoPass()
+{
+	// Only update interior points; we use zero boundary conditions.
+	ThreadPool::Shared().ParallelFor(1, mNumRows - 1, RowGrain, [this](int firstRow, int lastRow)
+	{
+		StepRows(firstRow, lastRow);
+	});
+
+	// We just overwrote the previous buffer with the new data, so
+	// this data needs to become the current solution and the old
+	// current solution becomes the new previous solution.
+	std::swap(mPrevHeights, mCurrHeights);
+
+	//
+	// Compute normals using finite difference scheme.
+	//
+	ThreadPool::Shared().ParallelFor(1, mNumRows - 1, RowGrain, [this](int firstRow, int lastRow)
+	{
+		for(int i = firstRow; i < lastRow; ++i)
+			ComputeNormalsRow(&mCurrHeights[i*mRowPitch], i, 1, mNumCols - 1);
+	});
+}
+
+void Waves::StepTiled()
+{
+	// The interior rows are split into bands of mTileRows.  Each band advances its
+	// heights row by row and derives the normals one row behind, while the three rows
+	// involved are still in cache.  The first and last row of a band need a new height
+	// row owned by the neighbouring band (the halo), so they are finished in a second,
+	// much smaller pass once every band is done.
+	//
+	// New heights are written over mPrevHeights, so the normals read from there and the
+	// planes are swapped at the end.  Boundary rows are never written and hold the same
+	// values in both planes.
+	const int interiorRows = mNumRows - 2;
+	const int bandCount = (interiorRows + mTileRows - 1) / mTileRows;
+
+	ThreadPool::Shared().ParallelFor(0, bandCount, 1, [this](int firstBand, int lastBand)
+	{
+		for(int band = firstBand; band < lastBand; ++band)
+		{
+			int r0 = 1 + band*mTileRows;
+			int r1 = std::min(r0 + mTileRows, mNumRows - 1);
+
+			for(int i = r0; i < r1; ++i)
+			{
+				StepRows(i, i + 1);
+
+				if(i - 1 > r0)
+					ComputeNormalsRow(&mPrevHeights[(i - 1)*mRowPitch], i - 1, 1, mNumCols - 1);
+			}
+		}
+	});
+
+	ThreadPool::Shared().ParallelFor(0, bandCount, RowGrain, [this](int firstBand, int lastBand)
+	{
+		for(int band = firstBand; band < lastBand; ++band)
+		{
+			int r0 = 1 + band*mTileRows;
+			int r1 = std::min(r0 + mTileRows, mNumRows - 1);
+
+			ComputeNormalsRow(&mPrevHeights[r0*mRowPitch], r0, 1, mNumCols - 1);
+			if(r1 - 1 > r0)
+				ComputeNormalsRow(&mPrevHeights[(r1 - 1)*mRowPitch], r1 - 1, 1, mNumCols - 1);
+		}
+	});
+
+	std::swap(mPrevHeights, mCurrHeights);
+}
+
+void Waves::StepActiveTiles()
+{
+	// A wave front travels at most one grid point per step, so a tile needs stepping
+	// if it or one of its eight neighbours was live after the previous step.  Tiles
+	// that fall out of the active set are below epsilon; zero them so they are
+	// exactly at rest and the neighbours' stencils can keep reading them.
+	mActiveTiles.clear();
+	for(int tr = 0; tr < mTileRowCount; ++tr)
 	{
-		// Only update interior points; we use zero boundary conditions.
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
-		//for(int i = 1; i < mNumRows-1; ++i)
+		for(int tc = 0; tc < mTileColCount; ++tc)
 		{
-			for(int j = 1; j < mNumCols-1; ++j)
+			bool active = false;
+			for(int r = std::max(tr - 1, 0); r <= std::min(tr + 1, mTileRowCount - 1) && !active; ++r)
+				for(int c = std::max(tc - 1, 0); c <= std::min(tc + 1, mTileColCount - 1) && !active; ++c)
+					active = mTileLive[r*mTileColCount + c] != 0;
+
+			int tile = tr*mTileColCount + tc;
+			if(active)
+				mActiveTiles.push_back(tile);
+			else if(mTileActive[tile])
+				SleepTile(tile);
+
+			mTileActive[tile] = active ? 1 : 0;
+		}
+	}
+
+	mActiveTileCount = (int)mActiveTiles.size();
+	if(mActiveTiles.empty())
+		return;
+
+	if(mUpdateMode == UpdateMode::Tiled)
+		StepActiveTiled();
+	else
+		StepActiveTwoPass();
+
+	std::swap(mPrevHeights, mCurrHeights);
+}
+
+void Waves::StepActiveTwoPass()
+{
+	// Heights.  Every interior point is written by exactly one tile and the stencil
+	// only reads the current plane, so tiles can run in any order.
+	ThreadPool::Shared().ParallelFor(0, mActiveTileCount, 1, [this](int first, int last)
+	{
+		for(int k = first; k < last; ++k)
+		{
+			int tr = mActiveTiles[k] / mTileColCount;
+			int tc = mActiveTiles[k] - tr*mTileColCount;
+
+			int r0 = std::max(tr*RegionTileSize, 1);
+			int r1 = std::min((tr + 1)*RegionTileSize, mNumRows - 1);
+			int c0 = std::max(tc*RegionTileSize, 1);
+			int c1 = std::min((tc + 1)*RegionTileSize, mNumCols - 1);
+
+			for(int i = r0; i < r1; ++i)
 			{
-				// After this update we will be discarding the old previous
-				// buffer, so overwrite that buffer with the new update.
-				// Note how we can do this inplace (read/write to same element) 
-				// because we won't need prev_ij again and the assignment happens last.
-
-				// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
-				// Moreover, our +z axis goes "down"; this is just to 
-				// keep consistent with our row indices going down.
-
-				mPrevSolution[i*mNumCols+j].y = 
-					mK1*mPrevSolution[i*mNumCols+j].y +
-					mK2*mCurrSolution[i*mNumCols+j].y +
-					mK3*(mCurrSolution[(i+1)*mNumCols+j].y + 
-					     mCurrSolution[(i-1)*mNumCols+j].y + 
-					     mCurrSolution[i*mNumCols+j+1].y + 
-						 mCurrSolution[i*mNumCols+j-1].y);
+				StepRow(&mPrevHeights[i*mRowPitch], &mCurrHeights[i*mRowPitch], mRowPitch,
+					c0, c1, mK1, mK2, mK3);
 			}
-		});
+		}
+	});
 
-		// We just overwrote the previous buffer with the new data, so
-		// this data needs to become the current solution and the old
-		// current solution becomes the new previous solution.
-		std::swap(mPrevSolution, mCurrSolution);
+	// Normals need the new heights of neighbouring tiles, so they run after all the
+	// heights are in.  The same sweep measures each tile's remaining energy.
+	ThreadPool::Shared().ParallelFor(0, mActiveTileCount, 1, [this](int first, int last)
+	{
+		for(int k = first; k < last; ++k)
+		{
+			int tile = mActiveTiles[k];
+			int tr = tile / mTileColCount;
+			int tc = tile - tr*mTileColCount;
 
-		t = 0.0f; // reset time
+			int r0 = std::max(tr*RegionTileSize, 1);
+			int r1 = std::min((tr + 1)*RegionTileSize, mNumRows - 1);
+			int c0 = std::max(tc*RegionTileSize, 1);
+			int c1 = std::min((tc + 1)*RegionTileSize, mNumCols - 1);
 
-		//
-		// Compute normals using finite difference scheme.
-		//
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
-		//for(int i = 1; i < mNumRows - 1; ++i)
+			for(int i = r0; i < r1; ++i)
+				ComputeNormalsRow(&mPrevHeights[i*mRowPitch], i, c0, c1);
+
+			MeasureTile(tile);
+		}
+	});
+}
+
+void Waves::StepActiveTiled()
+{
+	// Same scheme as StepTiled, with a row of tiles as the band: the active tiles of a
+	// tile row are stepped one grid row at a time and their normals follow one row
+	// behind.  Horizontal neighbours are either stepped in the same row or asleep (zero
+	// in both planes), so only the first and last row of a band wait for the halo pass.
+	mActiveRowStart.clear();
+	for(int k = 0; k < mActiveTileCount; ++k)
+	{
+		if(k == 0 || mActiveTiles[k] / mTileColCount != mActiveTiles[k - 1] / mTileColCount)
+			mActiveRowStart.push_back(k);
+	}
+	mActiveRowStart.push_back(mActiveTileCount);
+
+	const int bandCount = (int)mActiveRowStart.size() - 1;
+
+	ThreadPool::Shared().ParallelFor(0, bandCount, 1, [this](int firstBand, int lastBand)
+	{
+		for(int band = firstBand; band < lastBand; ++band)
+		{
+			int k0 = mActiveRowStart[band];
+			int k1 = mActiveRowStart[band + 1];
+
+			int tr = mActiveTiles[k0] / mTileColCount;
+			int r0 = std::max(tr*RegionTileSize, 1);
+			int r1 = std::min((tr + 1)*RegionTileSize, mNumRows - 1);
+
+			for(int i = r0; i < r1; ++i)
+			{
+				for(int k = k0; k < k1; ++k)
+				{
+					int tc = mActiveTiles[k] - tr*mTileColCount;
+					int c0 = std::max(tc*RegionTileSize, 1);
+					int c1 = std::min((tc + 1)*RegionTileSize, mNumCols - 1);
+
+					StepRow(&mPrevHeights[i*mRowPitch], &mCurrHeights[i*mRowPitch], mRowPitch,
+						c0, c1, mK1, mK2, mK3);
+				}
+
+				if(i - 1 <= r0)
+					continue;
+
+				for(int k = k0; k < k1; ++k)
+				{
+					int tc = mActiveTiles[k] - tr*mTileColCount;
+					int c0 = std::max(tc*RegionTileSize, 1);
+					int c1 = std::min((tc + 1)*RegionTileSize, mNumCols - 1);
+
+					ComputeNormalsRow(&mPrevHeights[(i - 1)*mRowPitch], i - 1, c0, c1);
+				}
+			}
+		}
+	});
+
+	ThreadPool::Shared().ParallelFor(0, bandCount, 1, [this](int firstBand, int lastBand)
+	{
+		for(int band = firstBand; band < lastBand; ++band)
 		{
-			for(int j = 1; j < mNumCols-1; ++j)
+			int k0 = mActiveRowStart[band];
+			int k1 = mActiveRowStart[band + 1];
+
+			int tr = mActiveTiles[k0] / mTileColCount;
+			int r0 = std::max(tr*RegionTileSize, 1);
+			int r1 = std::min((tr + 1)*RegionTileSize, mNumRows - 1);
+
+			for(int k = k0; k < k1; ++k)
 			{
-				float l = mCurrSolution[i*mNumCols+j-1].y;
-				float r = mCurrSolution[i*mNumCols+j+1].y;
-				float t = mCurrSolution[(i-1)*mNumCols+j].y;
-				float b = mCurrSolution[(i+1)*mNumCols+j].y;
-				mNormals[i*mNumCols+j].x = -r+l;
-				mNormals[i*mNumCols+j].y = 2.0f*mSpatialStep;
-				mNormals[i*mNumCols+j].z = b-t;
-
-				XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&mNormals[i*mNumCols+j]));
-				XMStoreFloat3(&mNormals[i*mNumCols+j], n);
-
-				mTangentX[i*mNumCols+j] = XMFLOAT3(2.0f*mSpatialStep, r-l, 0.0f);
-				XMVECTOR T = XMVector3Normalize(XMLoadFloat3(&mTangentX[i*mNumCols+j]));
-				XMStoreFloat3(&mTangentX[i*mNumCols+j], T);
+				int tc = mActiveTiles[k] - tr*mTileColCount;
+				int c0 = std::max(tc*RegionTileSize, 1);
+				int c1 = std::min((tc + 1)*RegionTileSize, mNumCols - 1);
+
+				if(r1 > r0)
+					ComputeNormalsRow(&mPrevHeights[r0*mRowPitch], r0, c0, c1);
+				if(r1 - 1 > r0)
+					ComputeNormalsRow(&mPrevHeights[(r1 - 1)*mRowPitch], r1 - 1, c0, c1);
+
+				MeasureTile(mActiveTiles[k]);
 			}
-		});
+		}
+	});
+}
+
+void Waves::MeasureTile(int tile)
+{
+	// Largest height left in the tile across both time levels; the new solution is in
+	// mPrevHeights until the planes are swapped.
+	int tr = tile / mTileColCount;
+	int tc = tile - tr*mTileColCount;
+
+	int r0 = tr*RegionTileSize;
+	int r1 = std::min(r0 + RegionTileSize, mNumRows);
+	int c0 = tc*RegionTileSize;
+	int c1 = std::min(c0 + RegionTileSize, mNumCols);
+
+	float energy = 0.0f;
+	for(int i = r0; i < r1; ++i)
+	{
+		const float* newH = &mPrevHeights[i*mRowPitch];
+		const float* oldH = &mCurrHeights[i*mRowPitch];
+		for(int j = c0; j < c1; ++j)
+			energy = std::max(energy, std::max(fabsf(newH[j]), fabsf(oldH[j])));
+	}
+
+	mTileLive[tile] = energy > mSleepEpsilon ? 1 : 0;
+	mTileFramesDirty[tile] = mFrameResourceCount;
+}
+
+void Waves::SleepTile(int tile)
+{
+	int tr = tile / mTileColCount;
+	int tc = tile - tr*mTileColCount;
+
+	int r0 = tr*RegionTileSize;
+	int r1 = std::min(r0 + RegionTileSize, mNumRows);
+	int c0 = tc*RegionTileSize;
+	int c1 = std::min(c0 + RegionTileSize, mNumCols);
+
+	for(int i = r0; i < r1; ++i)
+	{
+		std::fill(&mPrevHeights[i*mRowPitch + c0], &mPrevHeights[i*mRowPitch + c1], 0.0f);
+		std::fill(&mCurrHeights[i*mRowPitch + c0], &mCurrHeights[i*mRowPitch + c1], 0.0f);
+		std::fill(&mNormals[i*mNumCols + c0], &mNormals[i*mNumCols + c1], XMFLOAT3(0.0f, 1.0f, 0.0f));
+		std::fill(&mTangentX[i*mNumCols + c0], &mTangentX[i*mNumCols + c1], XMFLOAT3(1.0f, 0.0f, 0.0f));
+	}
+
+	mTileLive[tile] = 0;
+	mTileFramesDirty[tile] = mFrameResourceCount;
+}
+
+void Waves::WakeTileAt(int i, int j)
+{
+	mTileLive[(i / RegionTileSize)*mTileColCount + j / RegionTileSize] = 1;
+}
+
+void Waves::StepRows(int firstRow, int lastRow)
+{
+	for(int i = firstRow; i < lastRow; ++i)
+	{
+		// After this update we will be discarding the old previous
+		// buffer, so overwrite that buffer with the new update.
+		// Note how we can do this inplace (read/write to same element) 
+		// because we won't need prev_ij again and the assignment happens last.
+
+		// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
+		// Moreover, our +z axis goes "down"; this is just to 
+		// keep consistent with our row indices going down.
+		StepRow(&mPrevHeights[i*mRowPitch], &mCurrHeights[i*mRowPitch], mRowPitch,
+			1, mNumCols - 1, mK1, mK2, mK3);
+	}
+}
+
+void Waves::ComputeNormalsRow(const float* h, int i, int firstCol, int lastCol)
+{
+	// h points at row i of the height plane holding the newest solution.
+	for(int j = firstCol; j < lastCol; ++j)
+	{
+		float l = h[j-1];
+		float r = h[j+1];
+		float t = h[j-mRowPitch];
+		float b = h[j+mRowPitch];
+
+		XMFLOAT3& normal = mNormals[i*mNumCols+j];
+		normal.x = -r+l;
+		normal.y = 2.0f*mSpatialStep;
+		normal.z = b-t;
+
+		XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&normal));
+		XMStoreFloat3(&normal, n);
+
+		XMFLOAT3& tangent = mTangentX[i*mNumCols+j];
+		tangent = XMFLOAT3(2.0f*mSpatialStep, r-l, 0.0f);
+		XMVECTOR T = XMVector3Normalize(XMLoadFloat3(&tangent));
+		XMStoreFloat3(&tangent, T);
 	}
 }
 
@@ -163,10 +687,48 @@ void Waves::Disturb(int i, int j, float magnitude)
 	float halfMag = 0.5f*magnitude;
 
 	// Disturb the ijth vertex height and its neighbors.
-	mCurrSolution[i*mNumCols+j].y     += magnitude;
-	mCurrSolution[i*mNumCols+j+1].y   += halfMag;
-	mCurrSolution[i*mNumCols+j-1].y   += halfMag;
-	mCurrSolution[(i+1)*mNumCols+j].y += halfMag;
-	mCurrSolution[(i-1)*mNumCols+j].y += halfMag;
+	float* h = &mCurrHeights[i*mRowPitch];
+	h[j]            += magnitude;
+	h[j+1]          += halfMag;
+	h[j-1]          += halfMag;
+	h[j+mRowPitch]  += halfMag;
+	h[j-mRowPitch]  += halfMag;
+
+	// The disturbance can straddle a tile edge.
+	WakeTileAt(i, j);
+	WakeTileAt(i-1, j);
+	WakeTileAt(i+1, j);
+	WakeTileAt(i, j-1);
+	WakeTileAt(i, j+1);
+}
+
+void Waves::DisturbBatch(const Impulse* impulses, int count)
+{
+	mSortedImpulses.assign(impulses, impulses + count);
+	std::stable_sort(mSortedImpulses.begin(), mSortedImpulses.end(), [](const Impulse& a, const Impulse& b)
+	{
+		return a.i < b.i || (a.i == b.i && a.j < b.j);
+	});
+
+	for(const Impulse& drop : mSortedImpulses)
+	{
+		// Don't disturb boundaries.
+		assert(drop.i > 1 && drop.i < mNumRows-2);
+		assert(drop.j > 1 && drop.j < mNumCols-2);
+
+		float halfMag = 0.5f*drop.Magnitude;
+
+		float* h = &mCurrHeights[drop.i*mRowPitch + drop.j];
+		h[0]          += drop.Magnitude;
+		h[1]          += halfMag;
+		h[-1]         += halfMag;
+		h[mRowPitch]  += halfMag;
+		h[-mRowPitch] += halfMag;
+
+		WakeTileAt(drop.i, drop.j);
+		WakeTileAt(drop.i-1, drop.j);
+		WakeTileAt(drop.i+1, drop.j);
+		WakeTileAt(drop.i, drop.j-1);
+		WakeTileAt(drop.i, drop.j+1);
+	}
 }
-	
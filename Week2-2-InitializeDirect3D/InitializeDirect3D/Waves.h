@@ -4,17 +4,61 @@
 // Performs the calculations for the wave simulation.  After the simulation has been
 // updated, the client must copy the current solution into vertex buffers for rendering.
 // This class only does the calculations, it does not do any drawing.
+//
+// Heights are kept as a structure-of-arrays float plane whose rows are padded to a
+// multiple of 8 floats (one AVX register), so the stencil runs on whole SIMD registers.
+// The x/z grid coordinates never change and are stored once per column/row.
 //***************************************************************************************
 
 #ifndef WAVES_H
 #define WAVES_H
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <DirectXMath.h>
 
 class Waves
 {
 public:
+	// Interleaved layout written by WriteVertices; matches the apps' Pos/Normal/TexC Vertex.
+	struct Vertex
+	{
+		DirectX::XMFLOAT3 Pos;
+		DirectX::XMFLOAT3 Normal;
+		DirectX::XMFLOAT2 TexC;
+	};
+
+	// One drop for DisturbBatch: adds Magnitude at grid point (i, j) and half of it at
+	// the four neighbours, exactly like Disturb.
+	struct Impulse
+	{
+		int i;
+		int j;
+		float Magnitude;
+	};
+
+	// Span of a vertex buffer, in bytes, rewritten by WriteDirtyVertices.
+	struct ByteRange
+	{
+		std::size_t Offset;
+		std::size_t Size;
+	};
+
+	// Side length, in grid points, of the tiles used for active-region tracking.
+	static const int RegionTileSize = 16;
+
+	// How Update() schedules the work of one simulation step.
+	enum class UpdateMode
+	{
+		// Height stencil over the whole grid, then a second sweep for normals/tangents.
+		TwoPass,
+
+		// Heights and then normals/tangents per band of rows sized to stay in L2.
+		// Produces bit-identical results to TwoPass.
+		Tiled
+	};
+
     Waves(int m, int n, float dx, float dt, float speed, float damping);
     Waves(const Waves& rhs) = delete;
     Waves& operator=(const Waves& rhs) = delete;
@@ -28,7 +72,30 @@ public:
 	float Depth()const;
 
 	// Returns the solution at the ith grid point.
-    const DirectX::XMFLOAT3& Position(int i)const { return mCurrSolution[i]; }
+    DirectX::XMFLOAT3 Position(int i)const
+	{
+		int row = i / mNumCols;
+		int col = i - row*mNumCols;
+		return DirectX::XMFLOAT3(mColumnX[col], mCurrHeights[row*mRowPitch + col], mRowZ[row]);
+	}
+
+	// Returns the solution height at the ith grid point.
+	float Height(int i)const
+	{
+		int row = i / mNumCols;
+		return mCurrHeights[row*mRowPitch + (i - row*mNumCols)];
+	}
+
+	// Returns the solution at the ith grid point blended between the previous and the
+	// current step by InterpolationAlpha(), for smooth rendering between sim steps.
+	DirectX::XMFLOAT3 InterpolatedPosition(int i)const
+	{
+		int row = i / mNumCols;
+		int col = i - row*mNumCols;
+		int k = row*mRowPitch + col;
+		float h = mPrevHeights[k] + (mCurrHeights[k] - mPrevHeights[k])*mAlpha;
+		return DirectX::XMFLOAT3(mColumnX[col], h, mRowZ[row]);
+	}
 
 	// Returns the solution normal at the ith grid point.
     const DirectX::XMFLOAT3& Normal(int i)const { return mNormals[i]; }
@@ -36,12 +103,93 @@ public:
 	// Returns the unit tangent vector at the ith grid point in the local x-axis direction.
     const DirectX::XMFLOAT3& TangentX(int i)const { return mTangentX[i]; }
 
-	void Update(float dt);
+	// Writes VertexCount() vertices of the current solution to dst in a single forward
+	// pass.  dst may be write-combined mapped memory (e.g. an upload heap); it is only
+	// written, never read.  Texture coordinates are precomputed at construction.
+	void WriteVertices(Vertex* dst)const;
+
+	// Writes only the tiles that changed since they were last written into a buffer.
+	// With SetFrameResourceCount(N) a change is written N times, once per call, so each
+	// of N round-robin buffers receives it.  If dirtyRanges is not null it receives the
+	// coalesced byte ranges that were written.  Returns the number of vertices written.
+	int WriteDirtyVertices(Vertex* dst, std::vector<ByteRange>* dirtyRanges = nullptr);
+
+	// Number of round-robin vertex buffers WriteDirtyVertices is feeding.  Marks every
+	// tile dirty for all of them.
+	void SetFrameResourceCount(int count);
+
+	// Floats per padded height row; row r starts at r*RowPitch().
+	int RowPitch()const { return mRowPitch; }
+
+	// Read-only view of the current height plane (RowCount() rows of RowPitch() floats).
+	const float* Heights()const { return mCurrHeights.data(); }
+
+	// Advances the simulation by as many fixed mTimeStep sub-steps as dt covers, up to
+	// MaxSubSteps(); time beyond the cap is dropped so a long hitch can't snowball.
+	// Returns the number of sub-steps taken.
+	int Update(float dt);
 	void Disturb(int i, int j, float magnitude);
 
+	// Applies count impulses in one pass, ordered by grid row so the height plane is
+	// walked front to back no matter how the drops were generated.
+	void DisturbBatch(const Impulse* impulses, int count);
+
+	void SetUpdateMode(UpdateMode mode) { mUpdateMode = mode; }
+	UpdateMode GetUpdateMode()const { return mUpdateMode; }
+
+	void SetMaxSubSteps(int count) { mMaxSubSteps = count > 1 ? count : 1; }
+	int MaxSubSteps()const { return mMaxSubSteps; }
+
+	// Tiles whose heights in both time levels stay below epsilon are put to sleep
+	// (zeroed and skipped by the solver) until a disturbance or a neighbouring wave
+	// wakes them.  Zeroing drops the residual ripples, so with sleeping enabled the
+	// solution no longer matches the full-grid solver exactly.  Active tiles are
+	// still stepped according to the UpdateMode.  Off by default (epsilon 0); an
+	// epsilon <= 0 disables tracking and steps the whole grid.
+	void SetSleepEpsilon(float epsilon) { mSleepEpsilon = epsilon; }
+	float SleepEpsilon()const { return mSleepEpsilon; }
+
+	// Number of tiles stepped by the most recent sub-step.
+	int ActiveTileCount()const { return mActiveTileCount; }
+
+	// Fraction of a time step accumulated since the last sub-step, in [0, 1).
+	float InterpolationAlpha()const { return mAlpha; }
+
+	// Name of the stencil kernel selected at compile time ("avx2", "sse2" or "scalar").
+	static const char* SimdPath();
+
 private:
+	void StepTwoPass();
+	void StepTiled();
+	void StepActiveTiles();
+	void StepActiveTwoPass();
+	void StepActiveTiled();
+	void MeasureTile(int tile);
+	void StepRows(int firstRow, int lastRow);
+	void ComputeNormalsRow(const float* heights, int i, int firstCol, int lastCol);
+	void SleepTile(int tile);
+	void WakeTileAt(int i, int j);
+
     int mNumRows = 0;
     int mNumCols = 0;
+	int mRowPitch = 0;
+	int mTileRows = 0;
+
+	UpdateMode mUpdateMode = UpdateMode::Tiled;
+
+	// Active-region tracking, one entry per RegionTileSize^2 tile.
+	int mTileRowCount = 0;
+	int mTileColCount = 0;
+	float mSleepEpsilon = 0.0f;
+	int mFrameResourceCount = 1;
+	int mActiveTileCount = 0;
+	std::vector<std::uint8_t> mTileLive;   // had energy above epsilon after the last step
+	std::vector<std::uint8_t> mTileActive; // stepped by the last step
+	std::vector<int> mTileFramesDirty;     // buffers that still need this tile
+	std::vector<int> mActiveTiles;
+	std::vector<int> mActiveRowStart;      // offsets into mActiveTiles per active tile row
+
+	std::vector<Impulse> mSortedImpulses;
 
     int mVertexCount = 0;
     int mTriangleCount = 0;
@@ -52,12 +200,19 @@ private:
     float mK3 = 0.0f;
 
     float mTimeStep = 0.0f;
+	float mAccumulator = 0.0f;
+	float mAlpha = 0.0f;
+	int mMaxSubSteps = 4;
     float mSpatialStep = 0.0f;
 
-    std::vector<DirectX::XMFLOAT3> mPrevSolution;
-    std::vector<DirectX::XMFLOAT3> mCurrSolution;
+	std::vector<float> mColumnX;
+	std::vector<float> mRowZ;
+	std::vector<DirectX::XMFLOAT2> mTexC;
+
+    std::vector<float> mPrevHeights;
+    std::vector<float> mCurrHeights;
     std::vector<DirectX::XMFLOAT3> mNormals;
     std::vector<DirectX::XMFLOAT3> mTangentX;
 };
 
-#endif // WAVES_H
\ No newline at end of file
+#endif // WAVES_H
@@ -7,12 +7,25 @@
  */
 
 #include "../../Common/d3dApp.h"
+#include "../../Common/AabbTree.h"
 #include "../../Common/MathHelper.h"
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
+#include "../../Common/MeshOptimizer.h"
+#include "../../Common/MeshSimplifier.h"
+#include "../../Common/MeshBatchBuilder.h"
+#include "../../Common/BoundsBuilder.h"
+#include "../../Common/Meshlet.h"
 #include "../../Common/Camera.h"
+#include "../../Common/GeometryCache.h"
+#include "../../Common/FrustumCuller.h"
+#include "../../Common/Heightfield.h"
+#include "../../Common/HillsFunction.h"
+#include "../../Common/SceneStore.h"
+#include "../../Common/TerrainQuadtree.h"
 #include "FrameResource.h"
 #include "Waves.h"
+#include <chrono>
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -23,36 +36,111 @@ using namespace DirectX::PackedVector;
 
 const int gNumFrameResources = 3;
 
-// Lightweight structure stores parameters to draw a shape.  This will
-// vary from app-to-app.
-struct RenderItem
+// Terrain height buffer: samples per edge, and its slot in the SRV heap after the
+// textures.
+const UINT gTerrainHeightmapDim = 257;
+const UINT gTerrainHeightSrvIndex = 11;
+
+// Lowest the camera gets above the land.
+const float gCameraEyeHeight = 2.0f;
+
+// Root constants for one terrain node; matches cbTerrainNode in Terrain.hlsl.
+struct TerrainNodeConstants
 {
-	RenderItem() = default;
+	XMFLOAT2 NodeOrigin = { 0.0f, 0.0f };
+	float NodeSize = 0.0f;
+	float PatchResolution = 0.0f;
+	float MorphStart = 0.0f;
+	float MorphEnd = 0.0f;
+	float HeightmapSize = 0.0f;
+	UINT HeightmapDim = 0;
+	XMFLOAT2 HeightmapOrigin = { 0.0f, 0.0f };
+};
 
-	//for rendering the bounding box
-	BoundingBox RenderBounds;
+// Meshlets of one mesh in the index buffer, with the culler built from their bounds.
+struct ClusterSet
+{
+	ClusterSet(MeshletMesh&& mesh, UINT startIndexLocation)
+		: Mesh(std::move(mesh)), Culler(Mesh.Bounds), StartIndexLocation(startIndexLocation), Visible(Culler.MeshletCount())
+	{
+	}
+
+	MeshletMesh Mesh;
+	MeshletCuller Culler;
 
-	//adding a vari to store the name
-	std::string Name;
+	// Where Mesh.Indices starts in the geometry's index buffer.
+	UINT StartIndexLocation = 0;
 
-    // World matrix of the shape that describes the object's local space
-    // relative to the world space, which defines the position, orientation,
-    // and scale of the object in the world.
-    XMFLOAT4X4 World = MathHelper::Identity4x4();
+	// Scratch list the culler writes into.
+	std::vector<std::uint32_t> Visible;
+};
 
-	XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
+// Buffer description stored in the "layout" section of a geometry cache file.
+struct CachedGeometryLayout
+{
+	std::uint32_t VertexByteStride = 0;
+	std::uint32_t VertexBufferByteSize = 0;
+	std::uint32_t IndexFormat = 0;
+	std::uint32_t IndexBufferByteSize = 0;
+};
 
-	// Dirty flag indicating the object data has changed and we need to update the constant buffer.
-	// Because we have an object cbuffer for each FrameResource, we have to apply the
-	// update to each FrameResource.  Thus, when we modify obect data we should set 
-	// NumFramesDirty = gNumFrameResources so that each frame resource gets the update.
-	int NumFramesDirty = gNumFrameResources;
+// Version of the generated geometry stored in the cache.  Bump it whenever the output
+// of GeometryGenerator, MeshOptimizer, MeshSimplifier, the meshlet builder or the
+// conversion code in this file changes, so stale cache files are regenerated.
+static const std::uint32_t kGeometryCacheVersion = 1;
 
-	// Index into GPU constant buffer corresponding to the ObjectCB for this render item.
-	UINT ObjCBIndex = -1;
+// Starts a cache key for one of the app's geometries.
+static GeometryCache::Key MakeGeometryKey(const char* geoName)
+{
+	GeometryCache::Key key(geoName);
+	key.Add(kGeometryCacheVersion);
+	key.Add((std::uint32_t)sizeof(Vertex));
+	return key;
+}
 
-	Material* Mat = nullptr;
-	MeshGeometry* Geo = nullptr;
+// Generator parameters of one shape in boxGeo.  BuildBoxGeometry generates every shape
+// from its row of gBoxGeoShapes and hashes the same rows into the cache key, so the key
+// always matches what would be generated.
+struct ShapeParams
+{
+	const char* Generator;
+	std::uint32_t Count;
+	float Values[5];
+
+	float operator[](int i)const { return Values[i]; }
+	std::uint32_t Int(int i)const { return (std::uint32_t)Values[i]; }
+};
+
+enum BoxGeoShape
+{
+	BoxShape, CylinderShape, SphereShape, GeosphereShape, QuadShape, TriPrismShape,
+	ConeShape, PyramidShape, DiamondShape, WedgeShape, TorusShape, BoxGeoShapeCount
+};
+
+static const ShapeParams gBoxGeoShapes[BoxGeoShapeCount] =
+{
+	{ "CreateBox", 4, { 4.5f, 3.5f, 4.5f, 3 } },
+	{ "CreateCylinder", 5, { 0.5f, 0.3f, 6.0f, 20, 20 } },
+	{ "CreateSphere", 3, { 0.5f, 20, 20 } },
+	{ "CreateGeosphere", 2, { 1.0f, 2 } },
+	{ "CreateQuad", 5, { 1.0f, 1.0f, 1.0f, 1.0f, 0.5f } },
+	{ "CreateTriangularPrism", 3, { 1.0f, 1.0f, 3 } },
+	{ "CreateCone", 4, { 1.0f, 1.0f, 9, 5 } },
+	{ "CreatePyramid", 3, { 1.0f, 1.0f, 5 } },
+	{ "CreateDiamond", 4, { 1.0f, 1.0f, 1.0f, 2 } },
+	{ "CreateWedge", 4, { 1.0f, 1.0f, 1.0f, 2 } },
+	{ "CreateTorus", 4, { 2.0f, 0.5f, 20, 20 } },
+};
+
+// Lightweight structure stores parameters to draw a shape.  This will
+// vary from app-to-app.
+struct RenderItem
+{
+	RenderItem() = default;
+
+	// Transforms, bounds, name, constant buffer slot, material and geometry are
+	// kept in the app's SceneStore under this handle.
+	SceneStore::Handle Handle;
 
     // Primitive topology.
     D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
@@ -61,6 +149,18 @@ struct RenderItem
     UINT IndexCount = 0;
     UINT StartIndexLocation = 0;
     int BaseVertexLocation = 0;
+
+	// Detail levels for distance based LOD, full detail first.  Empty for items
+	// that always draw the range above.
+	std::vector<SubmeshGeometry> Lods;
+
+	// World space bounding sphere used to estimate the item's size on screen.
+	BoundingSphere LodBounds;
+
+	// Optional meshlet split of the full detail range.  When set, only the index
+	// ranges in DrawRanges (StartIndexLocation, IndexCount) are drawn.
+	ClusterSet* Clusters = nullptr;
+	std::vector<std::pair<UINT, UINT>> DrawRanges;
 };
 
 enum class RenderLayer : int
@@ -98,12 +198,16 @@ private:
 	void UpdateMaterialCBs(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
 	void UpdateWaves(const GameTimer& gt); 
+	void UpdateLods(const GameTimer& gt);
+	void UpdateCulling(const GameTimer& gt);
+	void UpdateClusters(const GameTimer& gt);
+	void UpdateTerrain(const GameTimer& gt);
 
 	void LoadTextures();
     void BuildRootSignature();
 	void BuildDescriptorHeaps();
     void BuildShadersAndInputLayouts();
-    void BuildLandGeometry();
+    void BuildTerrain();
     void BuildWavesGeometry();
 	void BuildBoxGeometry();
 	void BuildTreeSpritesGeometry();
@@ -119,9 +223,16 @@ private:
 	bool mRenderBoundingBoxes = false;
 
     void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
+	void DrawTerrain(ID3D12GraphicsCommandList* cmdList);
 	void CreateNewObject(const char* item, XMMATRIX p, XMMATRIX q, XMMATRIX r, UINT ObjIndex, const char* material);
+
+	// Geometry cache: Load fills mGeometries (and the named cluster sets) from the
+	// cache file for key, Store writes them out after a miss.
+	bool LoadCachedGeometry(const GeometryCache::Key& key, const std::string& geoName, std::initializer_list<const char*> clusterSets);
+	void StoreCachedGeometry(const GeometryCache::Key& key, const std::string& geoName, std::initializer_list<const char*> clusterSets);
 	std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> GetStaticSamplers();
 
+	float GetLandHeight(float x, float z)const;
     float GetHillsHeight(float x, float z)const;
     XMFLOAT3 GetHillsNormal(float x, float z)const;
 
@@ -142,22 +253,57 @@ private:
 	std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
 	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
 	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mPSOs;
+	std::unordered_map<std::string, std::unique_ptr<ClusterSet>> mClusterSets;
+
+	GeometryCache mGeometryCache{ "GeometryCache" };
+	int mGeometryCacheLookups = 0;
+	int mGeometryCacheHits = 0;
 
     std::vector<D3D12_INPUT_ELEMENT_DESC> mStdInputLayout;
 	std::vector<D3D12_INPUT_ELEMENT_DESC> mTreeSpriteInputLayout;
 
     RenderItem* mWavesRitem = nullptr;
+	RenderItem* mTerrainRitem = nullptr;
 
-	// List of all the render items.
+	// List of all the render items, and the per-object data they share.
 	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
+	SceneStore mScene{ gNumFrameResources };
+
+	// World bounds of the objects the camera collides with; leaves hold indices
+	// into mAllRitems.
+	AabbTree mColliders;
 
 	// Render items divided by PSO.
 	std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
 
+	// The items of each layer that are inside the camera frustum this frame, in
+	// layer order, and how many were drawn and culled.
+	std::vector<RenderItem*> mVisibleRitems[(int)RenderLayer::Count];
+	std::vector<UINT> mVisibleItems;
+	std::vector<std::uint8_t> mItemVisible;
+	UINT mDrawnCount = 0;
+	UINT mCulledCount = 0;
+	std::wstring mBaseCaption;
+
 	std::unique_ptr<Waves> mWaves;
 
+	// CDLOD terrain: the baked land heights (also used to place objects and keep
+	// the camera above ground), the quadtree, the nodes selected this frame, and
+	// the copy of the heights the terrain shader samples.
+	Heightfield mLand;
+	std::unique_ptr<TerrainQuadtree> mTerrain;
+	std::vector<TerrainQuadtree::Node> mTerrainNodes;
+	ComPtr<ID3D12Resource> mTerrainHeightsGPU = nullptr;
+	ComPtr<ID3D12Resource> mTerrainHeightsUploader = nullptr;
+
+	// Own generator for the rain so the water replays identically for a given seed.
+	Pcg32 mWavesRandom{ 2024 };
+
     PassConstants mMainPassCB;
 
+	// Largest LOD error allowed on screen, in pixels.
+	float mLodPixelError = 1.0f;
+
 	//Adding in First Person Camera
 	Camera mCamera;
 	float mCameraSpeed = 10.f;
@@ -208,21 +354,43 @@ TreeBillboardsApp::~TreeBillboardsApp()
 void TreeBillboardsApp::CreateNewObject(const char* item, XMMATRIX p, XMMATRIX q, XMMATRIX r, UINT ObjIndex, const char* material)
 {
 	auto RightWall = std::make_unique<RenderItem>();
-	XMStoreFloat4x4(&RightWall->World, p * q * r);
-	RightWall->ObjCBIndex = ObjIndex;
-	RightWall->Mat = mMaterials[material].get();//
-	RightWall->Geo = mGeometries["boxGeo"].get();
 
-	RightWall->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	SceneStore::Desc desc;
+	XMStoreFloat4x4(&desc.World, p * q * r);
+	desc.ObjCBIndex = ObjIndex;
+	desc.Mat = mMaterials[material].get();//
+	desc.Geo = mGeometries["boxGeo"].get();
+	desc.Layers = 1u << (int)RenderLayer::Opaque;
 	//adding the name
-	RightWall->Name = item;
-
+	desc.Name = item;
 	//adding collision bounds
-	RightWall->RenderBounds = RightWall->Geo->DrawArgs[item].Bounds;
+	desc.LocalBounds = desc.Geo->DrawArgs[item].Bounds;
+	RightWall->Handle = mScene.Add(desc);
+
+	RightWall->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	/////////////////////////////////////////////////////////////////
-	RightWall->IndexCount = RightWall->Geo->DrawArgs[item].IndexCount;
-	RightWall->StartIndexLocation = RightWall->Geo->DrawArgs[item].StartIndexLocation;
-	RightWall->BaseVertexLocation = RightWall->Geo->DrawArgs[item].BaseVertexLocation;
+	RightWall->IndexCount = desc.Geo->DrawArgs[item].IndexCount;
+	RightWall->StartIndexLocation = desc.Geo->DrawArgs[item].StartIndexLocation;
+	RightWall->BaseVertexLocation = desc.Geo->DrawArgs[item].BaseVertexLocation;
+
+	//pick up the simplified versions of the shape, if it has any
+	RightWall->Lods.push_back(desc.Geo->DrawArgs[item]);
+	for(int lod = 1; ; ++lod)
+	{
+		auto it = desc.Geo->DrawArgs.find(std::string(item) + "_lod" + std::to_string(lod));
+		if(it == desc.Geo->DrawArgs.end())
+			break;
+		RightWall->Lods.push_back(it->second);
+	}
+
+	BoundingSphere::CreateFromBoundingBox(RightWall->LodBounds, mScene.GetWorldBounds(RightWall->Handle));
+
+	auto clusters = mClusterSets.find(item);
+	if(clusters != mClusterSets.end())
+		RightWall->Clusters = clusters->second.get();
+	//the scene is static, so the proxy is never moved or removed
+	mColliders.Insert(mScene.GetWorldBounds(RightWall->Handle), (UINT)mAllRitems.size());
+
 	//mAllRitems.push_back(std::move(RightWall));
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(RightWall.get());
 	mAllRitems.push_back(std::move(RightWall));
@@ -249,14 +417,22 @@ bool TreeBillboardsApp::Initialize()
 	mCameraBoundbox.Extents = XMFLOAT3(1.1f, 1.1f, 1.1f);
 
     mWaves = std::make_unique<Waves>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f); //change water size
+	mWaves->SetFrameResourceCount(gNumFrameResources);
+	//let calm water tiles sleep; the faint leftover ripples are not visible
+	mWaves->SetSleepEpsilon(1.0e-4f);
  
 	LoadTextures();
     BuildRootSignature();
 	BuildDescriptorHeaps();
     BuildShadersAndInputLayouts();
-    BuildLandGeometry();
+	//time the procedural geometry to compare cold (generated) and warm (cached) starts
+	auto geometryStart = std::chrono::steady_clock::now();
+    BuildTerrain();
     BuildWavesGeometry();
 	BuildBoxGeometry();
+	std::chrono::duration<double, std::milli> geometryTime = std::chrono::steady_clock::now() - geometryStart;
+	::OutputDebugStringA(("Geometry built in " + std::to_string(geometryTime.count()) + " ms, " +
+		std::to_string(mGeometryCacheHits) + "/" + std::to_string(mGeometryCacheLookups) + " from cache\n").c_str());
 	BuildTreeSpritesGeometry();
 	BuildStatueSpriteGeometry();
 	BuildMaterials();
@@ -314,6 +490,10 @@ void TreeBillboardsApp::Update(const GameTimer& gt)
 	UpdateMaterialCBs(gt);
 	UpdateMainPassCB(gt);
     UpdateWaves(gt);
+	UpdateCulling(gt);
+	UpdateLods(gt);
+	UpdateClusters(gt);
+	UpdateTerrain(gt);
 }
 ///////////////////////// DRAW ////////////////////////////////////
 void TreeBillboardsApp::Draw(const GameTimer& gt)
@@ -350,16 +530,19 @@ void TreeBillboardsApp::Draw(const GameTimer& gt)
 	auto passCB = mCurrFrameResource->PassCB->Resource();
 	mCommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress());
 
-    DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
+    DrawRenderItems(mCommandList.Get(), mVisibleRitems[(int)RenderLayer::Opaque]);
+
+	mCommandList->SetPipelineState(mPSOs["terrain"].Get());
+	DrawTerrain(mCommandList.Get());
 
 	mCommandList->SetPipelineState(mPSOs["alphaTested"].Get());
-	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::AlphaTested]);
+	DrawRenderItems(mCommandList.Get(), mVisibleRitems[(int)RenderLayer::AlphaTested]);
 
 	mCommandList->SetPipelineState(mPSOs["treeSprites"].Get());
-	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::AlphaTestedTreeSprites]);
+	DrawRenderItems(mCommandList.Get(), mVisibleRitems[(int)RenderLayer::AlphaTestedTreeSprites]);
 
 	mCommandList->SetPipelineState(mPSOs["transparent"].Get());
-	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Transparent]);
+	DrawRenderItems(mCommandList.Get(), mVisibleRitems[(int)RenderLayer::Transparent]);
 
     // Indicate a state transition on the resource usage.
 	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
@@ -505,6 +688,12 @@ void TreeBillboardsApp::OnKeyboardInput(const GameTimer& gt)
 		mRenderBoundingBoxes = !mRenderBoundingBoxes; 
 	}
 
+	//follow the terrain: never let the eye drop below the land under it
+	XMFLOAT3 eye = mCamera.GetPosition3f();
+	float groundHeight = mLand.Height(eye.x, eye.z) + gCameraEyeHeight;
+	if (eye.y < groundHeight)
+		mCamera.SetPosition(eye.x, groundHeight, eye.z);
+
 	mCamera.UpdateViewMatrix();
 
 	//bounding box
@@ -514,37 +703,44 @@ void TreeBillboardsApp::OnKeyboardInput(const GameTimer& gt)
 ///////////////////////// Checking Camera Collision ////////////////////////////////////
 bool TreeBillboardsApp::CheckCameraCollision(FXMVECTOR predictPos)
 {
+	// Create a temporary bounding box around the predicted camera position.
+	BoundingBox tempCameraBound;
+	XMStoreFloat3(&tempCameraBound.Center, predictPos); // Set the center
+	tempCameraBound.Extents = mCameraBoundbox.Extents; // Set the extents
+
 	//adding collision here
-	// iterate through all opaque render items in the scene.
-	for (auto renderIt : mRitemLayer[(int)RenderLayer::Opaque])
+	// only the objects whose world box overlaps the camera box come back from the
+	// collider tree, so the exact test below runs for a handful of them.
+	bool collided = false;
+	mColliders.Query(tempCameraBound, [&](UINT item)
 	{
-		// Create a temporary bounding box around the predicted camera position.
-		BoundingBox tempCameraBound;
-		XMStoreFloat3(&tempCameraBound.Center, predictPos); // Set the center
-		tempCameraBound.Extents = mCameraBoundbox.Extents; // Set the extents
+		SceneStore::Handle handle = mAllRitems[item]->Handle;
 
-		// Create a local camera bounding box relative to the current render item's world space.
+		// Create a local camera bounding box relative to the current object's world space.
 		BoundingBox localCameraBound;
 
-		// Get the world matrix of the current render item and calculate its inverse.
-		XMMATRIX W = XMLoadFloat4x4(&renderIt->World);
+		// Get the world matrix of the current object and calculate its inverse.
+		XMMATRIX W = XMLoadFloat4x4(&mScene.GetWorld(handle));
 		XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(W), W);
 
-		// Transform the temporary camera bounding box to the local space of the current render item.
+		// Transform the temporary camera bounding box to the local space of the current object.
 		tempCameraBound.Transform(localCameraBound, invWorld);
 
-		// Check for intersection (overlap) between the local camera bounding box and the bounding box of the current render item.
-		if (renderIt->RenderBounds.Intersects(localCameraBound))
+		// Check for intersection (overlap) between the local camera bounding box and the bounding box of the current object.
+		if (mScene.GetLocalBounds(handle).Intersects(localCameraBound))
 		{
 			//for debugging and knowing what we are colliding with
-			std::wstring message = L"Collision detected with render item: " + std::wstring(renderIt->Name.begin(), renderIt->Name.end());
+			const std::string& name = mScene.GetName(handle);
+			std::wstring message = L"Collision detected with render item: " + std::wstring(name.begin(), name.end());
 			MessageBox(nullptr, message.c_str(), L"Collision Detected", MB_OK | MB_ICONINFORMATION);
-			// If intersection is detected, return true 
-			return true;
+			// If intersection is detected, stop looking
+			collided = true;
+			return false;
 		}
-	}
-	//no collision is detected with any render item, return false
-	return false;
+		return true;
+	});
+	//true if a collision was detected with any render item
+	return collided;
 }
 ///////////////////////// SETTING UP ANIMATIONS ////////////////////////////////////
 void TreeBillboardsApp::AnimateMaterials(const GameTimer& gt)
@@ -574,23 +770,30 @@ void TreeBillboardsApp::AnimateMaterials(const GameTimer& gt)
 void TreeBillboardsApp::UpdateObjectCBs(const GameTimer& gt)
 {
 	auto currObjectCB = mCurrFrameResource->ObjectCB.get();
-	for(auto& e : mAllRitems)
+
+	// One linear pass over the scene store's arrays.
+	const size_t count = mScene.Size();
+	const XMFLOAT4X4* worlds = mScene.GetWorlds();
+	const XMFLOAT4X4* texTransforms = mScene.GetTexTransforms();
+	const UINT* objCBIndices = mScene.GetObjCBIndices();
+	int* framesDirty = mScene.GetFramesDirty();
+	for(size_t i = 0; i < count; ++i)
 	{
 		// Only update the cbuffer data if the constants have changed.  
 		// This needs to be tracked per frame resource.
-		if(e->NumFramesDirty > 0)
+		if(framesDirty[i] > 0)
 		{
-			XMMATRIX world = XMLoadFloat4x4(&e->World);
-			XMMATRIX texTransform = XMLoadFloat4x4(&e->TexTransform);
+			XMMATRIX world = XMLoadFloat4x4(&worlds[i]);
+			XMMATRIX texTransform = XMLoadFloat4x4(&texTransforms[i]);
 
 			ObjectConstants objConstants;
 			XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
 			XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
 
-			currObjectCB->CopyData(e->ObjCBIndex, objConstants);
+			currObjectCB->CopyData(objCBIndices[i], objConstants);
 
 			// Next FrameResource need to be updated too.
-			e->NumFramesDirty--;
+			framesDirty[i]--;
 		}
 	}
 }
@@ -678,36 +881,130 @@ void TreeBillboardsApp::UpdateWaves(const GameTimer& gt)
 	{
 		t_base += 0.25f;
 
-		int i = MathHelper::Rand(4, mWaves->RowCount() - 5);
-		int j = MathHelper::Rand(4, mWaves->ColumnCount() - 5);
+		Waves::Impulse drop;
+		drop.i = mWavesRandom.NextInt(4, mWaves->RowCount() - 5);
+		drop.j = mWavesRandom.NextInt(4, mWaves->ColumnCount() - 5);
+		drop.Magnitude = mWavesRandom.NextFloat(0.2f, 0.5f);
 
-		float r = MathHelper::RandF(0.2f, 0.5f);
-
-		mWaves->Disturb(i, j, r);
+		mWaves->DisturbBatch(&drop, 1);
 	}
 
 	// Update the wave simulation.
 	mWaves->Update(gt.DeltaTime());
 
-	// Update the wave vertex buffer with the new solution.
+	// Stream the changed parts of the solution straight into the mapped wave vertex buffer.
+	// Calm tiles were already written to this frame resource and are skipped.
+	static_assert(sizeof(Vertex) == sizeof(Waves::Vertex), "Waves::Vertex must match the app Vertex layout");
 	auto currWavesVB = mCurrFrameResource->WavesVB.get();
-	for(int i = 0; i < mWaves->VertexCount(); ++i)
+	mWaves->WriteDirtyVertices(reinterpret_cast<Waves::Vertex*>(currWavesVB->MappedData()));
+
+	// Set the dynamic VB of the wave renderitem to the current frame VB.
+	mScene.GetGeometry(mWavesRitem->Handle)->VertexBufferGPU = currWavesVB->Resource();
+}
+
+void TreeBillboardsApp::UpdateCulling(const GameTimer& gt)
+{
+	XMFLOAT4 planes[6];
+	mCamera.GetWorldFrustumPlanes(planes);
+
+	// Cull every object's world box at once, then flag the survivors by dense index.
+	const size_t count = mScene.Size();
+	mVisibleItems.resize(count);
+	size_t visibleCount = FrustumCuller::Cull(planes, mScene.GetWorldBounds(), count, mVisibleItems.data());
+
+	mItemVisible.assign(count, 0);
+	for(size_t i = 0; i < visibleCount; ++i)
+		mItemVisible[mVisibleItems[i]] = 1;
+
+	UINT drawn = 0;
+	UINT culled = 0;
+	for(int layer = 0; layer < (int)RenderLayer::Count; ++layer)
 	{
-		Vertex v;
+		auto& visible = mVisibleRitems[layer];
+		visible.clear();
+		for(auto ri : mRitemLayer[layer])
+		{
+			if(mItemVisible[mScene.DenseIndex(ri->Handle)])
+				visible.push_back(ri);
+		}
+
+		drawn += (UINT)visible.size();
+		culled += (UINT)(mRitemLayer[layer].size() - visible.size());
+	}
 
-		v.Pos = mWaves->Position(i);
-		v.Normal = mWaves->Normal(i);
-		
-		// Derive tex-coords from position by 
-		// mapping [-w/2,w/2] --> [0,1]
-		v.TexC.x = 0.5f + v.Pos.x / mWaves->Width();
-		v.TexC.y = 0.5f - v.Pos.z / mWaves->Depth();
+	// Shown next to the frame stats in the title bar.
+	if(drawn != mDrawnCount || culled != mCulledCount || mBaseCaption.empty())
+	{
+		if(mBaseCaption.empty())
+			mBaseCaption = mMainWndCaption;
 
-		currWavesVB->CopyData(i, v);
+		mDrawnCount = drawn;
+		mCulledCount = culled;
+		mMainWndCaption = mBaseCaption + L"    drawn: " + std::to_wstring(drawn) + L"   culled: " + std::to_wstring(culled);
 	}
+}
 
-	// Set the dynamic VB of the wave renderitem to the current frame VB.
-	mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
+void TreeBillboardsApp::UpdateLods(const GameTimer& gt)
+{
+	for(auto& ri : mAllRitems)
+	{
+		if(ri->Lods.size() < 2)
+			continue;
+
+		float radiusPixels = mCamera.GetProjectedRadius(ri->LodBounds.Center, ri->LodBounds.Radius, (float)mClientHeight);
+
+		// Coarsest level whose error still stays under mLodPixelError on screen.
+		size_t level = 0;
+		while(level + 1 < ri->Lods.size() && ri->Lods[level + 1].LodError*radiusPixels <= mLodPixelError)
+			++level;
+
+		ri->IndexCount = ri->Lods[level].IndexCount;
+		ri->StartIndexLocation = ri->Lods[level].StartIndexLocation;
+	}
+}
+
+void TreeBillboardsApp::UpdateClusters(const GameTimer& gt)
+{
+	for(auto& ri : mAllRitems)
+	{
+		// Items outside the frustum aren't drawn, so their meshlets needn't be culled.
+		if(ri->Clusters == nullptr || !mItemVisible[mScene.DenseIndex(ri->Handle)])
+			continue;
+
+		ClusterSet* clusters = ri->Clusters;
+		ri->DrawRanges.clear();
+
+		// Meshlets only cover the full detail range; coarser LODs are drawn whole.
+		if(ri->StartIndexLocation != clusters->StartIndexLocation)
+		{
+			ri->DrawRanges.emplace_back(ri->StartIndexLocation, ri->IndexCount);
+			continue;
+		}
+
+		MeshletCuller::View view = MeshletCuller::MakeView(mCamera, XMLoadFloat4x4(&mScene.GetWorld(ri->Handle)));
+		size_t visibleCount = clusters->Culler.Cull(view, clusters->Visible.data());
+
+		// Neighbouring visible meshlets are contiguous in the index buffer, so merge
+		// them into one draw.
+		for(size_t i = 0; i < visibleCount; ++i)
+		{
+			const Meshlet& meshlet = clusters->Mesh.Meshlets[clusters->Visible[i]];
+			UINT start = clusters->StartIndexLocation + 3 * meshlet.PrimitiveOffset;
+			UINT count = 3 * meshlet.PrimitiveCount;
+
+			if(!ri->DrawRanges.empty() && ri->DrawRanges.back().first + ri->DrawRanges.back().second == start)
+				ri->DrawRanges.back().second += count;
+			else
+				ri->DrawRanges.emplace_back(start, count);
+		}
+	}
+}
+
+void TreeBillboardsApp::UpdateTerrain(const GameTimer& gt)
+{
+	XMFLOAT4 planes[6];
+	mCamera.GetWorldFrustumPlanes(planes);
+	mTerrain->Select(mCamera.GetPosition3f(), planes, mTerrainNodes);
 }
 ///////////////////////// LOADING TEXTURES ////////////////////////////////////
 void TreeBillboardsApp::LoadTextures()
@@ -826,8 +1123,11 @@ void TreeBillboardsApp::BuildRootSignature()
 	CD3DX12_DESCRIPTOR_RANGE texTable;
 	texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
 
+	CD3DX12_DESCRIPTOR_RANGE terrainHeightTable;
+	terrainHeightTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1);
+
     // Root parameter can be a table, root descriptor or root constants.
-    CD3DX12_ROOT_PARAMETER slotRootParameter[4];
+    CD3DX12_ROOT_PARAMETER slotRootParameter[6];
 
 	// Perfomance TIP: Order from most frequent to least frequent.
 	slotRootParameter[0].InitAsDescriptorTable(1, &texTable, D3D12_SHADER_VISIBILITY_PIXEL);
@@ -835,10 +1135,14 @@ void TreeBillboardsApp::BuildRootSignature()
     slotRootParameter[2].InitAsConstantBufferView(1);
     slotRootParameter[3].InitAsConstantBufferView(2);
 
+	// Terrain only: the height buffer and the per-node constants.
+	slotRootParameter[4].InitAsDescriptorTable(1, &terrainHeightTable, D3D12_SHADER_VISIBILITY_VERTEX);
+	slotRootParameter[5].InitAsConstants(sizeof(TerrainNodeConstants) / 4, 3, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+
 	auto staticSamplers = GetStaticSamplers();
 
     // A root signature is an array of root parameters.
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(6, slotRootParameter,
 		(UINT)staticSamplers.size(), staticSamplers.data(),
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -867,7 +1171,7 @@ void TreeBillboardsApp::BuildDescriptorHeaps()
 	// Create the SRV heap.
 	//
 	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-	srvHeapDesc.NumDescriptors = 11;
+	srvHeapDesc.NumDescriptors = 12; // textures, then the terrain heights (filled in BuildTerrain)
 	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
@@ -1003,6 +1307,7 @@ void TreeBillboardsApp::BuildShadersAndInputLayouts()
 	mShaders["standardVS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "VS", "vs_5_1");
 	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", defines, "PS", "ps_5_1");
 	mShaders["alphaTestedPS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", alphaTestDefines, "PS", "ps_5_1");
+	mShaders["terrainVS"] = d3dUtil::CompileShader(L"Shaders\\Terrain.hlsl", nullptr, "TerrainVS", "vs_5_1");
 	
 	mShaders["treeSpriteVS"] = d3dUtil::CompileShader(L"Shaders\\TreeSprite.hlsl", nullptr, "VS", "vs_5_1");
 	mShaders["treeSpriteGS"] = d3dUtil::CompileShader(L"Shaders\\TreeSprite.hlsl", nullptr, "GS", "gs_5_1");
@@ -1022,71 +1327,95 @@ void TreeBillboardsApp::BuildShadersAndInputLayouts()
 	};
 }
 
-void TreeBillboardsApp::BuildLandGeometry()
+void TreeBillboardsApp::BuildTerrain()
 {
-	//land creation
-    GeometryGenerator geoGen;
-    GeometryGenerator::MeshData grid = geoGen.CreateGrid(125.0f, 125.0f, 50, 50);
-	
-    std::vector<Vertex> vertices(grid.Vertices.size());
+	//the 125x125 land as a 4 level CDLOD quadtree: 15.6 unit leaves of 32x32 quads,
+	//so about half a unit per quad close to the camera
+	TerrainQuadtree::Settings settings;
+	settings.Origin = XMFLOAT2(-62.5f, -62.5f);
+	settings.Size = 125.0f;
+	settings.LodCount = 4;
+	settings.PatchResolution = 32;
+	settings.FinestLodDistance = 40.0f;
+
+	//bake the land heights, row 0 at the minimum z
+	const UINT dim = gTerrainHeightmapDim;
+	mLand = Heightfield(settings.Origin, XMFLOAT2(settings.Size, settings.Size), dim, dim,
+		[this](float x, float z) { return GetLandHeight(x, z); });
+
+	mTerrain = std::make_unique<TerrainQuadtree>(settings, mLand.GetData(), dim, dim);
+
+	const UINT heightsByteSize = dim * dim * sizeof(float);
+	mTerrainHeightsGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+		mCommandList.Get(), mLand.GetData(), heightsByteSize, mTerrainHeightsUploader);
 
-	//Calculate the BB - Step One
-	XMFLOAT3 vMinf3(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
-	XMFLOAT3 vMaxf3(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+	srvDesc.Buffer.FirstElement = 0;
+	srvDesc.Buffer.NumElements = dim * dim;
+	srvDesc.Buffer.StructureByteStride = 0;
+	srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
 
-	XMVECTOR vMin = XMLoadFloat3(&vMinf3);
-	XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
+	CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
+	hDescriptor.Offset(gTerrainHeightSrvIndex, mCbvSrvDescriptorSize);
+	md3dDevice->CreateShaderResourceView(mTerrainHeightsGPU.Get(), &srvDesc, hDescriptor);
 
-    for(size_t i = 0; i < grid.Vertices.size(); ++i)
-    {
-		auto& p = grid.Vertices[i].Position;
-		vertices[i].Pos.x = -p.z; //rotate 90 degreees counter clockwise
-		vertices[i].Pos.z = p.x; //define the z coordinate
-
-		// Update the minimum and maximum extents of the bounding box
-		/*vMin = XMVectorMin(vMin, XMLoadFloat3(&p));
-		vMax = XMVectorMax(vMax, XMLoadFloat3(&p));*/
-		XMVECTOR Pos = XMLoadFloat3(&grid.Vertices[i].Position);
-		vMin = XMVectorMin(vMin, Pos);
-		vMax = XMVectorMax(vMax, Pos);
-
-		// Calculate the center of the grid aka 0
-		float centerX = 0;
-		float centerZ = 0;
-
-		// Calculate the border size - CHOOSE 45
-		float borderSize = 45.0f;
-
-		//Height adjustment - checking to make sure the vertex is within a certain POS. 
-		//as long as it is within the range of 45 keep it 2
-		//otherwise dip down to -10
-        if (p.x > centerX - borderSize && p.x < centerX + borderSize && 
-            p.z > centerZ - borderSize && p.z < centerZ + borderSize)
-        {
-            // Inside the border
-            vertices[i].Pos.y = 2;
-        }
-        else
-        {
-            // Outside the border
-            vertices[i].Pos.y = -10;
-        }
-		vertices[i].Normal = GetHillsNormal(p.x, p.z);
-		vertices[i].TexC = grid.Vertices[i].TexC;
-    }
+	//the patch every node draws: a unit grid with its indices grouped by quadrant
+	//(bit 2*zHalf + xHalf, as in TerrainQuadtree::Node) so a node can be drawn in part
+	const UINT res = settings.PatchResolution;
+	GeometryGenerator geoGen;
+	GeometryGenerator::MeshData patch = geoGen.CreateGrid(1.0f, 1.0f, res + 1, res + 1);
+
+	std::vector<Vertex> vertices(patch.Vertices.size());
+	for(size_t i = 0; i < patch.Vertices.size(); ++i)
+	{
+		vertices[i].Pos = patch.Vertices[i].Position;
+		vertices[i].Normal = patch.Vertices[i].Normal;
+		vertices[i].TexC = patch.Vertices[i].TexC;
+	}
+
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = "terrainGeo";
 
-	// After the loop, extract the minimum and maximum values from the XMVECTORs
-	//XMFLOAT3 vMinf3, vMaxf3;
-	XMStoreFloat3(&vMinf3, vMin);
-	XMStoreFloat3(&vMaxf3, vMax);
+	//grid row i is at z = 0.5 - i/res, so the minimum z half is the second half of the rows
+	std::vector<std::uint16_t> indices;
+	indices.reserve(res * res * 6);
+	const UINT half = res / 2;
+	for(UINT q = 0; q < 4; ++q)
+	{
+		SubmeshGeometry quadrant;
+		quadrant.StartIndexLocation = (UINT)indices.size();
 
-    const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
+		UINT firstRow = (q >> 1) ? 0 : half;
+		UINT firstColumn = (q & 1) ? half : 0;
+		for(UINT i = firstRow; i < firstRow + half; ++i)
+		{
+			for(UINT j = firstColumn; j < firstColumn + half; ++j)
+			{
+				indices.push_back((std::uint16_t)(i * (res + 1) + j));
+				indices.push_back((std::uint16_t)(i * (res + 1) + j + 1));
+				indices.push_back((std::uint16_t)((i + 1) * (res + 1) + j));
+
+				indices.push_back((std::uint16_t)((i + 1) * (res + 1) + j));
+				indices.push_back((std::uint16_t)(i * (res + 1) + j + 1));
+				indices.push_back((std::uint16_t)((i + 1) * (res + 1) + j + 1));
+			}
+		}
 
-    std::vector<std::uint16_t> indices = grid.GetIndices16();
-    const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
+		quadrant.IndexCount = (UINT)indices.size() - quadrant.StartIndexLocation;
+		geo->DrawArgs["patch" + std::to_string(q)] = quadrant;
+	}
 
-	auto geo = std::make_unique<MeshGeometry>();
-	geo->Name = "landGeo";
+	SubmeshGeometry submesh;
+	submesh.IndexCount = (UINT)indices.size();
+	submesh.StartIndexLocation = 0;
+	submesh.BaseVertexLocation = 0;
+	geo->DrawArgs["patch"] = submesh;
+
+	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
+	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 
 	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
 	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
@@ -1105,29 +1434,17 @@ void TreeBillboardsApp::BuildLandGeometry()
 	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
 	geo->IndexBufferByteSize = ibByteSize;
 
-	SubmeshGeometry submesh;
-	submesh.IndexCount = (UINT)indices.size();
-	submesh.StartIndexLocation = 0;
-	submesh.BaseVertexLocation = 0;
-
-	//Calculate Bound Box for collision
-	//step 3
-	BoundingBox bounds;
-	XMStoreFloat3(&bounds.Center, 0.5f * (vMin + vMax));
-	XMStoreFloat3(&bounds.Extents, 0.5f * (vMax - vMin));
-
-	//step 4
-	submesh.Bounds = bounds;
-	vMin = XMLoadFloat3(&vMinf3);
-	vMax = XMLoadFloat3(&vMaxf3);
-
-	geo->DrawArgs["grid"] = submesh;
-
-	mGeometries["landGeo"] = std::move(geo);
+	mGeometries["terrainGeo"] = std::move(geo);
 }
 
 void TreeBillboardsApp::BuildWavesGeometry()
 {
+	GeometryCache::Key key = MakeGeometryKey("waterGeo");
+	key.Add((std::uint32_t)mWaves->RowCount());
+	key.Add((std::uint32_t)mWaves->ColumnCount());
+	if(LoadCachedGeometry(key, "waterGeo", {}))
+		return;
+
     std::vector<std::uint16_t> indices(3 * mWaves->TriangleCount()); // 3 indices per face
 	assert(mWaves->VertexCount() < 0x0000ffff);
 
@@ -1180,363 +1497,146 @@ void TreeBillboardsApp::BuildWavesGeometry()
 	geo->DrawArgs["grid"] = submesh;
 
 	mGeometries["waterGeo"] = std::move(geo);
+	StoreCachedGeometry(key, "waterGeo", {});
 }
 
 //create the new shapes in here
 void TreeBillboardsApp::BuildBoxGeometry()
 {
-	//DEClARE SHAPES
-	GeometryGenerator geoGen;
-	//box shape - 1 
-	GeometryGenerator::MeshData box = geoGen.CreateBox(4.5f, 3.5f, 4.5f, 3);
-	//cylinder - 3
-	GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(0.5f, 0.3f, 6.0f, 20, 20);
-	//sphere - 4
-	GeometryGenerator::MeshData sphere = geoGen.CreateSphere(0.5f, 20, 20);
-	//geosphere - 5 
-	GeometryGenerator::MeshData GEOsphere = geoGen.CreateGeosphere(1.0f, 2);
-	//quad - 6
-	GeometryGenerator::MeshData quad = geoGen.CreateQuad(1.0f, 1.0f, 1.0f, 1.0f, 0.5f);
-	//triangular prism - 7
-	GeometryGenerator::MeshData triPrism = geoGen.CreateTriangularPrism(1.0f, 1.0f, 3);
-	//cone - 8
-	GeometryGenerator::MeshData cone = geoGen.CreateCone(1.0f, 1.0f, 9, 5);
-	//pyramid - 9
-	GeometryGenerator::MeshData pyramid = geoGen.CreatePyramid(1.0f, 1.0f, 5);
-	//diamond - 10
-	GeometryGenerator::MeshData diamond = geoGen.CreateDiamond(1.0f, 1.0f, 1.0, 2);
-	//wedge - 11
-	GeometryGenerator::MeshData wedge = geoGen.CreateWedge(1.0f, 1.0f, 1.0, 2);
-	//torus -12
-	GeometryGenerator::MeshData torus = geoGen.CreateTorus(2.0f, 0.5f, 20, 20);
-
-	//-----------------------------//
-	
-	//Vertex Cashe
-	UINT boxVertexOffset = 0;
-	UINT cylinderVertexOffset = boxVertexOffset + (UINT)box.Vertices.size();
-	UINT sphereVertexOffset = cylinderVertexOffset + (UINT)cylinder.Vertices.size();
-	UINT geoSphereVertexOffset = sphereVertexOffset + (UINT)sphere.Vertices.size();
-	UINT quadVertexOffset = geoSphereVertexOffset + (UINT)GEOsphere.Vertices.size();
-	UINT triPrismVertexOffset = quadVertexOffset + (UINT)quad.Vertices.size();
-	UINT coneVertexOffset = triPrismVertexOffset + (UINT)triPrism.Vertices.size();
-	UINT pyramidVertexOffset = coneVertexOffset + (UINT)cone.Vertices.size();
-	UINT diamondVertexOffset = pyramidVertexOffset + (UINT)pyramid.Vertices.size();
-	UINT wedgeVertexOffset = diamondVertexOffset + (UINT)diamond.Vertices.size();
-	UINT torusVertexOffset = wedgeVertexOffset + (UINT)wedge.Vertices.size();
-
-	//Index Cashe
-	UINT boxIndexOffset = 0;
-	UINT cylinderIndexOffset = boxIndexOffset + (UINT)box.Indices32.size();
-	UINT sphereIndexOffset = cylinderIndexOffset + (UINT)cylinder.Indices32.size();
-	UINT geoSphereIndexOffset = sphereIndexOffset + (UINT)sphere.Indices32.size();
-	UINT quadIndexOffset = geoSphereIndexOffset + (UINT)GEOsphere.Indices32.size();
-	UINT triPrismIndexOffset = quadIndexOffset + (UINT)quad.Indices32.size();
-	UINT coneIndexOffset = triPrismIndexOffset + (UINT)triPrism.Indices32.size();
-	UINT pyramidIndexOffset = coneIndexOffset + (UINT)cone.Indices32.size();
-	UINT diamondIndexOffset = pyramidIndexOffset + (UINT)pyramid.Indices32.size();
-	UINT wedgeIndexOffset = diamondIndexOffset + (UINT)diamond.Indices32.size();
-	UINT torusIndexOffset = wedgeIndexOffset + (UINT)wedge.Indices32.size();
-
-	//adding submesh
-	//box
-	SubmeshGeometry boxSubmesh;
-	boxSubmesh.IndexCount = (UINT)box.Indices32.size();
-	boxSubmesh.StartIndexLocation = boxIndexOffset;
-	boxSubmesh.BaseVertexLocation = boxVertexOffset;
-	//cylinder
-	SubmeshGeometry cylinderSubmesh;
-	cylinderSubmesh.IndexCount = (UINT)cylinder.Indices32.size();
-	cylinderSubmesh.StartIndexLocation = cylinderIndexOffset;
-	cylinderSubmesh.BaseVertexLocation = cylinderVertexOffset;
-	//sphere
-	SubmeshGeometry sphereSubmesh;
-	sphereSubmesh.IndexCount = (UINT)sphere.Indices32.size();
-	sphereSubmesh.StartIndexLocation = sphereIndexOffset;
-	sphereSubmesh.BaseVertexLocation = sphereVertexOffset;
-	//geosphere
-	SubmeshGeometry geoSphereSubmesh;
-	geoSphereSubmesh.IndexCount = (UINT)GEOsphere.Indices32.size();
-	geoSphereSubmesh.StartIndexLocation = geoSphereIndexOffset;
-	geoSphereSubmesh.BaseVertexLocation = geoSphereVertexOffset;
-	//quad
-	SubmeshGeometry quadSubmesh;
-	quadSubmesh.IndexCount = (UINT)quad.Indices32.size();
-	quadSubmesh.StartIndexLocation = quadIndexOffset;
-	quadSubmesh.BaseVertexLocation = quadVertexOffset;
-	//tri prism
-	SubmeshGeometry triPrismSubmesh;
-	triPrismSubmesh.IndexCount = (UINT)triPrism.Indices32.size();
-	triPrismSubmesh.StartIndexLocation = triPrismIndexOffset;
-	triPrismSubmesh.BaseVertexLocation = triPrismVertexOffset;
-	//cone
-	SubmeshGeometry coneSubmesh;
-	coneSubmesh.IndexCount = (UINT)cone.Indices32.size();
-	coneSubmesh.StartIndexLocation = coneIndexOffset;
-	coneSubmesh.BaseVertexLocation = coneVertexOffset;
-	//pyramid
-	SubmeshGeometry pyramidSubmesh;
-	pyramidSubmesh.IndexCount = (UINT)pyramid.Indices32.size();
-	pyramidSubmesh.StartIndexLocation = pyramidIndexOffset;
-	pyramidSubmesh.BaseVertexLocation = pyramidVertexOffset;
-	//diamond
-	SubmeshGeometry diamondSubmesh;
-	diamondSubmesh.IndexCount = (UINT)diamond.Indices32.size();
-	diamondSubmesh.StartIndexLocation = diamondIndexOffset;
-	diamondSubmesh.BaseVertexLocation = diamondVertexOffset;
-	//wedge
-	SubmeshGeometry wedgeSubmesh;
-	wedgeSubmesh.IndexCount = (UINT)wedge.Indices32.size();
-	wedgeSubmesh.StartIndexLocation = wedgeIndexOffset;
-	wedgeSubmesh.BaseVertexLocation = wedgeVertexOffset;
-	//torus
-	SubmeshGeometry torusSubmesh;
-	torusSubmesh.IndexCount = (UINT)torus.Indices32.size();
-	torusSubmesh.StartIndexLocation = torusIndexOffset;
-	torusSubmesh.BaseVertexLocation = torusVertexOffset;
-
-	//total vertex count
-	auto totalVertexCount =
-		box.Vertices.size() +
-		cylinder.Vertices.size() +
-		sphere.Vertices.size() +
-		GEOsphere.Vertices.size() +
-		quad.Vertices.size() +
-		triPrism.Vertices.size() +
-		cone.Vertices.size() +
-		pyramid.Vertices.size() +
-		diamond.Vertices.size() +
-		wedge.Vertices.size() +
-		torus.Vertices.size();
-
-	//Calculate the bound box
-	//step1 
-	XMFLOAT3 vMinf3(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
-	XMFLOAT3 vMaxf3(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
-
-	XMVECTOR vMin = XMLoadFloat3(&vMinf3);
-	XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
-
-	std::vector<Vertex> vertices(totalVertexCount); //array
-	UINT k = 0;
-	for (size_t i = 0; i < box.Vertices.size(); ++i, ++k)
+	GeometryCache::Key key = MakeGeometryKey("boxGeo");
+	for(const ShapeParams& params : gBoxGeoShapes)
+		key.Add(params.Generator, params.Values, params.Count);
+	if(LoadCachedGeometry(key, "boxGeo", { "geosphere" }))
+		return;
+
+	//the denser shapes get a vertex cache pass, the round ones an LOD chain as well.
+	//each optimized shape writes its report to its own slot, since the shapes are built
+	//on worker threads; they are logged in order once the batch is done
+	enum { BoxReport, CylinderReport, SphereReport, GeosphereReport, TorusReport, ReportCount };
+	std::string optimizeReports[ReportCount];
+	auto optimize = [&optimizeReports](int slot, const char* name, GeometryGenerator::MeshData& mesh)
 	{
-		auto& p = box.Vertices[i].Position;
-		vertices[k].Pos = p;
-		vertices[k].Normal = box.Vertices[i].Normal;
-		vertices[k].TexC = box.Vertices[i].TexC;
-		//Calculate the bound box per shape
-		//step 2 - finding the min and max along the verticies of the shape
-		XMVECTOR Pos = XMLoadFloat3(&box.Vertices[i].Position);
-		vMin = XMVectorMin(vMin, Pos);
-		vMax = XMVectorMax(vMax, Pos);
-	}
-	//step 3 - bounding box calculation
-	BoundingBox bounds;
-	XMStoreFloat3(&bounds.Center, 0.5f * (vMin + vMax));
-	XMStoreFloat3(&bounds.Extents, 0.5f * (vMax - vMin));
-	//step 4 - assigning the bounds to the submesh
-	boxSubmesh.Bounds = bounds;
-	vMin = XMLoadFloat3(&vMinf3);
-	vMax = XMLoadFloat3(&vMaxf3);
-
-	for (size_t i = 0; i < cylinder.Vertices.size(); ++i, ++k)
+		optimizeReports[slot] = MeshOptimizer::FormatReport(name, MeshOptimizer::Optimize(mesh));
+	};
+	auto addLods = [](MeshBatchBuilder::Shape& shape)
 	{
-		vertices[k].Pos = cylinder.Vertices[i].Position;
-		vertices[k].Normal = cylinder.Vertices[i].Normal;
-		vertices[k].TexC = cylinder.Vertices[i].TexC;
-		//vertices[k].Color = XMFLOAT4(DirectX::Colors::SteelBlue);
-		//Calculate the bound box per shape
-		XMVECTOR Pos = XMLoadFloat3(&cylinder.Vertices[i].Position);
-		vMin = XMVectorMin(vMin, Pos);
-		vMax = XMVectorMax(vMax, Pos);
-	}
-	XMStoreFloat3(&bounds.Center, 0.5f * (vMin + vMax));
-	XMStoreFloat3(&bounds.Extents, 0.5f * (vMax - vMin));
-	//step 4
-	cylinderSubmesh.Bounds = bounds;
-	vMin = XMLoadFloat3(&vMinf3);
-	vMax = XMLoadFloat3(&vMaxf3);
-
-	for (size_t i = 0; i < sphere.Vertices.size(); ++i, ++k)
+		std::vector<MeshSimplifier::LodLevel> chain = MeshSimplifier::BuildLodChain(shape.Mesh, 3);
+		for(size_t i = 0; i < chain.size(); ++i)
+		{
+			MeshSimplifier::LodLevel& lod = chain[i];
+			MeshOptimizer::OptimizeVertexCache(lod.Indices.data(), lod.Indices.size(), shape.Mesh.Vertices.size());
+			shape.Extras.push_back({ "_lod" + std::to_string(i + 1), std::move(lod.Indices), lod.Error });
+		}
+	};
+
+	MeshletMesh geoSphereClusters;
+
+	//DECLARE SHAPES - generated in parallel, packed in this order
+	MeshBatchBuilder batch;
+	batch.Add("box", [&](GeometryGenerator& geoGen, MeshBatchBuilder::Shape& shape)
 	{
-		vertices[k].Pos = sphere.Vertices[i].Position;
-		vertices[k].Normal = sphere.Vertices[i].Normal;
-		vertices[k].TexC = sphere.Vertices[i].TexC;
-		//vertices[k].Color = XMFLOAT4(DirectX::Colors::DarkOliveGreen);
-		//Calculate the bound box per shape
-		XMVECTOR Pos = XMLoadFloat3(&sphere.Vertices[i].Position);
-		vMin = XMVectorMin(vMin, Pos);
-		vMax = XMVectorMax(vMax, Pos);
-	}
-	XMStoreFloat3(&bounds.Center, 0.5f * (vMin + vMax));
-	XMStoreFloat3(&bounds.Extents, 0.5f * (vMax - vMin));
-	//step 4
-	sphereSubmesh.Bounds = bounds;
-	vMin = XMLoadFloat3(&vMinf3);
-	vMax = XMLoadFloat3(&vMaxf3);
-
-	for (size_t i = 0; i < GEOsphere.Vertices.size(); ++i, ++k)
+		const ShapeParams& p = gBoxGeoShapes[BoxShape];
+		shape.Mesh = geoGen.CreateBox(p[0], p[1], p[2], p.Int(3));
+		optimize(BoxReport, "box", shape.Mesh);
+	});
+	batch.Add("cylinder", [&](GeometryGenerator& geoGen, MeshBatchBuilder::Shape& shape)
 	{
-		vertices[k].Pos = GEOsphere.Vertices[i].Position;
-		vertices[k].Normal = GEOsphere.Vertices[i].Normal;
-		vertices[k].TexC = GEOsphere.Vertices[i].TexC;
-		//vertices[k].Color = XMFLOAT4(DirectX::Colors::Orange);
-		//Calculate the bound box per shape
-		XMVECTOR Pos = XMLoadFloat3(&GEOsphere.Vertices[i].Position);
-		vMin = XMVectorMin(vMin, Pos);
-		vMax = XMVectorMax(vMax, Pos);
-	}
-	XMStoreFloat3(&bounds.Center, 0.5f * (vMin + vMax));
-	XMStoreFloat3(&bounds.Extents, 0.5f * (vMax - vMin));
-	//step 4
-	geoSphereSubmesh.Bounds = bounds;
-	vMin = XMLoadFloat3(&vMinf3);
-	vMax = XMLoadFloat3(&vMaxf3);
-
-	for (size_t i = 0; i < quad.Vertices.size(); ++i, ++k)
+		const ShapeParams& p = gBoxGeoShapes[CylinderShape];
+		shape.Mesh = geoGen.CreateCylinder(p[0], p[1], p[2], p.Int(3), p.Int(4));
+		optimize(CylinderReport, "cylinder", shape.Mesh);
+		addLods(shape);
+	});
+	batch.Add("sphere", [&](GeometryGenerator& geoGen, MeshBatchBuilder::Shape& shape)
 	{
-		vertices[k].Pos = quad.Vertices[i].Position;
-		vertices[k].Normal = quad.Vertices[i].Normal;
-		vertices[k].TexC = quad.Vertices[i].TexC;
-		//vertices[k].Color = XMFLOAT4(DirectX::Colors::DarkOliveGreen);
-		//Calculate the bound box per shape
-		XMVECTOR Pos = XMLoadFloat3(&quad.Vertices[i].Position);
-		vMin = XMVectorMin(vMin, Pos);
-		vMax = XMVectorMax(vMax, Pos);
-	}
-	XMStoreFloat3(&bounds.Center, 0.5f * (vMin + vMax));
-	XMStoreFloat3(&bounds.Extents, 0.5f * (vMax - vMin));
-	//step 4
-	quadSubmesh.Bounds = bounds;
-	vMin = XMLoadFloat3(&vMinf3);
-	vMax = XMLoadFloat3(&vMaxf3);
-
-	for (size_t i = 0; i < triPrism.Vertices.size(); ++i, ++k)
+		const ShapeParams& p = gBoxGeoShapes[SphereShape];
+		shape.Mesh = geoGen.CreateSphere(p[0], p.Int(1), p.Int(2));
+		optimize(SphereReport, "sphere", shape.Mesh);
+		addLods(shape);
+	});
+	batch.Add("geosphere", [&](GeometryGenerator& geoGen, MeshBatchBuilder::Shape& shape)
 	{
-		vertices[k].Pos = triPrism.Vertices[i].Position;
-		vertices[k].Normal = triPrism.Vertices[i].Normal;
-		vertices[k].TexC = triPrism.Vertices[i].TexC;
-		//vertices[k].Color = XMFLOAT4(DirectX::Colors::DarkSlateGray);
-		//Calculate the bound box per shape
-		XMVECTOR Pos = XMLoadFloat3(&triPrism.Vertices[i].Position);
-		vMin = XMVectorMin(vMin, Pos);
-		vMax = XMVectorMax(vMax, Pos);
-	}
-	XMStoreFloat3(&bounds.Center, 0.5f * (vMin + vMax));
-	XMStoreFloat3(&bounds.Extents, 0.5f * (vMax - vMin));
-	//step 4
-	triPrismSubmesh.Bounds = bounds;
-	vMin = XMLoadFloat3(&vMinf3);
-	vMax = XMLoadFloat3(&vMaxf3);
-
-	for (size_t i = 0; i < cone.Vertices.size(); ++i, ++k)
+		const ShapeParams& p = gBoxGeoShapes[GeosphereShape];
+		shape.Mesh = geoGen.CreateGeosphere(p[0], p.Int(1));
+		optimize(GeosphereReport, "geosphere", shape.Mesh);
+
+		//the geosphere is drawn as meshlets, in meshlet order
+		MeshletBuilder::Build(shape.Mesh, geoSphereClusters);
+		shape.Mesh.Indices32 = geoSphereClusters.Indices;
+		addLods(shape);
+	});
+	batch.Add("quad", [&](GeometryGenerator& geoGen, MeshBatchBuilder::Shape& shape)
 	{
-		vertices[k].Pos = cone.Vertices[i].Position;
-		vertices[k].Normal = cone.Vertices[i].Normal;
-		vertices[k].TexC = cone.Vertices[i].TexC;
-		//vertices[k].Color = XMFLOAT4(DirectX::Colors::DimGray);
-		//Calculate the bound box per shape
-		XMVECTOR Pos = XMLoadFloat3(&cone.Vertices[i].Position);
-		vMin = XMVectorMin(vMin, Pos);
-		vMax = XMVectorMax(vMax, Pos);
-	}
-	XMStoreFloat3(&bounds.Center, 0.5f * (vMin + vMax));
-	XMStoreFloat3(&bounds.Extents, 0.5f * (vMax - vMin));
-	//step 4
-	coneSubmesh.Bounds = bounds;
-	vMin = XMLoadFloat3(&vMinf3);
-	vMax = XMLoadFloat3(&vMaxf3);
-
-	for (size_t i = 0; i < pyramid.Vertices.size(); ++i, ++k)
+		const ShapeParams& p = gBoxGeoShapes[QuadShape];
+		shape.Mesh = geoGen.CreateQuad(p[0], p[1], p[2], p[3], p[4]);
+	});
+	batch.Add("triprism", [&](GeometryGenerator& geoGen, MeshBatchBuilder::Shape& shape)
 	{
-		vertices[k].Pos = pyramid.Vertices[i].Position;
-		vertices[k].Normal = pyramid.Vertices[i].Normal;
-		vertices[k].TexC = pyramid.Vertices[i].TexC;
-		//vertices[k].Color = XMFLOAT4(DirectX::Colors::DarkOliveGreen);
-		//Calculate the bound box per shape
-		XMVECTOR Pos = XMLoadFloat3(&pyramid.Vertices[i].Position);
-		vMin = XMVectorMin(vMin, Pos);
-		vMax = XMVectorMax(vMax, Pos);
-	}
+		const ShapeParams& p = gBoxGeoShapes[TriPrismShape];
+		shape.Mesh = geoGen.CreateTriangularPrism(p[0], p[1], p.Int(2));
+	});
+	batch.Add("cone", [&](GeometryGenerator& geoGen, MeshBatchBuilder::Shape& shape)
+	{
+		const ShapeParams& p = gBoxGeoShapes[ConeShape];
+		shape.Mesh = geoGen.CreateCone(p[0], p[1], p.Int(2), p.Int(3));
+		addLods(shape);
+	});
+	batch.Add("pyramid", [&](GeometryGenerator& geoGen, MeshBatchBuilder::Shape& shape)
+	{
+		const ShapeParams& p = gBoxGeoShapes[PyramidShape];
+		shape.Mesh = geoGen.CreatePyramid(p[0], p[1], p.Int(2));
+	});
+	batch.Add("diamond", [&](GeometryGenerator& geoGen, MeshBatchBuilder::Shape& shape)
+	{
+		const ShapeParams& p = gBoxGeoShapes[DiamondShape];
+		shape.Mesh = geoGen.CreateDiamond(p[0], p[1], p[2], p.Int(3));
+	});
+	batch.Add("wedge", [&](GeometryGenerator& geoGen, MeshBatchBuilder::Shape& shape)
+	{
+		const ShapeParams& p = gBoxGeoShapes[WedgeShape];
+		shape.Mesh = geoGen.CreateWedge(p[0], p[1], p[2], p.Int(3));
+	});
+	batch.Add("torus", [&](GeometryGenerator& geoGen, MeshBatchBuilder::Shape& shape)
+	{
+		const ShapeParams& p = gBoxGeoShapes[TorusShape];
+		shape.Mesh = geoGen.CreateTorus(p[0], p[1], p.Int(2), p.Int(3));
+		optimize(TorusReport, "torus", shape.Mesh);
+		addLods(shape);
+	});
+	batch.Build();
 
-	XMStoreFloat3(&bounds.Center, 0.5f * (vMin + vMax));
-	XMStoreFloat3(&bounds.Extents, 0.5f * (vMax - vMin));
-	//step 4
-	pyramidSubmesh.Bounds = bounds;
-	vMin = XMLoadFloat3(&vMinf3);
-	vMax = XMLoadFloat3(&vMaxf3);
+#if defined(DEBUG) | defined(_DEBUG)
+	for(const std::string& report : optimizeReports)
+		::OutputDebugStringA(report.c_str());
+#endif
 
-	for (size_t i = 0; i < diamond.Vertices.size(); ++i, ++k)
+	std::vector<Vertex> vertices(batch.VertexCount());
+	batch.WriteVertices(vertices.data(), [](const GeometryGenerator::Vertex& in, Vertex& out)
 	{
-		vertices[k].Pos = diamond.Vertices[i].Position;
-		vertices[k].Normal = diamond.Vertices[i].Normal;
-		vertices[k].TexC = diamond.Vertices[i].TexC;
-		//vertices[k].Color = XMFLOAT4(DirectX::Colors::CornflowerBlue);
-		//Calculate the bound box per shape
-		XMVECTOR Pos = XMLoadFloat3(&diamond.Vertices[i].Position);
-		vMin = XMVectorMin(vMin, Pos);
-		vMax = XMVectorMax(vMax, Pos);
-	}
-	XMStoreFloat3(&bounds.Center, 0.5f * (vMin + vMax));
-	XMStoreFloat3(&bounds.Extents, 0.5f * (vMax - vMin));
-	//step 4
-	diamondSubmesh.Bounds = bounds;
-	vMin = XMLoadFloat3(&vMinf3);
-	vMax = XMLoadFloat3(&vMaxf3);
-
-	for (size_t i = 0; i < wedge.Vertices.size(); ++i, ++k)
+		out.Pos = in.Position;
+		out.Normal = in.Normal;
+		out.TexC = in.TexC;
+	});
+
+	//indices are relative to each shape's base vertex, so 16 bits normally do
+	const bool use16BitIndices = batch.Fits16BitIndices();
+	std::vector<std::uint16_t> indices16;
+	std::vector<std::uint32_t> indices32;
+	const void* indexData = nullptr;
+	if(use16BitIndices)
 	{
-		vertices[k].Pos = wedge.Vertices[i].Position;
-		vertices[k].Normal = wedge.Vertices[i].Normal;
-		vertices[k].TexC = wedge.Vertices[i].TexC;
-		//vertices[k].Color = XMFLOAT4(DirectX::Colors::DimGray);
-		//Calculate the bound box per shape
-		XMVECTOR Pos = XMLoadFloat3(&wedge.Vertices[i].Position);
-		vMin = XMVectorMin(vMin, Pos);
-		vMax = XMVectorMax(vMax, Pos);
+		indices16.resize(batch.IndexCount());
+		batch.WriteIndices(indices16.data());
+		indexData = indices16.data();
 	}
-	XMStoreFloat3(&bounds.Center, 0.5f * (vMin + vMax));
-	XMStoreFloat3(&bounds.Extents, 0.5f * (vMax - vMin));
-	//step 4
-	wedgeSubmesh.Bounds = bounds;
-	vMin = XMLoadFloat3(&vMinf3);
-	vMax = XMLoadFloat3(&vMaxf3);
-
-	for (size_t i = 0; i < torus.Vertices.size(); ++i, ++k)
+	else
 	{
-		vertices[k].Pos = torus.Vertices[i].Position;
-		vertices[k].Normal = torus.Vertices[i].Normal;
-		vertices[k].TexC = torus.Vertices[i].TexC;
-		//vertices[k].Color = XMFLOAT4(DirectX::Colors::DarkOliveGreen);
-		//Calculate the bound box per shape
-		XMVECTOR Pos = XMLoadFloat3(&torus.Vertices[i].Position);
-		vMin = XMVectorMin(vMin, Pos);
-		vMax = XMVectorMax(vMax, Pos);
+		indices32.resize(batch.IndexCount());
+		batch.WriteIndices(indices32.data());
+		indexData = indices32.data();
 	}
-	XMStoreFloat3(&bounds.Center, 0.5f * (vMin + vMax));
-	XMStoreFloat3(&bounds.Extents, 0.5f * (vMax - vMin));
-	//step 4
-	torusSubmesh.Bounds = bounds;
-	vMin = XMLoadFloat3(&vMinf3);
-	vMax = XMLoadFloat3(&vMaxf3);
-
-	//inserting the indices
-	std::vector<std::uint16_t> indices;
-	indices.insert(indices.end(), std::begin(box.GetIndices16()), std::end(box.GetIndices16()));
-	indices.insert(indices.end(), std::begin(cylinder.GetIndices16()), std::end(cylinder.GetIndices16()));
-	indices.insert(indices.end(), std::begin(sphere.GetIndices16()), std::end(sphere.GetIndices16()));
-	indices.insert(indices.end(), std::begin(GEOsphere.GetIndices16()), std::end(GEOsphere.GetIndices16()));
-	indices.insert(indices.end(), std::begin(quad.GetIndices16()), std::end(quad.GetIndices16()));
-	indices.insert(indices.end(), std::begin(triPrism.GetIndices16()), std::end(triPrism.GetIndices16()));
-	indices.insert(indices.end(), std::begin(cone.GetIndices16()), std::end(cone.GetIndices16()));
-	indices.insert(indices.end(), std::begin(pyramid.GetIndices16()), std::end(pyramid.GetIndices16()));
-	indices.insert(indices.end(), std::begin(diamond.GetIndices16()), std::end(diamond.GetIndices16()));
-	indices.insert(indices.end(), std::begin(wedge.GetIndices16()), std::end(wedge.GetIndices16()));
-	indices.insert(indices.end(), std::begin(torus.GetIndices16()), std::end(torus.GetIndices16()));
 
 	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
+	const UINT ibByteSize = (UINT)batch.IndexCount() * (use16BitIndices ? sizeof(std::uint16_t) : sizeof(std::uint32_t));
 
 	//draw the shape
 	auto geo = std::make_unique<MeshGeometry>();
@@ -1546,33 +1646,168 @@ void TreeBillboardsApp::BuildBoxGeometry()
 	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
 
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indexData, ibByteSize);
 
 	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
 		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
 
 	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+		mCommandList.Get(), indexData, ibByteSize, geo->IndexBufferUploader);
 
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
+	geo->IndexFormat = use16BitIndices ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
 	geo->IndexBufferByteSize = ibByteSize;
 
-	//geo drawing
-	geo->DrawArgs["box"] = boxSubmesh;
-	geo->DrawArgs["cylinder"] = cylinderSubmesh;
-	geo->DrawArgs["sphere"] = sphereSubmesh;
-	geo->DrawArgs["geosphere"] = geoSphereSubmesh;
-	geo->DrawArgs["quad"] = quadSubmesh;
-	geo->DrawArgs["triprism"] = triPrismSubmesh;
-	geo->DrawArgs["cone"] = coneSubmesh;
-	geo->DrawArgs["pyramid"] = pyramidSubmesh;
-	geo->DrawArgs["diamond"] = diamondSubmesh;
-	geo->DrawArgs["wedge"] = wedgeSubmesh;
-	geo->DrawArgs["torus"] = torusSubmesh;
+	//one submesh per shape and LOD, bounds included
+	batch.FillDrawArgs(geo->DrawArgs);
+	mClusterSets["geosphere"] = std::make_unique<ClusterSet>(std::move(geoSphereClusters), geo->DrawArgs["geosphere"].StartIndexLocation);
 
 	mGeometries["boxGeo"] = std::move(geo);
+	StoreCachedGeometry(key, "boxGeo", { "geosphere" });
+}
+
+bool TreeBillboardsApp::LoadCachedGeometry(const GeometryCache::Key& key, const std::string& geoName,
+	std::initializer_list<const char*> clusterSets)
+{
+	++mGeometryCacheLookups;
+	std::unique_ptr<GeometryCache::Entry> entry = mGeometryCache.Load(key);
+	if(!entry)
+		return false;
+
+	size_t layoutCount = 0;
+	size_t submeshCount = 0;
+	size_t vbByteSize = 0;
+	size_t ibByteSize = 0;
+	const CachedGeometryLayout* layout = entry->FindArray<CachedGeometryLayout>("layout", layoutCount);
+	const CachedSubmesh* submeshes = entry->FindArray<CachedSubmesh>("submeshes", submeshCount);
+	const void* vertexData = entry->Find("vertices", vbByteSize);
+	const void* indexData = entry->Find("indices", ibByteSize);
+	if(layout == nullptr || layoutCount != 1 || submeshes == nullptr || vertexData == nullptr || indexData == nullptr)
+		return false;
+
+	// Read the cluster sets before creating anything so an incomplete file just
+	// falls back to generating.
+	std::vector<std::pair<std::string, std::unique_ptr<ClusterSet>>> clusters;
+	for(const char* name : clusterSets)
+	{
+		std::string prefix = std::string(name) + ".";
+
+		MeshletMesh mesh;
+		std::vector<UINT> start;
+		if(!entry->Read((prefix + "meshlets").c_str(), mesh.Meshlets) ||
+			!entry->Read((prefix + "bounds").c_str(), mesh.Bounds) ||
+			!entry->Read((prefix + "vertices").c_str(), mesh.UniqueVertexIndices) ||
+			!entry->Read((prefix + "primitives").c_str(), mesh.PrimitiveIndices) ||
+			!entry->Read((prefix + "indices").c_str(), mesh.Indices) ||
+			!entry->Read((prefix + "start").c_str(), start) || start.size() != 1)
+			return false;
+
+		clusters.emplace_back(name, std::make_unique<ClusterSet>(std::move(mesh), start[0]));
+	}
+
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = geoName;
+
+	// The mapped file is the source for both the CPU copies and the GPU upload.
+	if(vbByteSize > 0)
+	{
+		ThrowIfFailed(D3DCreateBlob((UINT)vbByteSize, &geo->VertexBufferCPU));
+		CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertexData, vbByteSize);
+
+		geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+			mCommandList.Get(), vertexData, (UINT64)vbByteSize, geo->VertexBufferUploader);
+	}
+
+	ThrowIfFailed(D3DCreateBlob((UINT)ibByteSize, &geo->IndexBufferCPU));
+	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indexData, ibByteSize);
+
+	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+		mCommandList.Get(), indexData, (UINT64)ibByteSize, geo->IndexBufferUploader);
+
+	geo->VertexByteStride = layout->VertexByteStride;
+	geo->VertexBufferByteSize = layout->VertexBufferByteSize;
+	geo->IndexFormat = (DXGI_FORMAT)layout->IndexFormat;
+	geo->IndexBufferByteSize = layout->IndexBufferByteSize;
+
+	for(size_t i = 0; i < submeshCount; ++i)
+	{
+		SubmeshGeometry submesh;
+		submesh.IndexCount = submeshes[i].IndexCount;
+		submesh.StartIndexLocation = submeshes[i].StartIndexLocation;
+		submesh.BaseVertexLocation = submeshes[i].BaseVertexLocation;
+		submesh.LodError = submeshes[i].LodError;
+		submesh.Bounds.Center = submeshes[i].BoundsCenter;
+		submesh.Bounds.Extents = submeshes[i].BoundsExtents;
+		geo->DrawArgs[submeshes[i].Name] = submesh;
+	}
+
+	mGeometries[geoName] = std::move(geo);
+	for(auto& c : clusters)
+		mClusterSets[c.first] = std::move(c.second);
+
+	++mGeometryCacheHits;
+	return true;
+}
+
+void TreeBillboardsApp::StoreCachedGeometry(const GeometryCache::Key& key, const std::string& geoName,
+	std::initializer_list<const char*> clusterSets)
+{
+	MeshGeometry* geo = mGeometries[geoName].get();
+
+	CachedGeometryLayout layout;
+	layout.VertexByteStride = geo->VertexByteStride;
+	layout.VertexBufferByteSize = geo->VertexBufferByteSize;
+	layout.IndexFormat = (std::uint32_t)geo->IndexFormat;
+	layout.IndexBufferByteSize = geo->IndexBufferByteSize;
+
+	std::vector<CachedSubmesh> submeshes;
+	for(auto& arg : geo->DrawArgs)
+	{
+		CachedSubmesh submesh;
+		if(arg.first.size() >= sizeof(submesh.Name))
+		{
+			::OutputDebugStringA(("Could not write the geometry cache for " + geoName + ": submesh name " + arg.first + " is too long\n").c_str());
+			return;
+		}
+
+		CopyMemory(submesh.Name, arg.first.c_str(), arg.first.size());
+		submesh.IndexCount = arg.second.IndexCount;
+		submesh.StartIndexLocation = arg.second.StartIndexLocation;
+		submesh.BaseVertexLocation = arg.second.BaseVertexLocation;
+		submesh.LodError = arg.second.LodError;
+		submesh.BoundsCenter = arg.second.Bounds.Center;
+		submesh.BoundsExtents = arg.second.Bounds.Extents;
+		submeshes.push_back(submesh);
+	}
+
+	std::vector<GeometryCache::Section> sections;
+	sections.push_back({ "layout", &layout, sizeof(layout) });
+	sections.push_back(GeometryCache::MakeSection("submeshes", submeshes));
+	sections.push_back({ "vertices",
+		geo->VertexBufferCPU ? geo->VertexBufferCPU->GetBufferPointer() : nullptr,
+		geo->VertexBufferCPU ? geo->VertexBufferCPU->GetBufferSize() : 0 });
+	sections.push_back({ "indices", geo->IndexBufferCPU->GetBufferPointer(), geo->IndexBufferCPU->GetBufferSize() });
+
+	// Sections point at these, so they have to outlive the Store call.
+	std::vector<std::vector<UINT>> starts;
+	starts.reserve(clusterSets.size());
+	for(const char* name : clusterSets)
+	{
+		std::string prefix = std::string(name) + ".";
+		const ClusterSet& clusters = *mClusterSets[name];
+
+		starts.push_back({ clusters.StartIndexLocation });
+		sections.push_back(GeometryCache::MakeSection(prefix + "meshlets", clusters.Mesh.Meshlets));
+		sections.push_back(GeometryCache::MakeSection(prefix + "bounds", clusters.Mesh.Bounds));
+		sections.push_back(GeometryCache::MakeSection(prefix + "vertices", clusters.Mesh.UniqueVertexIndices));
+		sections.push_back(GeometryCache::MakeSection(prefix + "primitives", clusters.Mesh.PrimitiveIndices));
+		sections.push_back(GeometryCache::MakeSection(prefix + "indices", clusters.Mesh.Indices));
+		sections.push_back(GeometryCache::MakeSection(prefix + "start", starts.back()));
+	}
+
+	if(!mGeometryCache.Store(key, sections))
+		::OutputDebugStringA(("Could not write the geometry cache for " + geoName + "\n").c_str());
 }
 
 void TreeBillboardsApp::BuildTreeSpritesGeometry()
@@ -1584,42 +1819,41 @@ void TreeBillboardsApp::BuildTreeSpritesGeometry()
 		XMFLOAT2 Size;
 	};
 
+	//the trees stand in the band of low ground between the plateau (45 units from
+	//the centre) and the edge of the land (62.5), so every one has land under it
 	static const int treeCount = 64;
+	const XMFLOAT2 treeSize(50.0f, 50.0f);
 	std::array<TreeSpriteVertex, 64> vertices;
 	for(UINT i = 0; i < treeCount; ++i)
 	{
+		float x, z;
+
 		//first quater - left side 
 		if (i < treeCount / 4)
 		{ 
-			float x = MathHelper::RandF(-200.0f, -200.0f); //for the trees
-			float z = MathHelper::RandF(-200.0f, 200.0f); //for the trees
-			float y = 12.0f;		
-
-			vertices[i].Pos = XMFLOAT3(x, y, z);
-			vertices[i].Size = XMFLOAT2(50.0f, 50.0f);
+			x = MathHelper::RandF(-60.0f, -50.0f);
+			z = MathHelper::RandF(-60.0f, 60.0f);
 		}
 		//second quater - right side
 		else if (i < treeCount / 2)
 		{
-			float x = MathHelper::RandF(200.0f, 200.0f); //for the trees
-			float z = MathHelper::RandF(-200.0f, 200.0f); //for the trees
-			float y = 12.0f;
-
-			vertices[i].Pos = XMFLOAT3(x, y, z);
-			vertices[i].Size = XMFLOAT2(50.0f, 50.0f);
+			x = MathHelper::RandF(50.0f, 60.0f);
+			z = MathHelper::RandF(-60.0f, 60.0f);
 		}
 		//far back
 		else
 		{
-			float x = MathHelper::RandF(-200.0f, 200.0f);
-			float z = MathHelper::RandF(200.0f, 200.0f);
-			float y = 10.0f; //GetHillsHeight(x, z);
-
-			vertices[i].Pos = XMFLOAT3(x, y, z);
-			vertices[i].Size = XMFLOAT2(50.0f, 50.0f);
+			x = MathHelper::RandF(-60.0f, 60.0f);
+			z = MathHelper::RandF(50.0f, 60.0f);
 		}
+
+		vertices[i].Pos = XMFLOAT3(x, 0.0f, z);
+		vertices[i].Size = treeSize;
 	}
 
+	//the billboards are centred on Pos, so lift them half their height off the land
+	mLand.PlaceOnSurface(&vertices[0].Pos, sizeof(TreeSpriteVertex), vertices.size(), 0.5f * treeSize.y);
+
 	std::array<std::uint16_t, 64> indices =
 	{
 		0, 1, 2, 3, 4, 5, 6, 7,
@@ -1662,6 +1896,7 @@ void TreeBillboardsApp::BuildTreeSpritesGeometry()
 	submesh.BaseVertexLocation = 0;
 
 	geo->DrawArgs["points"] = submesh;
+	BoundsBuilder::ComputeSubmeshBounds(*geo);
 
 	mGeometries["treeSpritesGeo"] = std::move(geo);
 }
@@ -1675,30 +1910,22 @@ void TreeBillboardsApp::BuildStatueSpriteGeometry()
 		XMFLOAT2 Size;
 	};
 
+	//one statue either side of the castle, on the plateau
 	static const int treeCount = 2;
+	const XMFLOAT2 statueSize(50.0f, 80.0f);
 	std::array<TreeSpriteVertex, 2> vertices;
 	for (UINT i = 0; i < treeCount; ++i)
 	{
-		
-		float x, y, z = 12.0f;
-		//float x, z;
-		if (i < 1)
-		{
-			
-			x = -40.0f;
-			z = 30.0f;
-			y = 15.0f;
-		}
-		else
-		{
-			x = 40.0f;
-			z = 30.0f;
-			y = 15.0f;
-		}
-		vertices[i].Pos = XMFLOAT3(x, y, z);
-		vertices[i].Size = XMFLOAT2(50.0f, 80.0f);
+		float x = (i < 1) ? -40.0f : 40.0f;
+		float z = 30.0f;
+
+		vertices[i].Pos = XMFLOAT3(x, 0.0f, z);
+		vertices[i].Size = statueSize;
 	}
 
+	//centred billboards: half their height above the plateau
+	mLand.PlaceOnSurface(&vertices[0].Pos, sizeof(TreeSpriteVertex), vertices.size(), 0.5f * statueSize.y);
+
 	std::array<std::uint16_t, 16> indices =
 	{
 		0, 1
@@ -1733,6 +1960,7 @@ void TreeBillboardsApp::BuildStatueSpriteGeometry()
 	submesh.BaseVertexLocation = 0;
 
 	geo->DrawArgs["points"] = submesh;
+	BoundsBuilder::ComputeSubmeshBounds(*geo);
 
 	mGeometries["statueSpritesGeo"] = std::move(geo);
 }
@@ -1774,6 +2002,18 @@ void TreeBillboardsApp::BuildPSOs()
 	opaquePsoDesc.DSVFormat = mDepthStencilFormat;
     ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&mPSOs["opaque"])));
 
+	//
+	// PSO for the terrain patches
+	//
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC terrainPsoDesc = opaquePsoDesc;
+	terrainPsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["terrainVS"]->GetBufferPointer()),
+		mShaders["terrainVS"]->GetBufferSize()
+	};
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&terrainPsoDesc, IID_PPV_ARGS(&mPSOs["terrain"])));
+
 	//
 	// PSO for transparent objects
 	//
@@ -1966,36 +2206,42 @@ void TreeBillboardsApp::BuildRenderItems()
 	UINT objCBIndex = 0;
 
     auto wavesRitem = std::make_unique<RenderItem>();
-    wavesRitem->World = MathHelper::Identity4x4();
-	XMStoreFloat4x4(&wavesRitem->TexTransform, XMMatrixScaling(5.0f, 5.0f, 1.0f));
-	wavesRitem->ObjCBIndex = objCBIndex;
-	wavesRitem->Mat = mMaterials["water"].get();
-	wavesRitem->Geo = mGeometries["waterGeo"].get();
+	SceneStore::Desc wavesDesc;
+	wavesDesc.Name = "waves";
+	XMStoreFloat4x4(&wavesDesc.TexTransform, XMMatrixScaling(5.0f, 5.0f, 1.0f));
+	wavesDesc.ObjCBIndex = objCBIndex;
+	wavesDesc.Mat = mMaterials["water"].get();
+	wavesDesc.Geo = mGeometries["waterGeo"].get();
+	wavesDesc.Layers = 1u << (int)RenderLayer::Transparent;
+	//the surface moves, so give it a few units of room above and below the rest height
+	wavesDesc.LocalBounds = BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.5f * mWaves->Width(), 5.0f, 0.5f * mWaves->Depth()));
+	wavesRitem->Handle = mScene.Add(wavesDesc);
 	wavesRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	wavesRitem->IndexCount = wavesRitem->Geo->DrawArgs["grid"].IndexCount;
-	wavesRitem->StartIndexLocation = wavesRitem->Geo->DrawArgs["grid"].StartIndexLocation;
-	wavesRitem->BaseVertexLocation = wavesRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
+	wavesRitem->IndexCount = wavesDesc.Geo->DrawArgs["grid"].IndexCount;
+	wavesRitem->StartIndexLocation = wavesDesc.Geo->DrawArgs["grid"].StartIndexLocation;
+	wavesRitem->BaseVertexLocation = wavesDesc.Geo->DrawArgs["grid"].BaseVertexLocation;
 
     mWavesRitem = wavesRitem.get();
 
 	mRitemLayer[(int)RenderLayer::Transparent].push_back(wavesRitem.get());
 
-    auto gridRitem = std::make_unique<RenderItem>();
-    gridRitem->World = MathHelper::Identity4x4();
-	XMStoreFloat4x4(&gridRitem->TexTransform, XMMatrixScaling(5.0f, 5.0f, 1.0f));
+	//the terrain is drawn node by node in DrawTerrain, so it is not in a layer;
+	//the item only supplies the material and the texture transform
+    auto terrainRitem = std::make_unique<RenderItem>();
+	SceneStore::Desc terrainDesc;
+	terrainDesc.Name = "terrain";
+	XMStoreFloat4x4(&terrainDesc.TexTransform, XMMatrixScaling(5.0f, 5.0f, 1.0f));
 	objCBIndex++;
-	gridRitem->ObjCBIndex = objCBIndex;
-	gridRitem->Mat = mMaterials["grass"].get();
-	gridRitem->Geo = mGeometries["landGeo"].get();
-	gridRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	//bounding box 
-	//gridRitem->Name = item;
-	gridRitem->RenderBounds = gridRitem->Geo->DrawArgs["grid"].Bounds;
-    gridRitem->IndexCount = gridRitem->Geo->DrawArgs["grid"].IndexCount;
-    gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
-    gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
+	terrainDesc.ObjCBIndex = objCBIndex;
+	terrainDesc.Mat = mMaterials["grass"].get();
+	terrainDesc.Geo = mGeometries["terrainGeo"].get();
+	terrainRitem->Handle = mScene.Add(terrainDesc);
+	terrainRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	terrainRitem->IndexCount = terrainDesc.Geo->DrawArgs["patch"].IndexCount;
+	terrainRitem->StartIndexLocation = terrainDesc.Geo->DrawArgs["patch"].StartIndexLocation;
+	terrainRitem->BaseVertexLocation = terrainDesc.Geo->DrawArgs["patch"].BaseVertexLocation;
 
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(gridRitem.get());
+	mTerrainRitem = terrainRitem.get();
 
 	//building the objects here
 
@@ -2523,37 +2769,53 @@ void TreeBillboardsApp::BuildRenderItems()
 		objCBIndex, "bush");
 
 	auto treeSpritesRitem = std::make_unique<RenderItem>();
-	treeSpritesRitem->World = MathHelper::Identity4x4();
-	objCBIndex++;
-	treeSpritesRitem->ObjCBIndex = objCBIndex;
-	treeSpritesRitem->Mat = mMaterials["treeSprites"].get();
-	treeSpritesRitem->Geo = mGeometries["treeSpritesGeo"].get();
+	SceneStore::Desc treeSpritesDesc;
+	treeSpritesDesc.Name = "treeSprites";
+	objCBIndex++;
+	treeSpritesDesc.ObjCBIndex = objCBIndex;
+	treeSpritesDesc.Mat = mMaterials["treeSprites"].get();
+	treeSpritesDesc.Geo = mGeometries["treeSpritesGeo"].get();
+	//the points are the sprite centres, so grow the box by half a sprite
+	treeSpritesDesc.LocalBounds = treeSpritesDesc.Geo->DrawArgs["points"].Bounds;
+	treeSpritesDesc.LocalBounds.Extents.x += 25.0f;
+	treeSpritesDesc.LocalBounds.Extents.y += 25.0f;
+	treeSpritesDesc.LocalBounds.Extents.z += 25.0f;
+	treeSpritesDesc.Layers = 1u << (int)RenderLayer::AlphaTestedTreeSprites;
+	treeSpritesRitem->Handle = mScene.Add(treeSpritesDesc);
 	//step2
 	treeSpritesRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_POINTLIST;
-	treeSpritesRitem->IndexCount = treeSpritesRitem->Geo->DrawArgs["points"].IndexCount;
-	treeSpritesRitem->StartIndexLocation = treeSpritesRitem->Geo->DrawArgs["points"].StartIndexLocation;
-	treeSpritesRitem->BaseVertexLocation = treeSpritesRitem->Geo->DrawArgs["points"].BaseVertexLocation;
+	treeSpritesRitem->IndexCount = treeSpritesDesc.Geo->DrawArgs["points"].IndexCount;
+	treeSpritesRitem->StartIndexLocation = treeSpritesDesc.Geo->DrawArgs["points"].StartIndexLocation;
+	treeSpritesRitem->BaseVertexLocation = treeSpritesDesc.Geo->DrawArgs["points"].BaseVertexLocation;
 
 	mRitemLayer[(int)RenderLayer::AlphaTestedTreeSprites].push_back(treeSpritesRitem.get());
 
 	//for the statues
 	auto statueSpritesRitem = std::make_unique<RenderItem>();
-	statueSpritesRitem->World = MathHelper::Identity4x4();
-	objCBIndex++;
-	statueSpritesRitem->ObjCBIndex = objCBIndex;
-	statueSpritesRitem->Mat = mMaterials["statueSprites"].get();
-	statueSpritesRitem->Geo = mGeometries["statueSpritesGeo"].get();
+	SceneStore::Desc statueSpritesDesc;
+	statueSpritesDesc.Name = "statueSprites";
+	objCBIndex++;
+	statueSpritesDesc.ObjCBIndex = objCBIndex;
+	statueSpritesDesc.Mat = mMaterials["statueSprites"].get();
+	statueSpritesDesc.Geo = mGeometries["statueSpritesGeo"].get();
+	//the points are the sprite centres, so grow the box by half a sprite
+	statueSpritesDesc.LocalBounds = statueSpritesDesc.Geo->DrawArgs["points"].Bounds;
+	statueSpritesDesc.LocalBounds.Extents.x += 25.0f;
+	statueSpritesDesc.LocalBounds.Extents.y += 40.0f;
+	statueSpritesDesc.LocalBounds.Extents.z += 25.0f;
+	statueSpritesDesc.Layers = 1u << (int)RenderLayer::AlphaTestedTreeSprites;
+	statueSpritesRitem->Handle = mScene.Add(statueSpritesDesc);
 	//step2
 	statueSpritesRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_POINTLIST;
-	statueSpritesRitem->IndexCount = statueSpritesRitem->Geo->DrawArgs["points"].IndexCount;
-	statueSpritesRitem->StartIndexLocation = statueSpritesRitem->Geo->DrawArgs["points"].StartIndexLocation;
-	statueSpritesRitem->BaseVertexLocation = statueSpritesRitem->Geo->DrawArgs["points"].BaseVertexLocation;
+	statueSpritesRitem->IndexCount = statueSpritesDesc.Geo->DrawArgs["points"].IndexCount;
+	statueSpritesRitem->StartIndexLocation = statueSpritesDesc.Geo->DrawArgs["points"].StartIndexLocation;
+	statueSpritesRitem->BaseVertexLocation = statueSpritesDesc.Geo->DrawArgs["points"].BaseVertexLocation;
 
 	mRitemLayer[(int)RenderLayer::AlphaTestedTreeSprites].push_back(statueSpritesRitem.get());
 
 
     mAllRitems.push_back(std::move(wavesRitem));
-    mAllRitems.push_back(std::move(gridRitem));
+    mAllRitems.push_back(std::move(terrainRitem));
 	mAllRitems.push_back(std::move(treeSpritesRitem));
 	mAllRitems.push_back(std::move(statueSpritesRitem));
 }
@@ -2570,26 +2832,99 @@ void TreeBillboardsApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, cons
     for(size_t i = 0; i < ritems.size(); ++i)
     {
         auto ri = ritems[i];
+		MeshGeometry* geo = mScene.GetGeometry(ri->Handle);
+		Material* mat = mScene.GetMaterial(ri->Handle);
 
-        cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
-        cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
+        cmdList->IASetVertexBuffers(0, 1, &geo->VertexBufferView());
+        cmdList->IASetIndexBuffer(&geo->IndexBufferView());
 		//step3
         cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 
 		CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-		tex.Offset(ri->Mat->DiffuseSrvHeapIndex, mCbvSrvDescriptorSize);
+		tex.Offset(mat->DiffuseSrvHeapIndex, mCbvSrvDescriptorSize);
 
-        D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex*objCBByteSize;
-		D3D12_GPU_VIRTUAL_ADDRESS matCBAddress = matCB->GetGPUVirtualAddress() + ri->Mat->MatCBIndex*matCBByteSize;
+        D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + mScene.GetObjCBIndex(ri->Handle)*objCBByteSize;
+		D3D12_GPU_VIRTUAL_ADDRESS matCBAddress = matCB->GetGPUVirtualAddress() + mat->MatCBIndex*matCBByteSize;
 
 		cmdList->SetGraphicsRootDescriptorTable(0, tex);
         cmdList->SetGraphicsRootConstantBufferView(1, objCBAddress);
         cmdList->SetGraphicsRootConstantBufferView(3, matCBAddress);
 
-        cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+		if(ri->Clusters != nullptr)
+		{
+			for(auto& range : ri->DrawRanges)
+				cmdList->DrawIndexedInstanced(range.second, 1, range.first, ri->BaseVertexLocation, 0);
+		}
+		else
+		{
+			cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+		}
     }
 }
 
+void TreeBillboardsApp::DrawTerrain(ID3D12GraphicsCommandList* cmdList)
+{
+    UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+    UINT matCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(MaterialConstants));
+
+	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
+	auto matCB = mCurrFrameResource->MaterialCB->Resource();
+	auto ri = mTerrainRitem;
+	MeshGeometry* geo = mScene.GetGeometry(ri->Handle);
+	Material* mat = mScene.GetMaterial(ri->Handle);
+
+	cmdList->IASetVertexBuffers(0, 1, &geo->VertexBufferView());
+	cmdList->IASetIndexBuffer(&geo->IndexBufferView());
+	cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+
+	CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+	tex.Offset(mat->DiffuseSrvHeapIndex, mCbvSrvDescriptorSize);
+
+	CD3DX12_GPU_DESCRIPTOR_HANDLE heights(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+	heights.Offset(gTerrainHeightSrvIndex, mCbvSrvDescriptorSize);
+
+	D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + mScene.GetObjCBIndex(ri->Handle)*objCBByteSize;
+	D3D12_GPU_VIRTUAL_ADDRESS matCBAddress = matCB->GetGPUVirtualAddress() + mat->MatCBIndex*matCBByteSize;
+
+	cmdList->SetGraphicsRootDescriptorTable(0, tex);
+	cmdList->SetGraphicsRootConstantBufferView(1, objCBAddress);
+	cmdList->SetGraphicsRootConstantBufferView(3, matCBAddress);
+	cmdList->SetGraphicsRootDescriptorTable(4, heights);
+
+	const TerrainQuadtree::Settings& settings = mTerrain->GetSettings();
+	TerrainNodeConstants constants;
+	constants.PatchResolution = (float)settings.PatchResolution;
+	constants.HeightmapSize = settings.Size;
+	constants.HeightmapDim = gTerrainHeightmapDim;
+	constants.HeightmapOrigin = settings.Origin;
+
+	const SubmeshGeometry* quadrants[4];
+	for(int q = 0; q < 4; ++q)
+		quadrants[q] = &geo->DrawArgs["patch" + std::to_string(q)];
+
+	// One draw per node, or per quadrant for nodes that are only partly drawn.
+	for(auto& node : mTerrainNodes)
+	{
+		constants.NodeOrigin = XMFLOAT2(node.X, node.Z);
+		constants.NodeSize = node.Size;
+		constants.MorphStart = mTerrain->MorphStart(node.Level);
+		constants.MorphEnd = mTerrain->MorphEnd(node.Level);
+		cmdList->SetGraphicsRoot32BitConstants(5, sizeof(TerrainNodeConstants) / 4, &constants, 0);
+
+		if(node.QuadrantMask == 0xf)
+		{
+			cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+			continue;
+		}
+
+		for(int q = 0; q < 4; ++q)
+		{
+			if(node.QuadrantMask & (1u << q))
+				cmdList->DrawIndexedInstanced(quadrants[q]->IndexCount, 1, quadrants[q]->StartIndexLocation, ri->BaseVertexLocation, 0);
+		}
+	}
+}
+
 std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> TreeBillboardsApp::GetStaticSamplers()
 {
 	// Applications usually only need a handful of samplers.  So just define them all up front
@@ -2647,21 +2982,22 @@ std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> TreeBillboardsApp::GetStaticSam
 		anisotropicWrap, anisotropicClamp };
 }
 
+//the land is a plateau at y = 2 within 45 units of the centre, dipping to -10 outside
+float TreeBillboardsApp::GetLandHeight(float x, float z)const
+{
+	float borderSize = 45.0f;
+	if (x > -borderSize && x < borderSize && z > -borderSize && z < borderSize)
+		return 2.0f;
+
+	return -10.0f;
+}
+
 float TreeBillboardsApp::GetHillsHeight(float x, float z)const
 {
-    return 0.3f*(z*sinf(0.1f*x) + x*cosf(0.1f*z));
+    return HillsFunction::Height(x, z);
 }
 
 XMFLOAT3 TreeBillboardsApp::GetHillsNormal(float x, float z)const
 {
-    // n = (-df/dx, 1, -df/dz)
-    XMFLOAT3 n(
-        -0.03f*z*cosf(0.1f*x) - 0.3f*cosf(0.1f*z),
-        1.0f,
-        -0.3f*sinf(0.1f*x) + 0.03f*x*sinf(0.1f*z));
-
-    XMVECTOR unitNormal = XMVector3Normalize(XMLoadFloat3(&n));
-    XMStoreFloat3(&n, unitNormal);
-
-    return n;
+    return HillsFunction::Normal(x, z);
 }